@@ -227,10 +227,14 @@ void print_statistics_tree(bx_param_c *node, int level = 0);
         if (bx_guard.report.a20) bx_dbg_a20_report(val)
 #  define BX_DBG_IO_REPORT(port, size, op, val) \
         if (bx_guard.report.io) bx_dbg_io_report(port, size, op, val)
-#  define BX_DBG_LIN_MEMORY_ACCESS(cpu, lin, phy, len, memtype, rw, data) \
-        bx_dbg_lin_memory_access(cpu, lin, phy, len, memtype, rw, data)
-#  define BX_DBG_PHY_MEMORY_ACCESS(cpu, phy, len, memtype, rw, why, data) \
-        bx_dbg_phy_memory_access(cpu, phy, len, memtype, rw, why, data)
+#  define BX_DBG_LIN_MEMORY_ACCESS(cpu, lin, phy, len, memtype, rw, data) do { \
+        if (BX_CPU(cpu)->trace_mem || bx_dbg_watch_page_hit(phy, rw)) \
+          bx_dbg_lin_memory_access(cpu, lin, phy, len, memtype, rw, data); \
+        } while (0)
+#  define BX_DBG_PHY_MEMORY_ACCESS(cpu, phy, len, memtype, rw, why, data) do { \
+        if (BX_CPU(cpu)->trace_mem || bx_dbg_watch_page_hit(phy, rw)) \
+          bx_dbg_phy_memory_access(cpu, phy, len, memtype, rw, why, data); \
+        } while (0)
 #else  // #if BX_DEBUGGER
 // debugger not compiled in, use empty stubs
 #  define BX_DBG_ASYNC_INTR 1
@@ -272,6 +276,7 @@ void print_statistics_tree(bx_param_c *node, int level = 0);
 void bx_gdbstub_init(void);
 void bx_gdbstub_break(void);
 int bx_gdbstub_check(unsigned int eip);
+int bx_gdbstub_single_step(void);
 #define GDBSTUB_STOP_NO_REASON   (0xac0)
 
 #if BX_SUPPORT_SMP
@@ -26,6 +26,36 @@
 
 static unsigned next_bpoint_id = 1;
 
+// rebuild the breakpoint address hashes checked on every instruction
+static void bx_dbg_update_iaddr_hash(void)
+{
+  unsigned i;
+
+#if (BX_DBG_MAX_VIR_BPOINTS > 0)
+  memset(bx_guard.iaddr.vir_hash, 0, sizeof(bx_guard.iaddr.vir_hash));
+  for (i=0; i<bx_guard.iaddr.num_virtual; i++) {
+    if (bx_guard.iaddr.vir[i].enabled)
+      BX_DBG_IADDR_HASH_SET(bx_guard.iaddr.vir_hash, bx_guard.iaddr.vir[i].eip);
+  }
+#endif
+
+#if (BX_DBG_MAX_LIN_BPOINTS > 0)
+  memset(bx_guard.iaddr.lin_hash, 0, sizeof(bx_guard.iaddr.lin_hash));
+  for (i=0; i<bx_guard.iaddr.num_linear; i++) {
+    if (bx_guard.iaddr.lin[i].enabled)
+      BX_DBG_IADDR_HASH_SET(bx_guard.iaddr.lin_hash, bx_guard.iaddr.lin[i].addr);
+  }
+#endif
+
+#if (BX_DBG_MAX_PHY_BPOINTS > 0)
+  memset(bx_guard.iaddr.phy_hash, 0, sizeof(bx_guard.iaddr.phy_hash));
+  for (i=0; i<bx_guard.iaddr.num_physical; i++) {
+    if (bx_guard.iaddr.phy[i].enabled)
+      BX_DBG_IADDR_HASH_SET(bx_guard.iaddr.phy_hash, bx_guard.iaddr.phy[i].addr);
+  }
+#endif
+}
+
 void bx_dbg_breakpoint_changed(void)
 {
 #if (BX_DBG_MAX_VIR_BPOINTS > 0)
@@ -81,6 +111,7 @@ bool bx_dbg_en_dis_pbreak(unsigned handle, bool enable)
   for (unsigned i=0; i<bx_guard.iaddr.num_physical; i++) {
     if (bx_guard.iaddr.phy[i].bpoint_id == handle) {
       bx_guard.iaddr.phy[i].enabled=enable;
+      bx_dbg_update_iaddr_hash();
       return 1;
     }
   }
@@ -95,6 +126,7 @@ bool bx_dbg_en_dis_lbreak(unsigned handle, bool enable)
   for (unsigned i=0; i<bx_guard.iaddr.num_linear; i++) {
     if (bx_guard.iaddr.lin[i].bpoint_id == handle) {
       bx_guard.iaddr.lin[i].enabled=enable;
+      bx_dbg_update_iaddr_hash();
       return 1;
     }
   }
@@ -109,6 +141,7 @@ bool bx_dbg_en_dis_vbreak(unsigned handle, bool enable)
   for (unsigned i=0; i<bx_guard.iaddr.num_virtual; i++) {
     if (bx_guard.iaddr.vir[i].bpoint_id == handle) {
       bx_guard.iaddr.vir[i].enabled=enable;
+      bx_dbg_update_iaddr_hash();
       return 1;
     }
   }
@@ -152,6 +185,7 @@ bool bx_dbg_del_pbreak(unsigned handle)
         bx_guard.iaddr.phy[j] = bx_guard.iaddr.phy[j+1];
       }
       bx_guard.iaddr.num_physical--;
+      bx_dbg_update_iaddr_hash();
       return 1;
     }
   }
@@ -171,6 +205,7 @@ bool bx_dbg_del_lbreak(unsigned handle)
         bx_guard.iaddr.lin[j] = bx_guard.iaddr.lin[j+1];
       }
       bx_guard.iaddr.num_linear--;
+      bx_dbg_update_iaddr_hash();
       return 1;
     }
   }
@@ -190,6 +225,7 @@ bool bx_dbg_del_vbreak(unsigned handle)
         bx_guard.iaddr.vir[j] = bx_guard.iaddr.vir[j+1];
       }
       bx_guard.iaddr.num_virtual--;
+      bx_dbg_update_iaddr_hash();
       return 1;
     }
   }
@@ -231,6 +267,7 @@ int bx_dbg_vbreakpoint_command(BreakpointKind bk, Bit32u cs, bx_address eip, con
   bp->enabled=1;
   bx_guard.iaddr.num_virtual++;
   bx_guard.guard_for |= BX_DBG_GUARD_IADDR_VIR;
+  bx_dbg_update_iaddr_hash();
   return bp->bpoint_id;
 
 #else
@@ -262,6 +299,7 @@ int bx_dbg_lbreakpoint_command(BreakpointKind bk, bx_address laddress, const cha
   bp->enabled=1;
   bx_guard.iaddr.num_linear++;
   bx_guard.guard_for |= BX_DBG_GUARD_IADDR_LIN;
+  bx_dbg_update_iaddr_hash();
   return BpId;
 
 #else
@@ -292,6 +330,7 @@ int bx_dbg_pbreakpoint_command(BreakpointKind bk, bx_phy_address paddress, const
   bp->enabled=1;
   bx_guard.iaddr.num_physical++;
   bx_guard.guard_for |= BX_DBG_GUARD_IADDR_PHY;
+  bx_dbg_update_iaddr_hash();
   return bp->bpoint_id;
 #else
   dbg_printf("Error: physical breakpoint support not compiled in.\n");
@@ -128,6 +128,7 @@ unsigned num_write_watchpoints = 0;
 unsigned num_read_watchpoints = 0;
 bx_watchpoint write_watchpoint[BX_DBG_MAX_WATCHPONTS];
 bx_watchpoint read_watchpoint[BX_DBG_MAX_WATCHPONTS];
+Bit8u bx_dbg_watch_page[2][BX_DBG_WATCH_PAGE_HASH_SIZE];
 
 #define DBG_PRINTF_BUFFER_LEN 1024
 
@@ -600,6 +601,28 @@ void bx_dbg_watchpoint_continue(bool watch_continue)
   }
 }
 
+static void bx_dbg_set_watch_pages(Bit8u *map, const bx_watchpoint *wp, unsigned num)
+{
+  memset(map, 0, BX_DBG_WATCH_PAGE_HASH_SIZE);
+  for (unsigned i = 0; i < num; i++) {
+    Bit64u first = wp[i].addr >> 12;
+    Bit64u last = (wp[i].addr + (wp[i].len ? wp[i].len : 1) - 1) >> 12;
+    if (last - first >= BX_DBG_WATCH_PAGE_HASH_SIZE) {
+      memset(map, 1, BX_DBG_WATCH_PAGE_HASH_SIZE);
+      return;
+    }
+    for (Bit64u page = first; page <= last; page++)
+      map[BX_DBG_WATCH_PAGE_HASH(page << 12)] = 1;
+  }
+}
+
+// rebuild the watch page map after the watchpoint lists were changed
+void bx_dbg_watchpoints_changed(void)
+{
+  bx_dbg_set_watch_pages(bx_dbg_watch_page[0], read_watchpoint, num_read_watchpoints);
+  bx_dbg_set_watch_pages(bx_dbg_watch_page[1], write_watchpoint, num_write_watchpoints);
+}
+
 void bx_dbg_check_memory_watchpoints(unsigned cpu, bx_phy_address phy, unsigned len, unsigned rw)
 {
   bx_phy_address phy_end = phy + len - 1;
@@ -611,6 +634,7 @@ void bx_dbg_check_memory_watchpoints(unsigned cpu, bx_phy_address phy, unsigned
       if (watch_end < phy || phy_end < write_watchpoint[i].addr) continue;
       BX_CPU(cpu)->watchpoint  = phy;
       BX_CPU(cpu)->break_point = BREAK_POINT_WRITE;
+      BX_CPU(cpu)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
       break;
     }
   }
@@ -621,6 +645,7 @@ void bx_dbg_check_memory_watchpoints(unsigned cpu, bx_phy_address phy, unsigned
       if (watch_end < phy || phy_end < read_watchpoint[i].addr) continue;
       BX_CPU(cpu)->watchpoint  = phy;
       BX_CPU(cpu)->break_point = BREAK_POINT_READ;
+      BX_CPU(cpu)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
       break;
     }
   }
@@ -1911,11 +1936,13 @@ void bx_dbg_watch(int type, bx_phy_address address, Bit32u len)
   else {
     dbg_printf("bx_dbg_watch: broken watchpoint type");
   }
+  bx_dbg_watchpoints_changed();
 }
 
 void bx_dbg_unwatch_all()
 {
   num_read_watchpoints = num_write_watchpoints = 0;
+  bx_dbg_watchpoints_changed();
   dbg_printf("All watchpoints removed\n");
 }
 
@@ -1945,6 +1972,8 @@ void bx_dbg_unwatch(bx_phy_address address)
       break;
     }
   }
+
+  bx_dbg_watchpoints_changed();
 }
 
 void bx_dbg_continue_command(bool expression)
@@ -183,6 +183,7 @@ void bx_dbg_phy_memory_access(unsigned cpu,                 bx_phy_address phy,
 
 // check memory access for watchpoints
 void bx_dbg_check_memory_watchpoints(unsigned cpu, bx_phy_address phy, unsigned len, unsigned rw);
+void bx_dbg_watchpoints_changed(void);
 
 // commands that work with Bochs param tree
 void bx_dbg_restore_command(const char *param_name, const char *path);
@@ -237,6 +238,17 @@ void bx_dbg_exit(int code);
 
 #define BX_DBG_GUARD_ICOUNT        0x0010
 
+// Enabled instruction breakpoints are hashed by the offset of their
+// address in the page, one bit per offset. The offset of a physical
+// breakpoint matches the offset of the linear address, so the linear
+// to physical translation is only done on a hash hit.
+#define BX_DBG_IADDR_HASH_SIZE 4096
+#define BX_DBG_IADDR_HASH(addr) ((unsigned)(addr) & (BX_DBG_IADDR_HASH_SIZE-1))
+#define BX_DBG_IADDR_HASH_SET(hash, addr) \
+  ((hash)[BX_DBG_IADDR_HASH(addr) >> 5] |= (1 << (BX_DBG_IADDR_HASH(addr) & 31)))
+#define BX_DBG_IADDR_HASH_TEST(hash, addr) \
+  ((hash)[BX_DBG_IADDR_HASH(addr) >> 5] & (1 << (BX_DBG_IADDR_HASH(addr) & 31)))
+
 struct bx_guard_t {
   unsigned guard_for;
 
@@ -244,6 +256,7 @@ struct bx_guard_t {
   struct ibreak {
 #if (BX_DBG_MAX_VIR_BPOINTS > 0)
     unsigned num_virtual;
+    Bit32u vir_hash[BX_DBG_IADDR_HASH_SIZE/32];
     struct vbreak {
       Bit32u cs;  // only use 16 bits
       bx_address eip;
@@ -255,6 +268,7 @@ struct bx_guard_t {
 
 #if (BX_DBG_MAX_LIN_BPOINTS > 0)
     unsigned num_linear;
+    Bit32u lin_hash[BX_DBG_IADDR_HASH_SIZE/32];
     struct lbreak {
       bx_address addr;
       unsigned bpoint_id;
@@ -265,6 +279,7 @@ struct bx_guard_t {
 
 #if (BX_DBG_MAX_PHY_BPOINTS > 0)
     unsigned num_physical;
+    Bit32u phy_hash[BX_DBG_IADDR_HASH_SIZE/32];
     struct pbreak {
       bx_phy_address addr;
       unsigned bpoint_id;
@@ -333,6 +348,21 @@ extern bx_watchpoint write_watchpoint[BX_DBG_MAX_WATCHPONTS];
 extern bx_watchpoint read_watchpoint[BX_DBG_MAX_WATCHPONTS];
 extern bx_guard_t bx_guard;
 
+// Physical pages covered by a read (index 0) or write (index 1) watchpoint,
+// hashed by page number. Every memory access checks this map first, the
+// watchpoint lists are only searched on a hit.
+#define BX_DBG_WATCH_PAGE_HASH_SIZE 4096
+#define BX_DBG_WATCH_PAGE_HASH(phy) \
+  ((unsigned)((phy) >> 12) & (BX_DBG_WATCH_PAGE_HASH_SIZE-1))
+
+extern Bit8u bx_dbg_watch_page[2][BX_DBG_WATCH_PAGE_HASH_SIZE];
+
+// memory accesses reported by the CPU never cross a page boundary
+BX_CPP_INLINE bool bx_dbg_watch_page_hit(bx_phy_address phy, unsigned rw)
+{
+  return bx_dbg_watch_page[rw & 1][BX_DBG_WATCH_PAGE_HASH(phy)] != 0;
+}
+
 #define IS_CODE_32(code_32_64) ((code_32_64 & 1) != 0)
 #define IS_CODE_64(code_32_64) ((code_32_64 & 2) != 0)
 
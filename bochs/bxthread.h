@@ -31,13 +31,23 @@
 #define BX_THREAD_EXIT return 0
 #define BX_THREAD_CREATE(name,arg,var) do { var = CreateThread(NULL, 0, name, arg, 0, NULL); } while (0)
 #define BX_THREAD_KILL(var) TerminateThread(var, 0)
-#define BX_THREAD_JOIN(var)
+#define BX_THREAD_JOIN(var) do { WaitForSingleObject(var, INFINITE); CloseHandle(var); } while (0)
 #define BX_LOCK(mutex) EnterCriticalSection(&(mutex))
 #define BX_UNLOCK(mutex) LeaveCriticalSection(&(mutex))
 #define BX_MUTEX(mutex) CRITICAL_SECTION mutex
 #define BX_INIT_MUTEX(mutex) InitializeCriticalSection(&(mutex))
 #define BX_FINI_MUTEX(mutex) DeleteCriticalSection(&(mutex))
+#define BX_COND(cond) CONDITION_VARIABLE cond
+#define BX_INIT_COND(cond) InitializeConditionVariable(&(cond))
+#define BX_FINI_COND(cond)
+#define BX_COND_WAIT(cond,mutex) SleepConditionVariableCS(&(cond), &(mutex), INFINITE)
+#define BX_COND_SIGNAL(cond) WakeConditionVariable(&(cond))
 #define BX_MSLEEP(val) Sleep(val)
+#define BX_ATOMIC_FETCH_INC(var) (InterlockedIncrement((volatile LONG*)&(var)) - 1)
+#define BX_ATOMIC_EXCHANGE(var,val) ((Bit32u) InterlockedExchange((volatile LONG*)&(var), (LONG)(val)))
+#define BX_ATOMIC_LOAD64(var) ((Bit64u) InterlockedCompareExchange64((volatile LONGLONG*)&(var), 0, 0))
+#define BX_ATOMIC_STORE64(var,val) InterlockedExchange64((volatile LONGLONG*)&(var), (LONGLONG)(val))
+#define BX_MEMORY_BARRIER() MemoryBarrier()
 
 #else
 
@@ -56,7 +66,17 @@
 #define BX_MUTEX(mutex) pthread_mutex_t mutex
 #define BX_INIT_MUTEX(mutex) pthread_mutex_init(&(mutex),NULL)
 #define BX_FINI_MUTEX(mutex) pthread_mutex_destroy(&(mutex))
+#define BX_COND(cond) pthread_cond_t cond
+#define BX_INIT_COND(cond) pthread_cond_init(&(cond),NULL)
+#define BX_FINI_COND(cond) pthread_cond_destroy(&(cond))
+#define BX_COND_WAIT(cond,mutex) pthread_cond_wait(&(cond), &(mutex))
+#define BX_COND_SIGNAL(cond) pthread_cond_signal(&(cond))
 #define BX_MSLEEP(val) usleep(val*1000)
+#define BX_ATOMIC_FETCH_INC(var) __sync_fetch_and_add(&(var), 1)
+#define BX_ATOMIC_EXCHANGE(var,val) __sync_lock_test_and_set(&(var), (val))
+#define BX_ATOMIC_LOAD64(var) __sync_fetch_and_add(&(var), 0)
+#define BX_ATOMIC_STORE64(var,val) (void) __sync_lock_test_and_set(&(var), (val))
+#define BX_MEMORY_BARRIER() __sync_synchronize()
 
 #endif
 
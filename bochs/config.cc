@@ -32,6 +32,7 @@
 #include "iodev/usb/usb_common.h"
 #endif
 #include "param_names.h"
+#include "replay.h"
 #include <assert.h>
 
 #ifdef HAVE_LOCALE_H
@@ -1680,6 +1681,24 @@ void bx_init_options()
     0);
   enabled->set_dependent_list(menu->clone());
 
+  // record/replay of host input
+  menu = new bx_list_c(misc, "replay", "Record/Replay Options");
+  menu->set_options(menu->SHOW_PARENT | menu->USE_BOX_TITLE);
+  static const char *replay_mode_names[] = { "none", "record", "replay", NULL };
+  new bx_param_enum_c(menu,
+    "mode",
+    "Record/replay mode",
+    "Record host input to a journal or replay it from there",
+    replay_mode_names,
+    BX_REPLAY_MODE_NONE,
+    BX_REPLAY_MODE_NONE);
+  path = new bx_param_filename_c(menu,
+    "file",
+    "Journal file",
+    "Pathname of the record/replay journal",
+    "bochs.jnl", BX_PATHNAME_LEN);
+  path->set_ask_format("Enter journal filename: [%s] ");
+
 #if BX_PLUGINS
   // user-defined options subtree
   bx_list_c *user = new bx_list_c(root_param, "user", "User-defined options");
@@ -3104,6 +3123,15 @@ static int parse_line_formatted(const char *context, int num_params, char *param
 #else
     PARSE_ERR(("%s: Bochs is not compiled with gdbstub support", context));
 #endif
+  } else if (!strcmp(params[0], "replay")) {
+    if (num_params < 2) {
+      PARSE_ERR(("%s: replay directive: wrong # args.", context));
+    }
+    for (i=1; i<num_params; i++) {
+      if (bx_parse_param_from_list(context, params[i], (bx_list_c*) SIM->get_param(BXPN_REPLAY)) < 0) {
+        PARSE_ERR(("%s: replay directive malformed.", context));
+      }
+    }
   } else if (!strcmp(params[0], "magic_break")) {
 #if BX_DEBUGGER
     if (num_params != 2) {
@@ -3508,6 +3536,7 @@ int bx_write_configuration(const char *rc, int overwrite)
   fprintf(fp, "print_timestamps: enabled=%d\n", bx_dbg.print_timestamps);
   bx_write_debugger_options(fp);
   fprintf(fp, "port_e9_hack: enabled=%d\n", SIM->get_param_bool(BXPN_PORT_E9_HACK)->get());
+  bx_write_param_list(fp, (bx_list_c*) SIM->get_param(BXPN_REPLAY), NULL, 0);
   fprintf(fp, "private_colormap: enabled=%d\n", SIM->get_param_bool(BXPN_PRIVATE_COLORMAP)->get());
 #if BX_WITH_AMIGAOS
   fprintf(fp, "fullscreen: enabled=%d\n", SIM->get_param_bool(BXPN_FULLSCREEN)->get());
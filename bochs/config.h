@@ -257,13 +257,14 @@
 
 // Compile in support for virtual/linear/physical breakpoints.
 // Enable only those you need. Recommend using only linear
-// breakpoints, unless you need others. Less supported means
-// slightly faster execution time.
-#define BX_DBG_MAX_VIR_BPOINTS 16
-#define BX_DBG_MAX_LIN_BPOINTS 16
-#define BX_DBG_MAX_PHY_BPOINTS 16
+// breakpoints, unless you need others. Breakpoints are looked up
+// through a hash of the page offset, so the number of breakpoints
+// set has little effect on execution time.
+#define BX_DBG_MAX_VIR_BPOINTS 64
+#define BX_DBG_MAX_LIN_BPOINTS 64
+#define BX_DBG_MAX_PHY_BPOINTS 64
 
-#define BX_DBG_MAX_WATCHPONTS  16
+#define BX_DBG_MAX_WATCHPONTS  64
 
 // max file pathname size for debugger commands
 #define BX_MAX_PATH     256
@@ -292,6 +293,7 @@
 #define BX_WITH_MACOS 0
 #define BX_WITH_CARBON 0
 #define BX_WITH_NOGUI 1
+#define BX_WITH_SHMFB 0
 #define BX_WITH_TERM 0
 #define BX_WITH_RFB 1
 #define BX_WITH_VNCSRV 0
@@ -659,9 +661,29 @@ typedef Bit32u bx_phy_address;
 #define BX_SUPPORT_REPEAT_SPEEDUPS 1
 #define BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS 0
 #define BX_ENABLE_TRACE_LINKING 1
+#define BX_ENABLE_INSTRUCTION_FUSION 0
 
-#if (BX_DEBUGGER || BX_GDBSTUB) && BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
- #error "Handler-chaining-speedups are not supported together with internal debugger or gdb-stub!"
+// Run SSE/AVX packed add/sub/mul/div/sqrt on the host SSE unit when the
+// result is bit-exact with softfloat, falling back to softfloat otherwise
+// (--enable-host-sse-pfp). Needs a GCC compatible compiler targeting SSE2.
+#define BX_ENABLE_HOST_SSE_PFP 1
+
+#if BX_ENABLE_HOST_SSE_PFP && defined(__GNUC__) && defined(__SSE2__)
+  #define BX_SUPPORT_HOST_SSE_PFP 1
+#else
+  #define BX_SUPPORT_HOST_SSE_PFP 0
+#endif
+
+// Compute x87 add/sub/mul/div of normal operands in round to nearest,
+// 64-bit precision directly on the significands with the host 128-bit
+// multiply and divide, bypassing the general softfloat code
+// (--enable-fastx80). Needs an x86-64 host and a GCC compatible compiler.
+#define BX_ENABLE_FASTX80 1
+
+#if BX_ENABLE_FASTX80 && defined(__GNUC__) && defined(__x86_64__)
+  #define BX_SUPPORT_FASTX80 1
+#else
+  #define BX_SUPPORT_FASTX80 0
 #endif
 
 #if BX_SUPPORT_3DNOW
@@ -764,6 +786,19 @@ typedef Bit32u bx_phy_address;
 #  define BX_CPP_AttrRegparmN(X) /* Not defined */
 #endif
 
+// Instruction handlers chained by the handlers chaining speedups call the
+// next handler in tail position. Compilers with the musttail attribute
+// (clang, GCC 15 and later) guarantee the tail call, so the host stack
+// doesn't grow along a chain; other compilers leave it to the optimizer.
+#if defined(__has_attribute)
+#  if __has_attribute(musttail)
+#    define BX_CPP_MUSTTAIL __attribute__((musttail))
+#  endif
+#endif
+#ifndef BX_CPP_MUSTTAIL
+#  define BX_CPP_MUSTTAIL /* Not defined */
+#endif
+
 // set if you do have <set>, used in bx_debug/dbg_main.c
 #define BX_HAVE_SET 1
 
@@ -28,6 +28,8 @@
 #include "pc_system.h"
 #include "cpustats.h"
 
+#include "decoder/ia_opcodes.h"
+
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
 
 #define BX_SYNC_TIME_IF_SINGLE_PROCESSOR(allowed_delta) {                               \
@@ -62,6 +64,9 @@ void BX_CPU_C::cpu_loop(void)
     BX_CPU_THIS_PTR icount++;
     BX_SYNC_TIME_IF_SINGLE_PROCESSOR(0);
 #if BX_DEBUGGER || BX_GDBSTUB
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+    BX_CPU_THIS_PTR async_event &= ~BX_ASYNC_EVENT_DEBUG_STEP;
+#endif
     if (dbg_instruction_epilog()) return;
 #endif
 #if BX_GDBSTUB
@@ -99,16 +104,44 @@ void BX_CPU_C::cpu_loop(void)
 
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
     for(;;) {
+#if BX_DEBUGGER || BX_GDBSTUB
+      // the debugger wants to see every instruction, stop the chain after
+      // the first handler and walk through the trace from here
+      bool single_step = dbg_single_step_required();
+      if (single_step) {
+        BX_CPU_THIS_PTR async_event |= BX_ASYNC_EVENT_DEBUG_STEP;
+#if BX_DEBUGGER
+        if (BX_CPU_THIS_PTR trace)
+          debug_disasm_instruction(BX_CPU_THIS_PTR prev_rip);
+#endif
+      }
+#endif
+
       // want to allow changing of the instruction inside instrumentation callback
       BX_INSTR_BEFORE_EXECUTION(BX_CPU_ID, i);
       RIP += i->ilen();
+#if BX_DEBUGGER || BX_GDBSTUB
+      bx_address next_rip = RIP;
+#endif
       // when handlers chaining is enabled this single call will execute entire trace
       BX_CPU_CALL_METHOD(i->execute1, (i)); // might iterate repeat instruction
 
       BX_SYNC_TIME_IF_SINGLE_PROCESSOR(0);
 
+#if BX_DEBUGGER || BX_GDBSTUB
+      BX_CPU_THIS_PTR async_event &= ~BX_ASYNC_EVENT_DEBUG_STEP;
+      if (dbg_instruction_epilog()) return;
+#endif
+
       if (BX_CPU_THIS_PTR async_event) break;
 
+#if BX_DEBUGGER || BX_GDBSTUB
+      // no branch was taken, continue with the next instruction of the trace
+      if (single_step && RIP == next_rip) {
+        if ((++i)->getIaOpcode() != BX_INSERTED_OPCODE) continue;
+      }
+#endif
+
       i = getICacheEntry()->i;
     }
 #else // BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS == 0
@@ -205,8 +238,6 @@ void BX_CPU_C::cpu_run_trace(void)
 
 #endif
 
-#include "decoder/ia_opcodes.h"
-
 bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
 {
   bx_address eipBiased = RIP + BX_CPU_THIS_PTR eipPageBias;
@@ -274,7 +305,6 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::linkTrace(bxInstruction_c *i)
   bxInstruction_c *next = i->getNextTrace(BX_CPU_THIS_PTR iCache.traceLinkTimeStamp);
   if (next) {
     BX_EXECUTE_INSTRUCTION(next);
-    return;
   }
 
   bx_address eipBiased = RIP + BX_CPU_THIS_PTR eipPageBias;
@@ -722,7 +752,9 @@ bool BX_CPU_C::dbg_instruction_epilog(void)
   // see if debugger is looking for iaddr breakpoint of any type
   if (bx_guard.guard_for & BX_DBG_GUARD_IADDR_ALL) {
 #if (BX_DBG_MAX_VIR_BPOINTS > 0)
-    if (bx_guard.guard_for & BX_DBG_GUARD_IADDR_VIR) {
+    if ((bx_guard.guard_for & BX_DBG_GUARD_IADDR_VIR) &&
+         BX_DBG_IADDR_HASH_TEST(bx_guard.iaddr.vir_hash, debug_eip))
+    {
       for (unsigned n=0; n<bx_guard.iaddr.num_virtual; n++) {
         if (bx_guard.iaddr.vir[n].enabled &&
            (bx_guard.iaddr.vir[n].cs  == cs) &&
@@ -738,7 +770,9 @@ bool BX_CPU_C::dbg_instruction_epilog(void)
     }
 #endif
 #if (BX_DBG_MAX_LIN_BPOINTS > 0)
-    if (bx_guard.guard_for & BX_DBG_GUARD_IADDR_LIN) {
+    if ((bx_guard.guard_for & BX_DBG_GUARD_IADDR_LIN) &&
+         BX_DBG_IADDR_HASH_TEST(bx_guard.iaddr.lin_hash, BX_CPU_THIS_PTR guard_found.laddr))
+    {
       for (unsigned n=0; n<bx_guard.iaddr.num_linear; n++) {
         if (bx_guard.iaddr.lin[n].enabled &&
            (bx_guard.iaddr.lin[n].addr == BX_CPU_THIS_PTR guard_found.laddr))
@@ -753,7 +787,10 @@ bool BX_CPU_C::dbg_instruction_epilog(void)
     }
 #endif
 #if (BX_DBG_MAX_PHY_BPOINTS > 0)
-    if (bx_guard.guard_for & BX_DBG_GUARD_IADDR_PHY) {
+    // the page offset of the physical address equals the linear one
+    if ((bx_guard.guard_for & BX_DBG_GUARD_IADDR_PHY) &&
+         BX_DBG_IADDR_HASH_TEST(bx_guard.iaddr.phy_hash, BX_CPU_THIS_PTR guard_found.laddr))
+    {
       bx_phy_address phy;
       bool valid = dbg_xlate_linear2phy(BX_CPU_THIS_PTR guard_found.laddr, &phy);
       if (valid) {
@@ -782,4 +819,22 @@ bool BX_CPU_C::dbg_instruction_epilog(void)
 
   return(0);
 }
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+// Returns true if the debugger has to check every instruction. Otherwise the
+// instruction handlers run chained and the debugger only checks in between
+// traces.
+bool BX_CPU_C::dbg_single_step_required(void)
+{
+#if BX_DEBUGGER
+  extern unsigned dbg_show_mask;
+  if (BX_CPU_THIS_PTR trace || dbg_show_mask) return(1);
+  if (bx_guard.guard_for & (BX_DBG_GUARD_IADDR_ALL | BX_DBG_GUARD_ICOUNT)) return(1);
+#endif
+#if BX_GDBSTUB
+  if (bx_dbg.gdbstub_enabled && bx_gdbstub_single_step()) return(1);
+#endif
+  return(0);
+}
+#endif
 #endif // BX_DEBUGGER || BX_GDBSTUB
@@ -1104,6 +1104,8 @@ public: // for now...
   }
 
 #define BX_ASYNC_EVENT_STOP_TRACE (1<<31)
+// stops handlers chaining after a single instruction for the debugger
+#define BX_ASYNC_EVENT_DEBUG_STEP (1<<30)
 
 #if BX_X86_DEBUGGER
   bool  in_repeat;
@@ -4249,6 +4251,98 @@ public: // for now...
   BX_SMF void BxEndTrace(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
 #endif
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+  // fused instruction pairs
+  BX_SMF void CMP_GdEdR_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EdIdR_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_GdEdM_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EdGdM_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EdIdM_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void TEST_EdGdR_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void TEST_EdIdR_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void DEC_EdR_Jd(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void PUSH2_EdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void POP2_EdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void MOV_GdEdR_ADD_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_ADD_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_SUB_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_SUB_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_AND_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_AND_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_OR_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_OR_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_XOR_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GdEdR_XOR_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void MOV32_GdEdM_ADD_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_ADD_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_SUB_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_SUB_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_AND_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_AND_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_OR_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_OR_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_XOR_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV32_GdEdM_XOR_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#if BX_SUPPORT_X86_64
+  BX_SMF void CMP_GdEdR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EdIdR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_GdEdM_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EdGdM_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EdIdM_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void TEST_EdGdR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void TEST_EdIdR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void DEC_EdR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void CMP_GqEqR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EqIdR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_GqEqM_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EqGqM_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void CMP_EqIdM_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void TEST_EqGqR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void TEST_EqIdR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void DEC_EqR_Jq(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void PUSH2_EqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void POP2_EqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void MOV64_GdEdM_ADD_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_ADD_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_SUB_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_SUB_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_AND_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_AND_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_OR_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_OR_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_XOR_GdEdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV64_GdEdM_XOR_EdIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void MOV_GqEqR_ADD_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_ADD_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_SUB_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_SUB_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_AND_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_AND_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_OR_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_OR_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_XOR_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqR_XOR_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+
+  BX_SMF void MOV_GqEqM_ADD_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_ADD_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_SUB_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_SUB_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_AND_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_AND_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_OR_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_OR_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_XOR_GqEqR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void MOV_GqEqM_XOR_EqIdR(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#endif
+#endif
+
 #if BX_CPU_LEVEL >= 6
   BX_SMF void BxNoSSE(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
 #if BX_SUPPORT_AVX
@@ -4284,6 +4378,9 @@ public: // for now...
 #endif
 #if BX_DEBUGGER || BX_GDBSTUB
   BX_SMF bool  dbg_instruction_epilog(void);
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  BX_SMF bool  dbg_single_step_required(void);
+#endif
 #endif
   BX_SMF bool  dbg_xlate_linear2phy(bx_address linear, bx_phy_address *phy, bx_address *lpf_mask = 0, bool verbose = 0);
 #if BX_SUPPORT_VMX >= 2
@@ -5633,9 +5730,11 @@ class bxInstruction_c;
   BX_CPU_THIS_PTR icount++;                            \
 }
 
+// the next handler is called in tail position, see BX_CPP_MUSTTAIL
 #define BX_EXECUTE_INSTRUCTION(i) {                    \
   BX_INSTR_BEFORE_EXECUTION(BX_CPU_ID, (i));           \
   RIP += (i)->ilen();                                  \
+  BX_CPP_MUSTTAIL                                      \
   return BX_CPU_CALL_METHOD(i->execute1, (i));         \
 }
 
@@ -5644,15 +5743,15 @@ class bxInstruction_c;
   return;                                              \
 }
 
-#if BX_ENABLE_TRACE_LINKING == 0
-#define linkTrace(i)
-#endif
-
+#if BX_ENABLE_TRACE_LINKING
 #define BX_LINK_TRACE(i) {                             \
   BX_COMMIT_INSTRUCTION(i);                            \
-  linkTrace(i);                                        \
-  return;                                              \
+  BX_CPP_MUSTTAIL                                      \
+  return linkTrace(i);                                 \
 }
+#else
+#define BX_LINK_TRACE(i) BX_NEXT_TRACE(i)
+#endif
 
 #define BX_NEXT_INSTR(i) {                             \
   BX_COMMIT_INSTRUCTION(i);                            \
@@ -5661,6 +5760,18 @@ class bxInstruction_c;
   BX_EXECUTE_INSTRUCTION(i);                           \
 }
 
+#if BX_ENABLE_INSTRUCTION_FUSION
+// commit the first instruction of a fused pair and advance to the second
+// one, which the fused handler executes inline
+#define BX_NEXT_FUSED_INSTR(i) {                       \
+  BX_COMMIT_INSTRUCTION(i);                            \
+  if (BX_CPU_THIS_PTR async_event) return;             \
+  ++i;                                                 \
+  BX_INSTR_BEFORE_EXECUTION(BX_CPU_ID, (i));           \
+  RIP += (i)->ilen();                                  \
+}
+#endif
+
 #else // BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
 
 #define BX_NEXT_TRACE(i) { return; }
@@ -29,9 +29,10 @@
 #define InstrumentTLBFlush 0
 #define InstrumentStackPrefetch 0
 #define InstrumentSMC 0
+#define InstrumentFusion 0
 
 // indicate if any of the CPU statistics was compiled in
-#define InstrumentCPU (InstrumentICACHE + InstrumentTLB + InstrumentTLBFlush + InstrumentStackPrefetch + InstrumentSMC)
+#define InstrumentCPU (InstrumentICACHE + InstrumentTLB + InstrumentTLBFlush + InstrumentStackPrefetch + InstrumentSMC + InstrumentFusion)
 
 struct bx_cpu_statistics
 {
@@ -58,12 +59,19 @@ struct bx_cpu_statistics
   // self modifying code statistics
   Bit64u smc;
 
+  // fused instruction pairs statistics
+  Bit64u fusedCmpJcc;
+  Bit64u fusedDecJcc;
+  Bit64u fusedPushPop;
+  Bit64u fusedMovAlu;
+
   bx_cpu_statistics():
       iCacheLookups(0), iCachePrefetch(0), iCacheMisses(0),
       tlbLookups(0), tlbExecuteLookups(0), tlbWriteLookups(0),
       tlbMisses(0), tlbExecuteMisses(0), tlbWriteMisses(0),
       tlbGlobalFlushes(0), tlbNonGlobalFlushes(0),
-      stackPrefetch(0), smc(0) {}
+      stackPrefetch(0), smc(0),
+      fusedCmpJcc(0), fusedDecJcc(0), fusedPushPop(0), fusedMovAlu(0) {}
   
 };
 
@@ -99,4 +107,10 @@ struct bx_cpu_statistics
   #define INC_SMC_STAT(stat)
 #endif
 
+#if InstrumentFusion
+  #define INC_FUSION_STAT(stat) INC_CPU_STAT(stat)
+#else
+  #define INC_FUSION_STAT(stat)
+#endif
+
 #endif
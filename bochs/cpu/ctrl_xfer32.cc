@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "cpustats.h"
+
 #if BX_CPU_LEVEL >= 3
 
 BX_CPP_INLINE void BX_CPP_AttrRegparmN(1) BX_CPU_C::branch_near32(Bit32u new_EIP)
@@ -487,6 +489,71 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::JNLE_Jd(bxInstruction_c *i)
   BX_NEXT_INSTR(i); // trace can continue over non-taken branch
 }
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+
+// CMP/TEST/DEC fused with the following Jcc (see fuseTrace in icache.cc).
+// The branch condition is computed from the operands of the first
+// instruction, lazy flags are still updated for the code that follows.
+
+#define BX_FUSED_JCC32(i, taken, stat) {                        \
+  BX_NEXT_FUSED_INSTR(i);                                       \
+  INC_FUSION_STAT(stat);                                        \
+  if (taken) {                                                  \
+    Bit32u new_EIP = EIP + (Bit32s) i->Id();                    \
+    branch_near32(new_EIP);                                     \
+    BX_INSTR_CNEAR_BRANCH_TAKEN(BX_CPU_ID, PREV_RIP, new_EIP);  \
+    BX_LINK_TRACE(i);                                           \
+  }                                                             \
+  BX_INSTR_CNEAR_BRANCH_NOT_TAKEN(BX_CPU_ID, PREV_RIP);         \
+  BX_NEXT_INSTR(i);                                             \
+}
+
+#define BX_FUSED_CMP32_JD(name, src1, src2)                     \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name##_Jd(bxInstruction_c *i) \
+{                                                               \
+  Bit32u op1_32 = (src1);                                       \
+  Bit32u op2_32 = (src2);                                       \
+  Bit32u diff_32 = op1_32 - op2_32;                             \
+                                                                \
+  SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, diff_32);             \
+                                                                \
+  bool taken = bx_cmp_condition_32(i[1].fusedCond(), op1_32, op2_32); \
+  BX_FUSED_JCC32(i, taken, fusedCmpJcc);                        \
+}
+
+#define BX_FUSED_TEST32_JD(name, src1, src2)                    \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name##_Jd(bxInstruction_c *i) \
+{                                                               \
+  Bit32u op1_32 = (src1) & (src2);                              \
+                                                                \
+  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);                            \
+                                                                \
+  bool taken = bx_cmp_condition_32(i[1].fusedCond(), op1_32, 0); \
+  BX_FUSED_JCC32(i, taken, fusedCmpJcc);                        \
+}
+
+BX_FUSED_CMP32_JD(CMP_GdEdR, BX_READ_32BIT_REG(i->dst()), BX_READ_32BIT_REG(i->src()))
+BX_FUSED_CMP32_JD(CMP_EdIdR, BX_READ_32BIT_REG(i->dst()), i->Id())
+BX_FUSED_CMP32_JD(CMP_GdEdM, BX_READ_32BIT_REG(i->dst()), read_virtual_dword(i->seg(), BX_CPU_RESOLVE_ADDR(i)))
+BX_FUSED_CMP32_JD(CMP_EdGdM, read_virtual_dword(i->seg(), BX_CPU_RESOLVE_ADDR(i)), BX_READ_32BIT_REG(i->src()))
+BX_FUSED_CMP32_JD(CMP_EdIdM, read_virtual_dword(i->seg(), BX_CPU_RESOLVE_ADDR(i)), i->Id())
+
+BX_FUSED_TEST32_JD(TEST_EdGdR, BX_READ_32BIT_REG(i->dst()), BX_READ_32BIT_REG(i->src()))
+BX_FUSED_TEST32_JD(TEST_EdIdR, BX_READ_32BIT_REG(i->dst()), i->Id())
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EdR_Jd(bxInstruction_c *i)
+{
+  Bit32u erx = --BX_READ_32BIT_REG(i->dst());
+  SET_FLAGS_OSZAP_SUB_32(erx + 1, 0, erx);
+  BX_CLEAR_64BIT_HIGH(i->dst());
+
+  // DEC leaves CF alone, Jcc conditions depending on CF are never fused
+  bool taken = bx_cmp_condition_32(i[1].fusedCond(), erx + 1, 1);
+  BX_FUSED_JCC32(i, taken, fusedDecJcc);
+}
+
+#endif
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::JMP_Ap(bxInstruction_c *i)
 {
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
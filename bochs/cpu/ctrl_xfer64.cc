@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "cpustats.h"
+
 #if BX_SUPPORT_X86_64
 
 BX_CPP_INLINE void BX_CPP_AttrRegparmN(1) BX_CPU_C::branch_near64(bxInstruction_c *i)
@@ -407,6 +409,89 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::JNLE_Jq(bxInstruction_c *i)
   BX_NEXT_INSTR(i); // trace can continue over non-taken branch
 }
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+
+// CMP/TEST/DEC fused with the following Jcc (see fuseTrace in icache.cc).
+// The branch condition is computed from the operands of the first
+// instruction, lazy flags are still updated for the code that follows.
+
+#define BX_FUSED_JCC64(i, taken, stat) {                        \
+  BX_NEXT_FUSED_INSTR(i);                                       \
+  INC_FUSION_STAT(stat);                                        \
+  if (taken) {                                                  \
+    branch_near64(i);                                           \
+    BX_INSTR_CNEAR_BRANCH_TAKEN(BX_CPU_ID, PREV_RIP, RIP);      \
+    BX_LINK_TRACE(i);                                           \
+  }                                                             \
+  BX_INSTR_CNEAR_BRANCH_NOT_TAKEN(BX_CPU_ID, PREV_RIP);         \
+  BX_NEXT_INSTR(i);                                             \
+}
+
+#define BX_FUSED_CMP_JQ(size, name, src1, src2)                 \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name##_Jq(bxInstruction_c *i) \
+{                                                               \
+  Bit##size##u op1 = (src1);                                    \
+  Bit##size##u op2 = (src2);                                    \
+  Bit##size##u diff = op1 - op2;                                \
+                                                                \
+  SET_FLAGS_OSZAPC_SUB_##size(op1, op2, diff);                  \
+                                                                \
+  bool taken = bx_cmp_condition_##size(i[1].fusedCond(), op1, op2); \
+  BX_FUSED_JCC64(i, taken, fusedCmpJcc);                        \
+}
+
+#define BX_FUSED_TEST_JQ(size, name, src1, src2)                \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name##_Jq(bxInstruction_c *i) \
+{                                                               \
+  Bit##size##u op1 = (src1) & (src2);                           \
+                                                                \
+  SET_FLAGS_OSZAPC_LOGIC_##size(op1);                           \
+                                                                \
+  bool taken = bx_cmp_condition_##size(i[1].fusedCond(), op1, 0); \
+  BX_FUSED_JCC64(i, taken, fusedCmpJcc);                        \
+}
+
+BX_FUSED_CMP_JQ(32, CMP_GdEdR, BX_READ_32BIT_REG(i->dst()), BX_READ_32BIT_REG(i->src()))
+BX_FUSED_CMP_JQ(32, CMP_EdIdR, BX_READ_32BIT_REG(i->dst()), i->Id())
+BX_FUSED_CMP_JQ(32, CMP_GdEdM, BX_READ_32BIT_REG(i->dst()), read_virtual_dword(i->seg(), BX_CPU_RESOLVE_ADDR(i)))
+BX_FUSED_CMP_JQ(32, CMP_EdGdM, read_virtual_dword(i->seg(), BX_CPU_RESOLVE_ADDR(i)), BX_READ_32BIT_REG(i->src()))
+BX_FUSED_CMP_JQ(32, CMP_EdIdM, read_virtual_dword(i->seg(), BX_CPU_RESOLVE_ADDR(i)), i->Id())
+
+BX_FUSED_TEST_JQ(32, TEST_EdGdR, BX_READ_32BIT_REG(i->dst()), BX_READ_32BIT_REG(i->src()))
+BX_FUSED_TEST_JQ(32, TEST_EdIdR, BX_READ_32BIT_REG(i->dst()), i->Id())
+
+BX_FUSED_CMP_JQ(64, CMP_GqEqR, BX_READ_64BIT_REG(i->dst()), BX_READ_64BIT_REG(i->src()))
+BX_FUSED_CMP_JQ(64, CMP_EqIdR, BX_READ_64BIT_REG(i->dst()), (Bit32s) i->Id())
+BX_FUSED_CMP_JQ(64, CMP_GqEqM, BX_READ_64BIT_REG(i->dst()), read_linear_qword(i->seg(), get_laddr64(i->seg(), BX_CPU_RESOLVE_ADDR_64(i))))
+BX_FUSED_CMP_JQ(64, CMP_EqGqM, read_linear_qword(i->seg(), get_laddr64(i->seg(), BX_CPU_RESOLVE_ADDR_64(i))), BX_READ_64BIT_REG(i->src()))
+BX_FUSED_CMP_JQ(64, CMP_EqIdM, read_linear_qword(i->seg(), get_laddr64(i->seg(), BX_CPU_RESOLVE_ADDR_64(i))), (Bit32s) i->Id())
+
+BX_FUSED_TEST_JQ(64, TEST_EqGqR, BX_READ_64BIT_REG(i->dst()), BX_READ_64BIT_REG(i->src()))
+BX_FUSED_TEST_JQ(64, TEST_EqIdR, BX_READ_64BIT_REG(i->dst()), (Bit32s) i->Id())
+
+// DEC leaves CF alone, Jcc conditions depending on CF are never fused
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EdR_Jq(bxInstruction_c *i)
+{
+  Bit32u erx = --BX_READ_32BIT_REG(i->dst());
+  SET_FLAGS_OSZAP_SUB_32(erx + 1, 0, erx);
+  BX_CLEAR_64BIT_HIGH(i->dst());
+
+  bool taken = bx_cmp_condition_32(i[1].fusedCond(), erx + 1, 1);
+  BX_FUSED_JCC64(i, taken, fusedDecJcc);
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EqR_Jq(bxInstruction_c *i)
+{
+  Bit64u rrx = --BX_READ_64BIT_REG(i->dst());
+  SET_FLAGS_OSZAP_SUB_64(rrx + 1, 0, rrx);
+
+  bool taken = bx_cmp_condition_64(i[1].fusedCond(), rrx + 1, 1);
+  BX_FUSED_JCC64(i, taken, fusedDecJcc);
+}
+
+#endif
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::JMP_EqR(bxInstruction_c *i)
 {
   Bit64u op1_64 = BX_READ_64BIT_REG(i->dst());
@@ -223,6 +223,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::XCHG_EwGwR(bxInstruction_c *i)
   if (bx_dbg.magic_break_enabled && (i->src() == 3) && (i->dst() == 3))
   {
     BX_CPU_THIS_PTR magic_break = 1;
+    // return to the debugger right after this instruction
+    BX_CPU_THIS_PTR async_event |= BX_ASYNC_EVENT_STOP_TRACE;
     BX_NEXT_INSTR(i);
   }
 #endif
@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "cpustats.h"
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_EdIdM(bxInstruction_c *i)
 {
   bx_address eaddr = BX_CPU_RESOLVE_ADDR(i);
@@ -84,6 +86,49 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV32S_GdEdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+
+// MOV to a register followed by an ALU operation on the same register
+// (see fuseTrace in icache.cc), the moved value feeds the ALU directly
+
+#define BX_FUSED_MOV_ALU32(mov, load, alu, src, result, set_flags)     \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::mov##_##alu(bxInstruction_c *i)  \
+{                                                                      \
+  Bit32u op1_32 = (load);                                              \
+  BX_WRITE_32BIT_REGZ(i->dst(), op1_32);                               \
+                                                                       \
+  BX_NEXT_FUSED_INSTR(i);                                              \
+                                                                       \
+  Bit32u op2_32 = (src);                                               \
+  Bit32u result_32 = (result);                                         \
+  BX_WRITE_32BIT_REGZ(i->dst(), result_32);                            \
+                                                                       \
+  set_flags;                                                           \
+                                                                       \
+  INC_FUSION_STAT(fusedMovAlu);                                        \
+  BX_NEXT_INSTR(i);                                                    \
+}
+
+#define BX_FUSED_MOV_ALU32_OPS(mov, load)                                                                                                     \
+  BX_FUSED_MOV_ALU32(mov, load, ADD_GdEdR, BX_READ_32BIT_REG(i->src()), op1_32 + op2_32, SET_FLAGS_OSZAPC_ADD_32(op1_32, op2_32, result_32))  \
+  BX_FUSED_MOV_ALU32(mov, load, ADD_EdIdR, i->Id(), op1_32 + op2_32, SET_FLAGS_OSZAPC_ADD_32(op1_32, op2_32, result_32))                      \
+  BX_FUSED_MOV_ALU32(mov, load, SUB_GdEdR, BX_READ_32BIT_REG(i->src()), op1_32 - op2_32, SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, result_32))  \
+  BX_FUSED_MOV_ALU32(mov, load, SUB_EdIdR, i->Id(), op1_32 - op2_32, SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, result_32))                      \
+  BX_FUSED_MOV_ALU32(mov, load, AND_GdEdR, BX_READ_32BIT_REG(i->src()), op1_32 & op2_32, SET_FLAGS_OSZAPC_LOGIC_32(result_32))                \
+  BX_FUSED_MOV_ALU32(mov, load, AND_EdIdR, i->Id(), op1_32 & op2_32, SET_FLAGS_OSZAPC_LOGIC_32(result_32))                                    \
+  BX_FUSED_MOV_ALU32(mov, load, OR_GdEdR, BX_READ_32BIT_REG(i->src()), op1_32 | op2_32, SET_FLAGS_OSZAPC_LOGIC_32(result_32))                 \
+  BX_FUSED_MOV_ALU32(mov, load, OR_EdIdR, i->Id(), op1_32 | op2_32, SET_FLAGS_OSZAPC_LOGIC_32(result_32))                                     \
+  BX_FUSED_MOV_ALU32(mov, load, XOR_GdEdR, BX_READ_32BIT_REG(i->src()), op1_32 ^ op2_32, SET_FLAGS_OSZAPC_LOGIC_32(result_32))                \
+  BX_FUSED_MOV_ALU32(mov, load, XOR_EdIdR, i->Id(), op1_32 ^ op2_32, SET_FLAGS_OSZAPC_LOGIC_32(result_32))
+
+BX_FUSED_MOV_ALU32_OPS(MOV_GdEdR, BX_READ_32BIT_REG(i->src()))
+BX_FUSED_MOV_ALU32_OPS(MOV32_GdEdM, read_virtual_dword_32(i->seg(), (Bit32u) BX_CPU_RESOLVE_ADDR_32(i)))
+#if BX_SUPPORT_X86_64
+BX_FUSED_MOV_ALU32_OPS(MOV64_GdEdM, read_linear_dword(i->seg(), get_laddr64(i->seg(), BX_CPU_RESOLVE_ADDR_64(i))))
+#endif
+
+#endif
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LEA_GdM(bxInstruction_c *i)
 {
   Bit32u eaddr = (Bit32u) BX_CPU_RESOLVE_ADDR(i);
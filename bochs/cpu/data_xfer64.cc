@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "cpustats.h"
+
 #if BX_SUPPORT_X86_64
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_RRXIq(bxInstruction_c *i)
@@ -95,6 +97,46 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_GqEqR(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+
+// MOV to a register followed by an ALU operation on the same register
+// (see fuseTrace in icache.cc), the moved value feeds the ALU directly
+
+#define BX_FUSED_MOV_ALU64(mov, load, alu, src, result, set_flags)     \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::mov##_##alu(bxInstruction_c *i)  \
+{                                                                      \
+  Bit64u op1_64 = (load);                                              \
+  BX_WRITE_64BIT_REG(i->dst(), op1_64);                                \
+                                                                       \
+  BX_NEXT_FUSED_INSTR(i);                                              \
+                                                                       \
+  Bit64u op2_64 = (src);                                               \
+  Bit64u result_64 = (result);                                         \
+  BX_WRITE_64BIT_REG(i->dst(), result_64);                             \
+                                                                       \
+  set_flags;                                                           \
+                                                                       \
+  INC_FUSION_STAT(fusedMovAlu);                                        \
+  BX_NEXT_INSTR(i);                                                    \
+}
+
+#define BX_FUSED_MOV_ALU64_OPS(mov, load)                                                                                                     \
+  BX_FUSED_MOV_ALU64(mov, load, ADD_GqEqR, BX_READ_64BIT_REG(i->src()), op1_64 + op2_64, SET_FLAGS_OSZAPC_ADD_64(op1_64, op2_64, result_64))  \
+  BX_FUSED_MOV_ALU64(mov, load, ADD_EqIdR, (Bit32s) i->Id(), op1_64 + op2_64, SET_FLAGS_OSZAPC_ADD_64(op1_64, op2_64, result_64))             \
+  BX_FUSED_MOV_ALU64(mov, load, SUB_GqEqR, BX_READ_64BIT_REG(i->src()), op1_64 - op2_64, SET_FLAGS_OSZAPC_SUB_64(op1_64, op2_64, result_64))  \
+  BX_FUSED_MOV_ALU64(mov, load, SUB_EqIdR, (Bit32s) i->Id(), op1_64 - op2_64, SET_FLAGS_OSZAPC_SUB_64(op1_64, op2_64, result_64))             \
+  BX_FUSED_MOV_ALU64(mov, load, AND_GqEqR, BX_READ_64BIT_REG(i->src()), op1_64 & op2_64, SET_FLAGS_OSZAPC_LOGIC_64(result_64))                \
+  BX_FUSED_MOV_ALU64(mov, load, AND_EqIdR, (Bit32s) i->Id(), op1_64 & op2_64, SET_FLAGS_OSZAPC_LOGIC_64(result_64))                           \
+  BX_FUSED_MOV_ALU64(mov, load, OR_GqEqR, BX_READ_64BIT_REG(i->src()), op1_64 | op2_64, SET_FLAGS_OSZAPC_LOGIC_64(result_64))                 \
+  BX_FUSED_MOV_ALU64(mov, load, OR_EqIdR, (Bit32s) i->Id(), op1_64 | op2_64, SET_FLAGS_OSZAPC_LOGIC_64(result_64))                            \
+  BX_FUSED_MOV_ALU64(mov, load, XOR_GqEqR, BX_READ_64BIT_REG(i->src()), op1_64 ^ op2_64, SET_FLAGS_OSZAPC_LOGIC_64(result_64))                \
+  BX_FUSED_MOV_ALU64(mov, load, XOR_EqIdR, (Bit32s) i->Id(), op1_64 ^ op2_64, SET_FLAGS_OSZAPC_LOGIC_64(result_64))
+
+BX_FUSED_MOV_ALU64_OPS(MOV_GqEqR, BX_READ_64BIT_REG(i->src()))
+BX_FUSED_MOV_ALU64_OPS(MOV_GqEqM, read_linear_qword(i->seg(), get_laddr64(i->seg(), BX_CPU_RESOLVE_ADDR_64(i))))
+
+#endif
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LEA_GqM(bxInstruction_c *i)
 {
   bx_address eaddr = BX_CPU_RESOLVE_ADDR_64(i);
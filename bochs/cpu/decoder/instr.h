@@ -204,6 +204,12 @@ public:
   BX_CPP_INLINE Bit64u Iq() const  { return IqForm.Iq; }
 #endif
 
+  // condition code (0..15) of a Jcc fused with the preceding instruction,
+  // kept in the SIB scale field which is never used by Jcc (the second
+  // immediate holds the trace link timestamp)
+  BX_CPP_INLINE unsigned fusedCond() const { return metaData[BX_INSTR_METADATA_SCALE]; }
+  BX_CPP_INLINE void setFusedCond(unsigned cond) { metaData[BX_INSTR_METADATA_SCALE] = cond; }
+
   // Info in the metaInfo field.
   // Note: the 'L' at the end of certain flags, means the value returned
   // is for Logical comparisons, eg if (i->os32L() && i->as32L()).  If you
@@ -0,0 +1,474 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Differential test of the host accelerated floating point paths against
+// plain softfloat: every result and every exception flag must be the same.
+// Run it with 'make check', at the top level or in cpu/fpu.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "config.h"
+
+// the softfloat headers as softfloat.cc sees them
+#define FLOAT128
+#define USE_estimateDiv128To64
+#define USE_estimateSqrt32
+#include "softfloat.h"
+#include "softfloat-round-pack.h"
+#include "softfloat-macros.h"
+#include "softfloat-specialize.h"
+
+#if BX_SUPPORT_EVEX
+// xmm.h has an EVEX rounding control helper that takes the decoded
+// instruction. The test never calls it, so a stand-in with the fields
+// it reads is enough to compile it without the decoder.
+class bxInstruction_c {
+public:
+  unsigned modC0() const { return 0; }
+  unsigned getEvexb() const { return 0; }
+  unsigned getRC() const { return 0; }
+};
+#endif
+
+#include "cpu/xmm.h"
+#include "cpu/simd_pfp.h"
+
+#if BX_SUPPORT_FASTX80
+
+// softfloat once more without the fast paths, as the reference. It gets
+// its own copy of the types too, or argument dependent lookup would mix
+// up its functions with the real ones.
+#undef _SOFTFLOAT_H_
+#undef _SOFTFLOAT_ROUND_PACK_H_
+#undef _SOFTFLOAT_MACROS_H_
+#undef _SOFTFLOAT_SPECIALIZE_H_
+#undef BX_SUPPORT_FASTX80
+#define BX_SUPPORT_FASTX80 0
+namespace softfloat_ref {
+#include "softfloat.cc"
+#include "softfloat-round-pack.cc"
+#include "softfloat-specialize.cc"
+}
+#undef BX_SUPPORT_FASTX80
+#define BX_SUPPORT_FASTX80 1
+
+#endif
+
+static unsigned failures;
+
+#if BX_SUPPORT_HOST_SSE_PFP || BX_SUPPORT_FASTX80
+
+static Bit64u rnd_state = BX_CONST64(0x9e3779b97f4a7c15);
+
+static Bit64u rnd64(void)
+{
+  // xorshift64*
+  rnd_state ^= rnd_state >> 12;
+  rnd_state ^= rnd_state << 25;
+  rnd_state ^= rnd_state >> 27;
+  return rnd_state * BX_CONST64(0x2545f4914f6cdd1d);
+}
+
+static unsigned rnd(unsigned n)
+{
+  return (unsigned)(rnd64() >> 32) % n;
+}
+
+static const char *op_name[] = { "add", "sub", "mul", "div", "sqrt" };
+
+static void report(const char *what, unsigned op, const char *fmt, ...)
+{
+  va_list ap;
+
+  // don't flood the output when something is badly broken
+  if (++failures > 50) return;
+
+  printf("FAIL %s%s ", op_name[op], what);
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+static float_status_t random_status(void)
+{
+  float_status_t status;
+
+#ifdef FLOATX80
+  // mostly 80-bit precision, where the floatx80 fast paths may be taken
+  static const int precision[] = { 32, 64, 80, 80, 80, 80, 80, 80 };
+  status.float_rounding_precision = precision[rnd(8)];
+#endif
+  // mostly round to nearest, where the host paths may be taken
+  status.float_rounding_mode = rnd(4);
+  if (rnd(8) < 5) status.float_rounding_mode = float_round_nearest_even;
+  status.float_exception_flags = 0;
+  status.float_exception_masks = rnd(4) ? float_all_exceptions_mask : rnd(64);
+  status.float_suppress_exception = 0;
+  status.float_nan_handling_mode = float_first_operand_nan;
+  status.flush_underflow_to_zero = rnd(4) == 0;
+  status.denormals_are_zeros = rnd(4) == 0;
+  return status;
+}
+
+#endif // BX_SUPPORT_HOST_SSE_PFP || BX_SUPPORT_FASTX80
+
+#if BX_SUPPORT_HOST_SSE_PFP
+
+// Operands are drawn from a few classes: random bit patterns (mostly
+// inexact results), short significands near one (exact results), numbers
+// close to the overflow and underflow thresholds, and special values.
+
+static float32 random_float32(void)
+{
+  static const float32 special[] = {
+    0x00000000, 0x80000000, 0x3f800000, 0xbf800000, 0x7f800000, 0xff800000,
+    0x7fc00000, 0xffc00000, 0x7fa00000, 0x00000001, 0x807fffff, 0x00800000,
+    0x80800001, 0x7f7fffff, 0xff7fffff, 0x34000000, 0x4b800000
+  };
+
+  Bit32u r = (Bit32u) rnd64();
+
+  switch(rnd(5)) {
+    case 0:
+      return r;
+    case 1:
+    case 2:
+      // up to 8 significant bits, exponent within 2^-20..2^20
+      return (r & 0x80000000) | ((127 - 20 + rnd(41)) << 23) | (r & 0x007f8000);
+    case 3:
+      return (r & 0x807fffff) | ((rnd(2) ? 1 + rnd(24) : 230 + rnd(25)) << 23);
+    default:
+      return special[rnd(sizeof(special) / sizeof(special[0]))];
+  }
+}
+
+static float64 random_float64(void)
+{
+  static const float64 special[] = {
+    BX_CONST64(0x0000000000000000), BX_CONST64(0x8000000000000000),
+    BX_CONST64(0x3ff0000000000000), BX_CONST64(0xbff0000000000000),
+    BX_CONST64(0x7ff0000000000000), BX_CONST64(0xfff0000000000000),
+    BX_CONST64(0x7ff8000000000000), BX_CONST64(0x7ff4000000000000),
+    BX_CONST64(0x0000000000000001), BX_CONST64(0x800fffffffffffff),
+    BX_CONST64(0x0010000000000000), BX_CONST64(0x7fefffffffffffff),
+    BX_CONST64(0x2000000000000000), BX_CONST64(0x5fe0000000000000),
+    BX_CONST64(0x1ff0000000000000), BX_CONST64(0x6000000000000000)
+  };
+
+  Bit64u r = rnd64();
+
+  switch(rnd(5)) {
+    case 0:
+      return r;
+    case 1:
+    case 2:
+      // up to 20 significant bits, exponent within 2^-40..2^40
+      return (r & BX_CONST64(0x8000000000000000)) |
+             ((Bit64u)(1023 - 40 + rnd(81)) << 52) | (r & BX_CONST64(0x000ffff800000000));
+    case 3:
+      // around the limits of the host exactness checks
+      return (r & BX_CONST64(0x800fffffffffffff)) |
+             ((Bit64u)(rnd(2) ? 1023 - 515 + rnd(9) : 1023 + 507 + rnd(9)) << 52);
+    default:
+      return special[rnd(sizeof(special) / sizeof(special[0]))];
+  }
+}
+
+// MXCSR keeps only the IEEE flags, softfloat may also report x87 C1
+static int sse_flags(const float_status_t &status)
+{
+  return status.float_exception_flags & float_all_exceptions_mask;
+}
+
+static float32 ref_float32(unsigned op, float32 a, float32 b, float_status_t &status)
+{
+  switch(op) {
+    case BX_HOST_SSE_ADD: return float32_add(a, b, status);
+    case BX_HOST_SSE_SUB: return float32_sub(a, b, status);
+    case BX_HOST_SSE_MUL: return float32_mul(a, b, status);
+    case BX_HOST_SSE_DIV: return float32_div(a, b, status);
+    default:
+      return float32_sqrt(b, status);
+  }
+}
+
+static float64 ref_float64(unsigned op, float64 a, float64 b, float_status_t &status)
+{
+  switch(op) {
+    case BX_HOST_SSE_ADD: return float64_add(a, b, status);
+    case BX_HOST_SSE_SUB: return float64_sub(a, b, status);
+    case BX_HOST_SSE_MUL: return float64_mul(a, b, status);
+    case BX_HOST_SSE_DIV: return float64_div(a, b, status);
+    default:
+      return float64_sqrt(b, status);
+  }
+}
+
+static unsigned long test_host_sse_ps(unsigned op, unsigned long count)
+{
+  unsigned long taken = 0;
+
+  for (unsigned long i = 0; i < count; i++) {
+    BxPackedXmmRegister op1, op2, ref;
+    float_status_t status = random_status(), ref_status = status;
+
+    for (unsigned n = 0; n < 4; n++) {
+      op1.xmm32u(n) = random_float32();
+      op2.xmm32u(n) = random_float32();
+    }
+    // SQRTPS has a single source
+    if (op == BX_HOST_SSE_SQRT) op1 = op2;
+
+    for (unsigned n = 0; n < 4; n++)
+      ref.xmm32u(n) = ref_float32(op, op1.xmm32u(n), op2.xmm32u(n), ref_status);
+
+    BxPackedXmmRegister src = op1;
+    if (! host_sse_ps(op, &op1, &op2, status))
+      continue;
+    taken++;
+
+    for (unsigned n = 0; n < 4; n++) {
+      if (op1.xmm32u(n) != ref.xmm32u(n)) {
+        report("ps", op, "%08x, %08x: host %08x softfloat %08x\n",
+          src.xmm32u(n), op2.xmm32u(n), op1.xmm32u(n), ref.xmm32u(n));
+      }
+    }
+    if (sse_flags(status) != sse_flags(ref_status)) {
+      report("ps", op, "%08x %08x %08x %08x, %08x %08x %08x %08x: host flags %02x softfloat flags %02x\n",
+        src.xmm32u(0), src.xmm32u(1), src.xmm32u(2), src.xmm32u(3),
+        op2.xmm32u(0), op2.xmm32u(1), op2.xmm32u(2), op2.xmm32u(3),
+        sse_flags(status), sse_flags(ref_status));
+    }
+  }
+
+  return taken;
+}
+
+static unsigned long test_host_sse_pd(unsigned op, unsigned long count)
+{
+  unsigned long taken = 0;
+
+  for (unsigned long i = 0; i < count; i++) {
+    BxPackedXmmRegister op1, op2, ref;
+    float_status_t status = random_status(), ref_status = status;
+
+    for (unsigned n = 0; n < 2; n++) {
+      op1.xmm64u(n) = random_float64();
+      op2.xmm64u(n) = random_float64();
+    }
+    // SQRTPD has a single source
+    if (op == BX_HOST_SSE_SQRT) op1 = op2;
+
+    for (unsigned n = 0; n < 2; n++)
+      ref.xmm64u(n) = ref_float64(op, op1.xmm64u(n), op2.xmm64u(n), ref_status);
+
+    BxPackedXmmRegister src = op1;
+    if (! host_sse_pd(op, &op1, &op2, status))
+      continue;
+    taken++;
+
+    for (unsigned n = 0; n < 2; n++) {
+      if (op1.xmm64u(n) != ref.xmm64u(n)) {
+        report("pd", op, "%016llx, %016llx: host %016llx softfloat %016llx\n",
+          (unsigned long long) src.xmm64u(n), (unsigned long long) op2.xmm64u(n),
+          (unsigned long long) op1.xmm64u(n), (unsigned long long) ref.xmm64u(n));
+      }
+    }
+    if (sse_flags(status) != sse_flags(ref_status)) {
+      report("pd", op, "%016llx %016llx, %016llx %016llx: host flags %02x softfloat flags %02x\n",
+        (unsigned long long) src.xmm64u(0), (unsigned long long) src.xmm64u(1),
+        (unsigned long long) op2.xmm64u(0), (unsigned long long) op2.xmm64u(1),
+        sse_flags(status), sse_flags(ref_status));
+    }
+  }
+
+  return taken;
+}
+
+#endif // BX_SUPPORT_HOST_SSE_PFP
+
+#if BX_SUPPORT_FASTX80
+
+enum { FASTX80_ADD, FASTX80_SUB, FASTX80_MUL, FASTX80_DIV };
+
+static floatx80 random_floatx80(void)
+{
+  static const floatx80 special[] = {
+    { BX_CONST64(0x0000000000000000), 0x0000 },  // zero
+    { BX_CONST64(0x8000000000000000), 0x3fff },  // one
+    { BX_CONST64(0x8000000000000000), 0x7fff },  // infinity
+    { BX_CONST64(0xc000000000000000), 0x7fff },  // quiet NaN
+    { BX_CONST64(0xa000000000000000), 0x7fff },  // signaling NaN
+    { BX_CONST64(0x0000000000000001), 0x0000 },  // denormal
+    { BX_CONST64(0x8000000000000001), 0x0000 },  // pseudo-denormal
+    { BX_CONST64(0x4000000000000000), 0x3fff },  // unnormal
+    { BX_CONST64(0xffffffffffffffff), 0x7ffe },  // largest normal
+    { BX_CONST64(0x8000000000000000), 0x0001 }   // smallest normal
+  };
+
+  floatx80 a;
+  Bit64u r = rnd64();
+  Bit16u sign = rnd(2) << 15;
+
+  switch(rnd(5)) {
+    case 0:
+      a.exp = (Bit16u) rnd64();
+      a.fraction = r;
+      return a;
+    case 1:
+    case 2:
+      // up to 32 significant bits, exponent within 2^-64..2^64
+      a.exp = sign | (0x3fff - 64 + rnd(129));
+      a.fraction = BX_CONST64(0x8000000000000000) | (r & BX_CONST64(0xffffffff00000000));
+      return a;
+    case 3:
+      // around the limits of the fast paths and of the exponent range
+      switch(rnd(4)) {
+        case 0:  a.exp = 0x3fff - 8000 - 4 + rnd(9); break;
+        case 1:  a.exp = 0x3fff + 8000 - 4 + rnd(9); break;
+        case 2:  a.exp = 1 + rnd(64); break;
+        default: a.exp = 0x7ffe - rnd(64); break;
+      }
+      a.exp |= sign;
+      a.fraction = BX_CONST64(0x8000000000000000) | r;
+      return a;
+    default:
+      a = special[rnd(sizeof(special) / sizeof(special[0]))];
+      a.exp |= sign;
+      return a;
+  }
+}
+
+static floatx80 fastx80_op(unsigned op, floatx80 a, floatx80 b, float_status_t &status)
+{
+  switch(op) {
+    case FASTX80_ADD: return floatx80_add(a, b, status);
+    case FASTX80_SUB: return floatx80_sub(a, b, status);
+    case FASTX80_MUL: return floatx80_mul(a, b, status);
+    default:
+      return floatx80_div(a, b, status);
+  }
+}
+
+static floatx80 ref_floatx80(unsigned op, floatx80 a, floatx80 b, float_status_t &status)
+{
+  softfloat_ref::floatx80 ra, rb, rz;
+  softfloat_ref::float_status_t rstatus;
+
+  ra.exp = a.exp; ra.fraction = a.fraction;
+  rb.exp = b.exp; rb.fraction = b.fraction;
+  memcpy(&rstatus, &status, sizeof(rstatus));
+
+  switch(op) {
+    case FASTX80_ADD: rz = softfloat_ref::floatx80_add(ra, rb, rstatus); break;
+    case FASTX80_SUB: rz = softfloat_ref::floatx80_sub(ra, rb, rstatus); break;
+    case FASTX80_MUL: rz = softfloat_ref::floatx80_mul(ra, rb, rstatus); break;
+    default:
+      rz = softfloat_ref::floatx80_div(ra, rb, rstatus); break;
+  }
+
+  memcpy(&status, &rstatus, sizeof(status));
+  floatx80 z;
+  z.exp = rz.exp; z.fraction = rz.fraction;
+  return z;
+}
+
+// Same conditions as fastx80_usable() in softfloat.cc
+static bool fastx80_eligible(floatx80 a, const float_status_t &status)
+{
+  Bit32s aExp = a.exp & 0x7fff;
+  return status.float_rounding_mode == float_round_nearest_even &&
+    status.float_rounding_precision == 80 &&
+    (a.fraction & BX_CONST64(0x8000000000000000)) &&
+    0x3fff - 8000 <= aExp && aExp <= 0x3fff + 8000;
+}
+
+static unsigned long test_fastx80(unsigned op, unsigned long count)
+{
+  unsigned long eligible = 0;
+
+  for (unsigned long i = 0; i < count; i++) {
+    float_status_t status = random_status(), ref_status = status;
+    floatx80 a = random_floatx80(), b = random_floatx80();
+
+    if (fastx80_eligible(a, status) && fastx80_eligible(b, status))
+      eligible++;
+
+    floatx80 z = fastx80_op(op, a, b, status);
+    floatx80 ref = ref_floatx80(op, a, b, ref_status);
+
+    // x87 reports all flags including C1, so compare them all
+    if (z.exp != ref.exp || z.fraction != ref.fraction ||
+        status.float_exception_flags != ref_status.float_exception_flags)
+    {
+      report("x80", op, "%04x:%016llx, %04x:%016llx: fast %04x:%016llx flags %03x softfloat %04x:%016llx flags %03x\n",
+        a.exp, (unsigned long long) a.fraction, b.exp, (unsigned long long) b.fraction,
+        z.exp, (unsigned long long) z.fraction, status.float_exception_flags,
+        ref.exp, (unsigned long long) ref.fraction, ref_status.float_exception_flags);
+    }
+  }
+
+  return eligible;
+}
+
+#endif // BX_SUPPORT_FASTX80
+
+int main(int argc, char *argv[])
+{
+#if BX_SUPPORT_HOST_SSE_PFP || BX_SUPPORT_FASTX80
+  unsigned long count = 200000;
+
+  if (argc > 1) count = strtoul(argv[1], NULL, 0);
+  if (argc > 2) rnd_state = strtoull(argv[2], NULL, 0) | 1;
+#endif
+
+#if BX_SUPPORT_HOST_SSE_PFP
+  for (unsigned op = BX_HOST_SSE_ADD; op <= BX_HOST_SSE_SQRT; op++) {
+    unsigned long taken = test_host_sse_ps(op, count);
+    printf("host sse %-4sps: %lu of %lu on the host\n", op_name[op], taken, count);
+    taken = test_host_sse_pd(op, count);
+    printf("host sse %-4spd: %lu of %lu on the host\n", op_name[op], taken, count);
+  }
+#else
+  printf("host sse packed fp: not compiled in\n");
+#endif
+
+#if BX_SUPPORT_FASTX80
+  for (unsigned op = FASTX80_ADD; op <= FASTX80_DIV; op++) {
+    unsigned long eligible = test_fastx80(op, count);
+    printf("fastx80 %-4s: %lu of %lu for the fast path\n", op_name[op], eligible, count);
+  }
+#else
+  printf("fastx80: not compiled in\n");
+#endif
+
+  if (failures) {
+    printf("%u mismatches\n", failures);
+    return 1;
+  }
+
+  printf("no mismatches\n");
+  return 0;
+}
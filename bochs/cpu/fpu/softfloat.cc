@@ -3032,6 +3032,146 @@ floatx80 floatx80_round_to_int(floatx80 a, float_status_t &status)
     return z;
 }
 
+#if BX_SUPPORT_FASTX80
+
+/*----------------------------------------------------------------------------
+| Fast paths for extended double-precision add, subtract, multiply and
+| divide.  They handle the common case of normal operands with an exponent
+| within 8000 of the bias, round to nearest and 80-bit precision, where the
+| result can neither overflow nor underflow, so only the inexact and
+| rounded up (C1) flags remain to be raised.  The significands are combined
+| with the host 64x64->128 bit multiply and 128/64 bit divide.  Anything
+| else returns 0 and is handled by the general code.
+*----------------------------------------------------------------------------*/
+
+BX_CPP_INLINE int fastx80_operand(floatx80 a)
+{
+    Bit32s aExp = extractFloatx80Exp(a);
+    return (extractFloatx80Frac(a) & BX_CONST64(0x8000000000000000)) &&
+        (0x3FFF - 8000 <= aExp) && (aExp <= 0x3FFF + 8000);
+}
+
+BX_CPP_INLINE int fastx80_usable(floatx80 a, floatx80 b, float_status_t &status)
+{
+    return get_float_rounding_mode(status) == float_round_nearest_even &&
+        get_float_rounding_precision(status) == 80 &&
+        fastx80_operand(a) && fastx80_operand(b);
+}
+
+/*----------------------------------------------------------------------------
+| Rounds the normalized significand `zSig0' with the extra bits `zSig1' to
+| nearest even, like roundAndPackFloatx80 does for a result far from
+| overflow and underflow.
+*----------------------------------------------------------------------------*/
+
+BX_CPP_INLINE floatx80 fastx80_round_pack(int zSign, Bit32s zExp, Bit64u zSig0, Bit64u zSig1, float_status_t &status)
+{
+    if (zSig1) {
+        float_raise(status, float_flag_inexact);
+        // above half, or a tie with odd significand
+        if ((Bit64s) zSig1 < 0 && ((Bit64u) (zSig1<<1) || (zSig0 & 1))) {
+            set_float_rounding_up(status);
+            if (++zSig0 == 0) {
+                zSig0 = BX_CONST64(0x8000000000000000);
+                ++zExp;
+            }
+        }
+    }
+    return packFloatx80(zSign, zExp, zSig0);
+}
+
+static int floatx80_add_fast(floatx80 a, floatx80 b, int bSign, floatx80 &z, float_status_t &status)
+{
+    if (! fastx80_usable(a, b, status)) return 0;
+
+    int zSign = extractFloatx80Sign(a);
+    Bit32s aExp = extractFloatx80Exp(a), bExp = extractFloatx80Exp(b);
+    Bit64u aSig = extractFloatx80Frac(a), bSig = extractFloatx80Frac(b);
+    Bit64u zSig0, zSig1 = 0;
+
+    // make `a' the operand with the larger magnitude
+    if (aExp < bExp || (aExp == bExp && aSig < bSig)) {
+        Bit32s tExp = aExp; aExp = bExp; bExp = tExp;
+        Bit64u tSig = aSig; aSig = bSig; bSig = tSig;
+        int tSign = zSign; zSign = bSign; bSign = tSign;
+    }
+    Bit32s expDiff = aExp - bExp;
+    if (zSign == bSign) {
+        if (expDiff) shift64ExtraRightJamming(bSig, 0, expDiff, &bSig, &zSig1);
+        zSig0 = aSig + bSig;
+        if (zSig0 < aSig) {
+            shift64ExtraRightJamming(zSig0, zSig1, 1, &zSig0, &zSig1);
+            zSig0 |= BX_CONST64(0x8000000000000000);
+            ++aExp;
+        }
+    }
+    else {
+        if (expDiff == 0 && aSig == bSig) {
+            z = packFloatx80(0, 0, 0);
+            return 1;
+        }
+        if (expDiff) shift128RightJamming(bSig, 0, expDiff, &bSig, &zSig1);
+        sub128(aSig, 0, bSig, zSig1, &zSig0, &zSig1);
+        if (zSig0 == 0) {
+            zSig0 = zSig1;
+            zSig1 = 0;
+            aExp -= 64;
+        }
+        int shiftCount = countLeadingZeros64(zSig0);
+        shortShift128Left(zSig0, zSig1, shiftCount, &zSig0, &zSig1);
+        aExp -= shiftCount;
+    }
+    z = fastx80_round_pack(zSign, aExp, zSig0, zSig1, status);
+    return 1;
+}
+
+static int floatx80_mul_fast(floatx80 a, floatx80 b, floatx80 &z, float_status_t &status)
+{
+    if (! fastx80_usable(a, b, status)) return 0;
+
+    int zSign = extractFloatx80Sign(a) ^ extractFloatx80Sign(b);
+    Bit32s zExp = extractFloatx80Exp(a) + extractFloatx80Exp(b) - 0x3FFE;
+    unsigned __int128 product =
+        (unsigned __int128) extractFloatx80Frac(a) * extractFloatx80Frac(b);
+    Bit64u zSig0 = (Bit64u) (product >> 64), zSig1 = (Bit64u) product;
+
+    if ((Bit64s) zSig0 >= 0) {
+        shortShift128Left(zSig0, zSig1, 1, &zSig0, &zSig1);
+        --zExp;
+    }
+    z = fastx80_round_pack(zSign, zExp, zSig0, zSig1, status);
+    return 1;
+}
+
+static int floatx80_div_fast(floatx80 a, floatx80 b, floatx80 &z, float_status_t &status)
+{
+    if (! fastx80_usable(a, b, status)) return 0;
+
+    int zSign = extractFloatx80Sign(a) ^ extractFloatx80Sign(b);
+    Bit32s zExp = extractFloatx80Exp(a) - extractFloatx80Exp(b) + 0x3FFE;
+    Bit64u aSig = extractFloatx80Frac(a), bSig = extractFloatx80Frac(b);
+    Bit64u rem0 = aSig, rem1 = 0, zSig0, rem;
+
+    // keep the quotient below 2^64
+    if (bSig <= aSig) {
+        shift128Right(aSig, 0, 1, &rem0, &rem1);
+        ++zExp;
+    }
+    __asm__ ("divq %4" : "=a" (zSig0), "=d" (rem) : "a" (rem1), "d" (rem0), "rm" (bSig));
+
+    // the extra bits only need to tell below, at or above half
+    Bit64u zSig1 = 0;
+    if (rem) {
+        if (rem < bSig - rem) zSig1 = 1;
+        else if (rem == bSig - rem) zSig1 = BX_CONST64(0x8000000000000000);
+        else zSig1 = BX_CONST64(0xC000000000000000);
+    }
+    z = fastx80_round_pack(zSign, zExp, zSig0, zSig1, status);
+    return 1;
+}
+
+#endif
+
 /*----------------------------------------------------------------------------
 | Returns the result of adding the absolute values of the extended double-
 | precision floating-point values `a' and `b'.  If `zSign' is 1, the sum is
@@ -3214,6 +3354,11 @@ static floatx80 subFloatx80Sigs(floatx80 a, floatx80 b, int zSign, float_status_
 
 floatx80 floatx80_add(floatx80 a, floatx80 b, float_status_t &status)
 {
+#if BX_SUPPORT_FASTX80
+    floatx80 z;
+    if (floatx80_add_fast(a, b, extractFloatx80Sign(b), z, status)) return z;
+#endif
+
     int aSign = extractFloatx80Sign(a);
     int bSign = extractFloatx80Sign(b);
 
@@ -3231,6 +3376,11 @@ floatx80 floatx80_add(floatx80 a, floatx80 b, float_status_t &status)
 
 floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status_t &status)
 {
+#if BX_SUPPORT_FASTX80
+    floatx80 z;
+    if (floatx80_add_fast(a, b, ! extractFloatx80Sign(b), z, status)) return z;
+#endif
+
     int aSign = extractFloatx80Sign(a);
     int bSign = extractFloatx80Sign(b);
 
@@ -3248,6 +3398,11 @@ floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status_t &status)
 
 floatx80 floatx80_mul(floatx80 a, floatx80 b, float_status_t &status)
 {
+#if BX_SUPPORT_FASTX80
+    floatx80 z;
+    if (floatx80_mul_fast(a, b, z, status)) return z;
+#endif
+
     int aSign, bSign, zSign;
     Bit32s aExp, bExp, zExp;
     Bit64u aSig, bSig, zSig0, zSig1;
@@ -3318,6 +3473,11 @@ floatx80 floatx80_mul(floatx80 a, floatx80 b, float_status_t &status)
 
 floatx80 floatx80_div(floatx80 a, floatx80 b, float_status_t &status)
 {
+#if BX_SUPPORT_FASTX80
+    floatx80 z;
+    if (floatx80_div_fast(a, b, z, status)) return z;
+#endif
+
     int aSign, bSign, zSign;
     Bit32s aExp, bExp, zExp;
     Bit64u aSig, bSig, zSig0, zSig1;
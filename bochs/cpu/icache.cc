@@ -76,6 +76,200 @@ void genDummyICacheEntry(bxInstruction_c *i)
 
 #endif
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+
+// Instruction fusion: a pair of adjacent instructions in a trace is
+// executed by a single handler installed into the first instruction of
+// the pair. The second instruction keeps its own handler, so it still
+// works as a branch target or when the pair is broken by an async event.
+
+enum {
+  BX_FUSE_ANY,         // second instruction must have the given handler
+  BX_FUSE_SAME_DST,    // .. and write the same destination register
+  BX_FUSE_CMP_JCC32,   // second instruction is Jcc_Jd
+  BX_FUSE_DEC_JCC32,   // .. Jcc_Jd not depending on CF
+#if BX_SUPPORT_X86_64
+  BX_FUSE_CMP_JCC64,   // second instruction is Jcc_Jq
+  BX_FUSE_DEC_JCC64    // .. Jcc_Jq not depending on CF
+#endif
+};
+
+struct bxFusionRule {
+  BxExecutePtr_tR first;
+  BxExecutePtr_tR second;
+  BxExecutePtr_tR fused;
+  unsigned kind;
+};
+
+static const bxFusionRule fusionRules[] = {
+  { &BX_CPU_C::CMP_GdEdR, NULL, &BX_CPU_C::CMP_GdEdR_Jd, BX_FUSE_CMP_JCC32 },
+  { &BX_CPU_C::CMP_EdIdR, NULL, &BX_CPU_C::CMP_EdIdR_Jd, BX_FUSE_CMP_JCC32 },
+  { &BX_CPU_C::CMP_GdEdM, NULL, &BX_CPU_C::CMP_GdEdM_Jd, BX_FUSE_CMP_JCC32 },
+  { &BX_CPU_C::CMP_EdGdM, NULL, &BX_CPU_C::CMP_EdGdM_Jd, BX_FUSE_CMP_JCC32 },
+  { &BX_CPU_C::CMP_EdIdM, NULL, &BX_CPU_C::CMP_EdIdM_Jd, BX_FUSE_CMP_JCC32 },
+  { &BX_CPU_C::TEST_EdGdR, NULL, &BX_CPU_C::TEST_EdGdR_Jd, BX_FUSE_CMP_JCC32 },
+  { &BX_CPU_C::TEST_EdIdR, NULL, &BX_CPU_C::TEST_EdIdR_Jd, BX_FUSE_CMP_JCC32 },
+  { &BX_CPU_C::DEC_EdR, NULL, &BX_CPU_C::DEC_EdR_Jd, BX_FUSE_DEC_JCC32 },
+
+  { &BX_CPU_C::PUSH_EdR, &BX_CPU_C::PUSH_EdR, &BX_CPU_C::PUSH2_EdR, BX_FUSE_ANY },
+  { &BX_CPU_C::POP_EdR, &BX_CPU_C::POP_EdR, &BX_CPU_C::POP2_EdR, BX_FUSE_ANY },
+
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::ADD_GdEdR, &BX_CPU_C::MOV_GdEdR_ADD_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::ADD_EdIdR, &BX_CPU_C::MOV_GdEdR_ADD_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::SUB_GdEdR, &BX_CPU_C::MOV_GdEdR_SUB_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::SUB_EdIdR, &BX_CPU_C::MOV_GdEdR_SUB_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::AND_GdEdR, &BX_CPU_C::MOV_GdEdR_AND_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::AND_EdIdR, &BX_CPU_C::MOV_GdEdR_AND_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::OR_GdEdR, &BX_CPU_C::MOV_GdEdR_OR_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::OR_EdIdR, &BX_CPU_C::MOV_GdEdR_OR_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::XOR_GdEdR, &BX_CPU_C::MOV_GdEdR_XOR_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GdEdR, &BX_CPU_C::XOR_EdIdR, &BX_CPU_C::MOV_GdEdR_XOR_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::ADD_GdEdR, &BX_CPU_C::MOV32_GdEdM_ADD_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::ADD_EdIdR, &BX_CPU_C::MOV32_GdEdM_ADD_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::SUB_GdEdR, &BX_CPU_C::MOV32_GdEdM_SUB_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::SUB_EdIdR, &BX_CPU_C::MOV32_GdEdM_SUB_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::AND_GdEdR, &BX_CPU_C::MOV32_GdEdM_AND_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::AND_EdIdR, &BX_CPU_C::MOV32_GdEdM_AND_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::OR_GdEdR, &BX_CPU_C::MOV32_GdEdM_OR_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::OR_EdIdR, &BX_CPU_C::MOV32_GdEdM_OR_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::XOR_GdEdR, &BX_CPU_C::MOV32_GdEdM_XOR_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV32_GdEdM, &BX_CPU_C::XOR_EdIdR, &BX_CPU_C::MOV32_GdEdM_XOR_EdIdR, BX_FUSE_SAME_DST },
+#if BX_SUPPORT_X86_64
+
+  { &BX_CPU_C::CMP_GdEdR, NULL, &BX_CPU_C::CMP_GdEdR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_EdIdR, NULL, &BX_CPU_C::CMP_EdIdR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_GdEdM, NULL, &BX_CPU_C::CMP_GdEdM_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_EdGdM, NULL, &BX_CPU_C::CMP_EdGdM_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_EdIdM, NULL, &BX_CPU_C::CMP_EdIdM_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::TEST_EdGdR, NULL, &BX_CPU_C::TEST_EdGdR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::TEST_EdIdR, NULL, &BX_CPU_C::TEST_EdIdR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_GqEqR, NULL, &BX_CPU_C::CMP_GqEqR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_EqIdR, NULL, &BX_CPU_C::CMP_EqIdR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_GqEqM, NULL, &BX_CPU_C::CMP_GqEqM_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_EqGqM, NULL, &BX_CPU_C::CMP_EqGqM_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::CMP_EqIdM, NULL, &BX_CPU_C::CMP_EqIdM_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::TEST_EqGqR, NULL, &BX_CPU_C::TEST_EqGqR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::TEST_EqIdR, NULL, &BX_CPU_C::TEST_EqIdR_Jq, BX_FUSE_CMP_JCC64 },
+  { &BX_CPU_C::DEC_EdR, NULL, &BX_CPU_C::DEC_EdR_Jq, BX_FUSE_DEC_JCC64 },
+  { &BX_CPU_C::DEC_EqR, NULL, &BX_CPU_C::DEC_EqR_Jq, BX_FUSE_DEC_JCC64 },
+
+  { &BX_CPU_C::PUSH_EqR, &BX_CPU_C::PUSH_EqR, &BX_CPU_C::PUSH2_EqR, BX_FUSE_ANY },
+  { &BX_CPU_C::POP_EqR, &BX_CPU_C::POP_EqR, &BX_CPU_C::POP2_EqR, BX_FUSE_ANY },
+
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::ADD_GdEdR, &BX_CPU_C::MOV64_GdEdM_ADD_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::ADD_EdIdR, &BX_CPU_C::MOV64_GdEdM_ADD_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::SUB_GdEdR, &BX_CPU_C::MOV64_GdEdM_SUB_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::SUB_EdIdR, &BX_CPU_C::MOV64_GdEdM_SUB_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::AND_GdEdR, &BX_CPU_C::MOV64_GdEdM_AND_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::AND_EdIdR, &BX_CPU_C::MOV64_GdEdM_AND_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::OR_GdEdR, &BX_CPU_C::MOV64_GdEdM_OR_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::OR_EdIdR, &BX_CPU_C::MOV64_GdEdM_OR_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::XOR_GdEdR, &BX_CPU_C::MOV64_GdEdM_XOR_GdEdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV64_GdEdM, &BX_CPU_C::XOR_EdIdR, &BX_CPU_C::MOV64_GdEdM_XOR_EdIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::ADD_GqEqR, &BX_CPU_C::MOV_GqEqR_ADD_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::ADD_EqIdR, &BX_CPU_C::MOV_GqEqR_ADD_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::SUB_GqEqR, &BX_CPU_C::MOV_GqEqR_SUB_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::SUB_EqIdR, &BX_CPU_C::MOV_GqEqR_SUB_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::AND_GqEqR, &BX_CPU_C::MOV_GqEqR_AND_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::AND_EqIdR, &BX_CPU_C::MOV_GqEqR_AND_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::OR_GqEqR, &BX_CPU_C::MOV_GqEqR_OR_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::OR_EqIdR, &BX_CPU_C::MOV_GqEqR_OR_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::XOR_GqEqR, &BX_CPU_C::MOV_GqEqR_XOR_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqR, &BX_CPU_C::XOR_EqIdR, &BX_CPU_C::MOV_GqEqR_XOR_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::ADD_GqEqR, &BX_CPU_C::MOV_GqEqM_ADD_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::ADD_EqIdR, &BX_CPU_C::MOV_GqEqM_ADD_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::SUB_GqEqR, &BX_CPU_C::MOV_GqEqM_SUB_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::SUB_EqIdR, &BX_CPU_C::MOV_GqEqM_SUB_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::AND_GqEqR, &BX_CPU_C::MOV_GqEqM_AND_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::AND_EqIdR, &BX_CPU_C::MOV_GqEqM_AND_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::OR_GqEqR, &BX_CPU_C::MOV_GqEqM_OR_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::OR_EqIdR, &BX_CPU_C::MOV_GqEqM_OR_EqIdR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::XOR_GqEqR, &BX_CPU_C::MOV_GqEqM_XOR_GqEqR, BX_FUSE_SAME_DST },
+  { &BX_CPU_C::MOV_GqEqM, &BX_CPU_C::XOR_EqIdR, &BX_CPU_C::MOV_GqEqM_XOR_EqIdR, BX_FUSE_SAME_DST },
+#endif
+};
+
+// Jcc handlers indexed by condition code
+static const BxExecutePtr_tR jccHandlers32[16] = {
+  &BX_CPU_C::JO_Jd, &BX_CPU_C::JNO_Jd, &BX_CPU_C::JB_Jd, &BX_CPU_C::JNB_Jd,
+  &BX_CPU_C::JZ_Jd, &BX_CPU_C::JNZ_Jd, &BX_CPU_C::JBE_Jd, &BX_CPU_C::JNBE_Jd,
+  &BX_CPU_C::JS_Jd, &BX_CPU_C::JNS_Jd, &BX_CPU_C::JP_Jd, &BX_CPU_C::JNP_Jd,
+  &BX_CPU_C::JL_Jd, &BX_CPU_C::JNL_Jd, &BX_CPU_C::JLE_Jd, &BX_CPU_C::JNLE_Jd
+};
+
+#if BX_SUPPORT_X86_64
+static const BxExecutePtr_tR jccHandlers64[16] = {
+  &BX_CPU_C::JO_Jq, &BX_CPU_C::JNO_Jq, &BX_CPU_C::JB_Jq, &BX_CPU_C::JNB_Jq,
+  &BX_CPU_C::JZ_Jq, &BX_CPU_C::JNZ_Jq, &BX_CPU_C::JBE_Jq, &BX_CPU_C::JNBE_Jq,
+  &BX_CPU_C::JS_Jq, &BX_CPU_C::JNS_Jq, &BX_CPU_C::JP_Jq, &BX_CPU_C::JNP_Jq,
+  &BX_CPU_C::JL_Jq, &BX_CPU_C::JNL_Jq, &BX_CPU_C::JLE_Jq, &BX_CPU_C::JNLE_Jq
+};
+#endif
+
+static int jccCondition(const bxInstruction_c *i, const BxExecutePtr_tR *handlers, bool preserves_cf)
+{
+  for (unsigned cond=0; cond<16; cond++) {
+    if (i->execute1 == handlers[cond]) {
+      // JP/JNP are rare after CMP/TEST and not worth computing parity
+      if (cond == 10 || cond == 11) return -1;
+      // B/NB/BE/NBE read CF which is not modified by DEC
+      if (preserves_cf && cond >= 2 && cond <= 7 && cond != 4 && cond != 5) return -1;
+      return cond;
+    }
+  }
+
+  return -1;
+}
+
+static bool fuseInstructions(bxInstruction_c *i, bxInstruction_c *next)
+{
+  for (unsigned n=0; n < sizeof(fusionRules)/sizeof(fusionRules[0]); n++) {
+    const bxFusionRule *rule = &fusionRules[n];
+    if (i->execute1 != rule->first) continue;
+
+    int cond = -1;
+    switch(rule->kind) {
+    case BX_FUSE_SAME_DST:
+      if (next->dst() != i->dst()) continue;
+      // fall through
+    case BX_FUSE_ANY:
+      if (next->execute1 != rule->second) continue;
+      break;
+    case BX_FUSE_CMP_JCC32:
+    case BX_FUSE_DEC_JCC32:
+      cond = jccCondition(next, jccHandlers32, rule->kind == BX_FUSE_DEC_JCC32);
+      if (cond < 0) continue;
+      break;
+#if BX_SUPPORT_X86_64
+    case BX_FUSE_CMP_JCC64:
+    case BX_FUSE_DEC_JCC64:
+      cond = jccCondition(next, jccHandlers64, rule->kind == BX_FUSE_DEC_JCC64);
+      if (cond < 0) continue;
+      break;
+#endif
+    }
+
+    if (cond >= 0) next->setFusedCond(cond);
+    i->execute1 = rule->fused;
+    return true;
+  }
+
+  return false;
+}
+
+// Only plain handlers are matched so instructions copied from already
+// fused traces by mergeTraces() are left alone.
+static void fuseTrace(bxInstruction_c *i, unsigned tlen)
+{
+  for (unsigned n=1; n < tlen; n++, i++) {
+    if (fuseInstructions(i, i+1)) {
+      n++; i++; // the second instruction is executed by the fused handler
+    }
+  }
+}
+
+#endif
+
 bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAddr)
 {
   bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.get_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
@@ -175,6 +369,9 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAdd
       if (mergeTraces(entry, i, pAddr)) {
           entry->traceMask |= traceMask;
           pageWriteStampTable.markICacheMask(pAddr, entry->traceMask);
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+          fuseTrace(entry->i, entry->tlen);
+#endif
           BX_CPU_THIS_PTR iCache.commit_trace(entry->tlen);
           return entry;
       }
@@ -192,6 +389,10 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAdd
   genDummyICacheEntry(i);
 #endif
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+  fuseTrace(entry->i, entry->tlen);
+#endif
+
   BX_CPU_THIS_PTR iCache.commit_trace(entry->tlen);
 
   return entry;
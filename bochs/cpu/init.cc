@@ -28,6 +28,7 @@
 #include "gui/siminterface.h"
 #include "param_names.h"
 #include "cpustats.h"
+#include "replay.h"
 
 #include <stdlib.h>
 
@@ -62,8 +63,6 @@ BX_CPU_C::BX_CPU_C(unsigned id): bx_cpuid(id)
 #endif
 
   stats = NULL;
-
-  srand(time(NULL)); // initialize random generator for RDRAND/RDSEED
 }
 
 #if BX_CPU_LEVEL >= 4
@@ -146,6 +145,10 @@ void BX_CPU_C::initialize(void)
 #endif
 
   init_statistics();
+
+  // initialize random generator for RDRAND/RDSEED, the seed is taken from
+  // the record/replay journal which is open by now (not yet in constructor)
+  srand((unsigned)bx_replay.host_value(BX_REPLAY_VAL_SEED, time(NULL)));
 }
 
 // statistics
@@ -184,6 +187,13 @@ void BX_CPU_C::init_statistics(void)
   new bx_shadow_num_c(cpu, "smc", &stats->smc);
 #endif
 
+#if InstrumentFusion
+  new bx_shadow_num_c(cpu, "fusedCmpJcc", &stats->fusedCmpJcc);
+  new bx_shadow_num_c(cpu, "fusedDecJcc", &stats->fusedDecJcc);
+  new bx_shadow_num_c(cpu, "fusedPushPop", &stats->fusedPushPop);
+  new bx_shadow_num_c(cpu, "fusedMovAlu", &stats->fusedMovAlu);
+#endif
+
 #endif
 }
 
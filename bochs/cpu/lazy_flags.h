@@ -400,4 +400,40 @@ BX_CPP_INLINE void bx_lazyflags_entry::assert_CF(void)
   set_flags_OxxxxC(temp_of, 1);
 }
 
+// Evaluate Jcc condition code 'cond' for the flags CMP op1,op2 would
+// produce, straight from the operands instead of the lazy flags state.
+// TEST is evaluated as CMP result,0 and DEC as CMP result+1,1 (the latter
+// only for conditions not looking at CF). Parity conditions (10/11) are
+// not supported.
+BX_CPP_INLINE bool bx_cmp_condition_32(unsigned cond, Bit32u op1_32, Bit32u op2_32)
+{
+  Bit32u diff_32 = op1_32 - op2_32;
+
+  unsigned of = ((op1_32 ^ op2_32) & (op1_32 ^ diff_32)) >> 31;
+  unsigned cf = (op1_32 < op2_32);
+  unsigned zf = (op1_32 == op2_32);
+  unsigned sf = diff_32 >> 31;
+  unsigned lt = sf ^ of;
+
+  // bit N holds condition 2*N, odd conditions are the negation of it
+  unsigned cc = of | (cf << 1) | (zf << 2) | ((cf | zf) << 3) | (sf << 4) | (lt << 6) | ((lt | zf) << 7);
+  return ((cc >> (cond >> 1)) ^ cond) & 1;
+}
+
+#if BX_SUPPORT_X86_64
+BX_CPP_INLINE bool bx_cmp_condition_64(unsigned cond, Bit64u op1_64, Bit64u op2_64)
+{
+  Bit64u diff_64 = op1_64 - op2_64;
+
+  unsigned of = (unsigned)(((op1_64 ^ op2_64) & (op1_64 ^ diff_64)) >> 63);
+  unsigned cf = (op1_64 < op2_64);
+  unsigned zf = (op1_64 == op2_64);
+  unsigned sf = (unsigned)(diff_64 >> 63);
+  unsigned lt = sf ^ of;
+
+  unsigned cc = of | (cf << 1) | (zf << 2) | ((cf | zf) << 3) | (sf << 4) | (lt << 6) | ((lt | zf) << 7);
+  return ((cc >> (cond >> 1)) ^ cond) & 1;
+}
+#endif
+
 #endif // BX_LAZY_FLAGS_DEF
@@ -24,10 +24,230 @@
 #ifndef BX_SIMD_PFP_FUNCTIONS_H
 #define BX_SIMD_PFP_FUNCTIONS_H
 
+#if BX_SUPPORT_HOST_SSE_PFP
+
+#include <emmintrin.h>
+
+// Packed add/sub/mul/div/sqrt are first tried on the host SSE unit.
+//
+// Loading the guest MXCSR on the host and reading back its flags costs
+// more than the softfloat loop, so the host MXCSR is left alone and the
+// fast path is taken only when the guest rounds to nearest like the host
+// does. The exception flags are derived instead:
+//  - NaN, infinity and denormal operands and results are left to
+//    softfloat, which covers #I, #D, #Z and #O. So are results that may
+//    be tiny (zero after rounding, denormal or smallest normal), which
+//    covers #U, DAZ and FTZ.
+//  - #P is found by checking the result exactly with error-free
+//    transformations in double precision.
+// Then the host result is bit-exact with softfloat.
+
+enum {
+  BX_HOST_SSE_ADD,
+  BX_HOST_SSE_SUB,
+  BX_HOST_SSE_MUL,
+  BX_HOST_SSE_DIV,
+  BX_HOST_SSE_SQRT
+};
+
+// keep the compiler from contracting the exactness checks into FMA
+#define BX_HOST_SSE_BARRIER(v) __asm__ __volatile__("" : "+x" (v))
+
+BX_CPP_INLINE bool host_sse_usable(const float_status_t &status)
+{
+  // the host MXCSR must be in its reset state, sticky flags aside
+  return get_float_rounding_mode(status) == float_round_nearest_even &&
+        (_mm_getcsr() & ~float_all_exceptions_mask) == 0x1f80;
+}
+
+// Error of a + b, exact in round to nearest (Knuth's TwoSum)
+BX_CPP_INLINE __m128d host_sse_sum_err(__m128d a, __m128d b, __m128d s)
+{
+  __m128d bb = _mm_sub_pd(s, a);
+  return _mm_add_pd(_mm_sub_pd(a, _mm_sub_pd(s, bb)), _mm_sub_pd(b, bb));
+}
+
+// Error of a * b, exact in round to nearest unless it underflows
+// (Dekker's TwoProduct)
+BX_CPP_INLINE __m128d host_sse_mul_err(__m128d a, __m128d b, __m128d p)
+{
+  const __m128d split = _mm_set1_pd(134217729.0); // 2^27 + 1
+
+  __m128d ca = _mm_mul_pd(a, split), cb = _mm_mul_pd(b, split);
+  BX_HOST_SSE_BARRIER(ca);
+  BX_HOST_SSE_BARRIER(cb);
+  __m128d ah = _mm_sub_pd(ca, _mm_sub_pd(ca, a)), al = _mm_sub_pd(a, ah);
+  __m128d bh = _mm_sub_pd(cb, _mm_sub_pd(cb, b)), bl = _mm_sub_pd(b, bh);
+  __m128d hh = _mm_mul_pd(ah, bh), hl = _mm_mul_pd(ah, bl);
+  __m128d lh = _mm_mul_pd(al, bh), ll = _mm_mul_pd(al, bl);
+  BX_HOST_SSE_BARRIER(hh);
+  BX_HOST_SSE_BARRIER(hl);
+  BX_HOST_SSE_BARRIER(lh);
+  BX_HOST_SSE_BARRIER(ll);
+  return _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_sub_pd(hh, p), hl), lh), ll);
+}
+
+// Returns mask of float32 lanes holding NaN, infinity or denormal
+BX_CPP_INLINE __m128i host_sse_special_ps(__m128 v)
+{
+  __m128i m = _mm_and_si128(_mm_castps_si128(v), _mm_set1_epi32(0x7fffffff));
+  __m128i e = _mm_srli_epi32(m, 23), zero = _mm_setzero_si128();
+  return _mm_or_si128(_mm_cmpeq_epi32(e, _mm_set1_epi32(0xff)),
+       _mm_andnot_si128(_mm_cmpeq_epi32(m, zero), _mm_cmpeq_epi32(e, zero)));
+}
+
+// Returns nonzero if the float32 result r of a op b is not exact,
+// a and r are converted to double two lanes at a time
+BX_CPP_INLINE int host_sse_inexact_ps(unsigned op, __m128d a, __m128d b, __m128d r)
+{
+  __m128d t;
+
+  switch(op) {
+    case BX_HOST_SSE_ADD:
+    case BX_HOST_SSE_SUB:
+      if (op == BX_HOST_SSE_SUB) b = _mm_xor_pd(b, _mm_set1_pd(-0.0));
+      t = _mm_add_pd(a, b);
+      return _mm_movemask_pd(_mm_or_pd(_mm_cmpneq_pd(r, t),
+               _mm_cmpneq_pd(host_sse_sum_err(a, b, t), _mm_setzero_pd())));
+    case BX_HOST_SSE_MUL:
+      // 24 x 24 bit product is exact in double
+      t = _mm_mul_pd(a, b);
+      return _mm_movemask_pd(_mm_cmpneq_pd(r, t));
+    case BX_HOST_SSE_DIV:
+      t = _mm_mul_pd(r, b);
+      return _mm_movemask_pd(_mm_cmpneq_pd(t, a));
+    default:
+      t = _mm_mul_pd(r, r);
+      return _mm_movemask_pd(_mm_cmpneq_pd(t, b));
+  }
+}
+
+BX_CPP_INLINE bool host_sse_ps(unsigned op, BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
+{
+  if (! host_sse_usable(status))
+    return false;
+
+  __m128 a = _mm_loadu_ps((const float *) op1->xmm_u32);
+  __m128 b = _mm_loadu_ps((const float *) op2->xmm_u32);
+  __m128 r;
+
+  switch(op) {
+    case BX_HOST_SSE_ADD: r = _mm_add_ps(a, b); break;
+    case BX_HOST_SSE_SUB: r = _mm_sub_ps(a, b); break;
+    case BX_HOST_SSE_MUL: r = _mm_mul_ps(a, b); break;
+    case BX_HOST_SSE_DIV: r = _mm_div_ps(a, b); break;
+    default:
+      r = _mm_sqrt_ps(b); break;
+  }
+
+  __m128i m = _mm_and_si128(_mm_castps_si128(r), _mm_set1_epi32(0x7fffffff));
+  __m128i special = _mm_or_si128(host_sse_special_ps(r),
+       _mm_or_si128(host_sse_special_ps(a), host_sse_special_ps(b)));
+  special = _mm_or_si128(special, _mm_cmpeq_epi32(m, _mm_set1_epi32(0x00800000)));
+  // product or quotient of nonzero numbers rounded to zero
+  if (op == BX_HOST_SSE_MUL || op == BX_HOST_SSE_DIV) {
+    __m128 nz = _mm_cmpneq_ps(a, _mm_setzero_ps());
+    if (op == BX_HOST_SSE_MUL) nz = _mm_and_ps(nz, _mm_cmpneq_ps(b, _mm_setzero_ps()));
+    special = _mm_or_si128(special,
+       _mm_and_si128(_mm_castps_si128(nz), _mm_cmpeq_epi32(m, _mm_setzero_si128())));
+  }
+  if (_mm_movemask_epi8(special))
+    return false;
+
+  int inexact = host_sse_inexact_ps(op, _mm_cvtps_pd(a), _mm_cvtps_pd(b), _mm_cvtps_pd(r)) |
+                host_sse_inexact_ps(op, _mm_cvtps_pd(_mm_movehl_ps(a, a)),
+                  _mm_cvtps_pd(_mm_movehl_ps(b, b)), _mm_cvtps_pd(_mm_movehl_ps(r, r)));
+
+  _mm_storeu_ps((float *) op1->xmm_u32, r);
+  if (inexact)
+    float_raise(status, float_flag_inexact);
+  return true;
+}
+
+// Returns nonzero if the float64 is a NaN, infinity or denormal, or if
+// its magnitude is out of [2^-511, 2^511] so that the error terms of the
+// exactness checks might overflow or underflow
+BX_CPP_INLINE int host_sse_special_pd(Bit64u v)
+{
+  unsigned e = (unsigned)(v >> 52) & 0x7ff;
+  return (v << 1) != 0 && (e < 0x3ff - 511 || e > 0x3ff + 511);
+}
+
+BX_CPP_INLINE bool host_sse_pd(unsigned op, BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
+{
+  if (! host_sse_usable(status))
+    return false;
+
+  __m128d a = _mm_loadu_pd((const double *) op1->xmm_u64);
+  __m128d b = _mm_loadu_pd((const double *) op2->xmm_u64);
+  __m128d r, t;
+  Bit64u v[2];
+
+  switch(op) {
+    case BX_HOST_SSE_ADD: r = _mm_add_pd(a, b); break;
+    case BX_HOST_SSE_SUB: r = _mm_sub_pd(a, b); break;
+    case BX_HOST_SSE_MUL: r = _mm_mul_pd(a, b); break;
+    case BX_HOST_SSE_DIV: r = _mm_div_pd(a, b); break;
+    default:
+      r = _mm_sqrt_pd(b); break;
+  }
+
+  _mm_storeu_pd((double *) v, r);
+  for (unsigned n=0; n < 2; n++) {
+    if (host_sse_special_pd(op1->xmm64u(n)) || host_sse_special_pd(op2->xmm64u(n)) ||
+        host_sse_special_pd(v[n]))
+      return false;
+    // product or quotient of nonzero numbers rounded to zero
+    if ((v[n] << 1) == 0 && (op == BX_HOST_SSE_MUL || op == BX_HOST_SSE_DIV) &&
+        (op1->xmm64u(n) << 1) != 0 && (op == BX_HOST_SSE_DIV || (op2->xmm64u(n) << 1) != 0))
+      return false;
+  }
+
+  switch(op) {
+    case BX_HOST_SSE_ADD:
+    case BX_HOST_SSE_SUB:
+      if (op == BX_HOST_SSE_SUB) b = _mm_xor_pd(b, _mm_set1_pd(-0.0));
+      t = host_sse_sum_err(a, b, r);
+      break;
+    case BX_HOST_SSE_MUL:
+      t = host_sse_mul_err(a, b, r);
+      break;
+    case BX_HOST_SSE_DIV:
+      // r is exact if r * b == a with no error
+      t = _mm_mul_pd(r, b);
+      t = _mm_or_pd(_mm_cmpneq_pd(t, a), host_sse_mul_err(r, b, t));
+      break;
+    default:
+      t = _mm_mul_pd(r, r);
+      t = _mm_or_pd(_mm_cmpneq_pd(t, b), host_sse_mul_err(r, r, t));
+      break;
+  }
+
+  op1->xmm_u64[0] = v[0];
+  op1->xmm_u64[1] = v[1];
+  if (_mm_movemask_pd(_mm_cmpneq_pd(t, _mm_setzero_pd())))
+    float_raise(status, float_flag_inexact);
+  return true;
+}
+
+#define BX_HOST_SSE_PS(op, op1, op2, status) \
+  if (host_sse_ps((op), (op1), (op2), (status))) return;
+#define BX_HOST_SSE_PD(op, op1, op2, status) \
+  if (host_sse_pd((op), (op1), (op2), (status))) return;
+
+#else
+
+#define BX_HOST_SSE_PS(op, op1, op2, status)
+#define BX_HOST_SSE_PD(op, op1, op2, status)
+
+#endif
+
 // arithmetic add/sub/mul/div
 
 BX_CPP_INLINE void xmm_addps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PS(BX_HOST_SSE_ADD, op1, op2, status)
+
   for (unsigned n=0;n<4;n++) {
     op1->xmm32u(n) = float32_add(op1->xmm32u(n), op2->xmm32u(n), status);
   }
@@ -45,6 +265,8 @@ BX_CPP_INLINE void xmm_addps_mask(BxPackedXmmRegister *op1, const BxPackedXmmReg
 
 BX_CPP_INLINE void xmm_addpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PD(BX_HOST_SSE_ADD, op1, op2, status)
+
   for (unsigned n=0;n<2;n++) {
     op1->xmm64u(n) = float64_add(op1->xmm64u(n), op2->xmm64u(n), status);
   }
@@ -62,6 +284,8 @@ BX_CPP_INLINE void xmm_addpd_mask(BxPackedXmmRegister *op1, const BxPackedXmmReg
 
 BX_CPP_INLINE void xmm_subps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PS(BX_HOST_SSE_SUB, op1, op2, status)
+
   for (unsigned n=0;n<4;n++) {
     op1->xmm32u(n) = float32_sub(op1->xmm32u(n), op2->xmm32u(n), status);
   }
@@ -79,6 +303,8 @@ BX_CPP_INLINE void xmm_subps_mask(BxPackedXmmRegister *op1, const BxPackedXmmReg
 
 BX_CPP_INLINE void xmm_subpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PD(BX_HOST_SSE_SUB, op1, op2, status)
+
   for (unsigned n=0;n<2;n++) {
     op1->xmm64u(n) = float64_sub(op1->xmm64u(n), op2->xmm64u(n), status);
   }
@@ -96,6 +322,8 @@ BX_CPP_INLINE void xmm_subpd_mask(BxPackedXmmRegister *op1, const BxPackedXmmReg
 
 BX_CPP_INLINE void xmm_mulps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PS(BX_HOST_SSE_MUL, op1, op2, status)
+
   for (unsigned n=0;n<4;n++) {
     op1->xmm32u(n) = float32_mul(op1->xmm32u(n), op2->xmm32u(n), status);
   }
@@ -113,6 +341,8 @@ BX_CPP_INLINE void xmm_mulps_mask(BxPackedXmmRegister *op1, const BxPackedXmmReg
 
 BX_CPP_INLINE void xmm_mulpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PD(BX_HOST_SSE_MUL, op1, op2, status)
+
   for (unsigned n=0;n<2;n++) {
     op1->xmm64u(n) = float64_mul(op1->xmm64u(n), op2->xmm64u(n), status);
   }
@@ -130,6 +360,8 @@ BX_CPP_INLINE void xmm_mulpd_mask(BxPackedXmmRegister *op1, const BxPackedXmmReg
 
 BX_CPP_INLINE void xmm_divps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PS(BX_HOST_SSE_DIV, op1, op2, status)
+
   for (unsigned n=0;n<4;n++) {
     op1->xmm32u(n) = float32_div(op1->xmm32u(n), op2->xmm32u(n), status);
   }
@@ -147,6 +379,8 @@ BX_CPP_INLINE void xmm_divps_mask(BxPackedXmmRegister *op1, const BxPackedXmmReg
 
 BX_CPP_INLINE void xmm_divpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
 {
+  BX_HOST_SSE_PD(BX_HOST_SSE_DIV, op1, op2, status)
+
   for (unsigned n=0;n<2;n++) {
     op1->xmm64u(n) = float64_div(op1->xmm64u(n), op2->xmm64u(n), status);
   }
@@ -626,6 +860,8 @@ BX_CPP_INLINE void xmm_fnmsubpd_mask(BxPackedXmmRegister *op1, const BxPackedXmm
 
 BX_CPP_INLINE void xmm_sqrtps(BxPackedXmmRegister *op, float_status_t &status)
 {
+  BX_HOST_SSE_PS(BX_HOST_SSE_SQRT, op, op, status)
+
   for (unsigned n=0; n < 4; n++) {
     op->xmm32u(n) = float32_sqrt(op->xmm32u(n), status);
   }
@@ -643,6 +879,8 @@ BX_CPP_INLINE void xmm_sqrtps_mask(BxPackedXmmRegister *op, float_status_t &stat
 
 BX_CPP_INLINE void xmm_sqrtpd(BxPackedXmmRegister *op, float_status_t &status)
 {
+  BX_HOST_SSE_PD(BX_HOST_SSE_SQRT, op, op, status)
+
   for (unsigned n=0; n < 2; n++) {
     op->xmm64u(n) = float64_sqrt(op->xmm64u(n), status);
   }
@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "cpustats.h"
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::POP_EdR(bxInstruction_c *i)
 {
   BX_WRITE_32BIT_REGZ(i->dst(), pop_32());
@@ -56,6 +58,36 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::PUSH_EdR(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+
+// two register PUSHes or POPs in a row (see fuseTrace in icache.cc)
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::PUSH2_EdR(bxInstruction_c *i)
+{
+  push_32(BX_READ_32BIT_REG(i->dst()));
+
+  BX_NEXT_FUSED_INSTR(i);
+
+  push_32(BX_READ_32BIT_REG(i->dst()));
+
+  INC_FUSION_STAT(fusedPushPop);
+  BX_NEXT_INSTR(i);
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::POP2_EdR(bxInstruction_c *i)
+{
+  BX_WRITE_32BIT_REGZ(i->dst(), pop_32());
+
+  BX_NEXT_FUSED_INSTR(i);
+
+  BX_WRITE_32BIT_REGZ(i->dst(), pop_32());
+
+  INC_FUSION_STAT(fusedPushPop);
+  BX_NEXT_INSTR(i);
+}
+
+#endif
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::PUSH_EdM(bxInstruction_c *i)
 {
   Bit32u eaddr = (Bit32u) BX_CPU_RESOLVE_ADDR_32(i);
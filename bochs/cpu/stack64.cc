@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "cpustats.h"
+
 #if BX_SUPPORT_X86_64
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::POP_EqM(bxInstruction_c *i)
@@ -58,6 +60,36 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::POP_EqR(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_INSTRUCTION_FUSION
+
+// two register PUSHes or POPs in a row (see fuseTrace in icache.cc)
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::PUSH2_EqR(bxInstruction_c *i)
+{
+  push_64(BX_READ_64BIT_REG(i->dst()));
+
+  BX_NEXT_FUSED_INSTR(i);
+
+  push_64(BX_READ_64BIT_REG(i->dst()));
+
+  INC_FUSION_STAT(fusedPushPop);
+  BX_NEXT_INSTR(i);
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::POP2_EqR(bxInstruction_c *i)
+{
+  BX_WRITE_64BIT_REG(i->dst(), pop_64());
+
+  BX_NEXT_FUSED_INSTR(i);
+
+  BX_WRITE_64BIT_REG(i->dst(), pop_64());
+
+  INC_FUSION_STAT(fusedPushPop);
+  BX_NEXT_INSTR(i);
+}
+
+#endif
+
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::PUSH64_Sw(bxInstruction_c *i)
 {
   push_64(BX_CPU_THIS_PTR sregs[i->src()].selector.value);
@@ -247,6 +247,12 @@ static Bit32u registers[NUMREGS];
 static Bit64u breakpoints[MAX_BREAKPOINTS] = {0,};
 static unsigned nr_breakpoints = 0;
 
+// one bit per page offset of a set breakpoint, checked before the
+// breakpoint list is searched
+#define BREAKPOINT_HASH_SIZE (4096)
+#define BREAKPOINT_HASH(addr) ((unsigned)(addr) & (BREAKPOINT_HASH_SIZE-1))
+static Bit32u breakpoint_hash[BREAKPOINT_HASH_SIZE/32];
+
 static int stub_trace_flag = 0;
 static int instr_count = 0;
 static int saved_eip = 0;
@@ -302,13 +308,16 @@ int bx_gdbstub_check(unsigned int eip)
     }
   }
 
-  for (i = 0; i < nr_breakpoints; i++)
+  if (breakpoint_hash[BREAKPOINT_HASH(eip) >> 5] & (1 << (BREAKPOINT_HASH(eip) & 31)))
   {
-    if (eip == breakpoints[i])
+    for (i = 0; i < nr_breakpoints; i++)
     {
-      BX_INFO(("found breakpoint at %x", eip));
-      last_stop_reason = GDBSTUB_EXECUTION_BREAKPOINT;
-      return GDBSTUB_EXECUTION_BREAKPOINT;
+      if (eip == breakpoints[i])
+      {
+        BX_INFO(("found breakpoint at %x", eip));
+        last_stop_reason = GDBSTUB_EXECUTION_BREAKPOINT;
+        return GDBSTUB_EXECUTION_BREAKPOINT;
+      }
     }
   }
 
@@ -321,6 +330,25 @@ int bx_gdbstub_check(unsigned int eip)
   return GDBSTUB_STOP_NO_REASON;
 }
 
+// Returns non-zero if bx_gdbstub_check() has to see every instruction
+int bx_gdbstub_single_step(void)
+{
+  return (nr_breakpoints > 0) || stub_trace_flag || bx_enter_gdbstub;
+}
+
+static void update_breakpoint_hash(void)
+{
+  memset(breakpoint_hash, 0, sizeof(breakpoint_hash));
+  for (unsigned i = 0; i < nr_breakpoints; i++)
+  {
+    if (breakpoints[i] != 0)
+    {
+      unsigned h = BREAKPOINT_HASH(breakpoints[i]);
+      breakpoint_hash[h >> 5] |= (1 << (h & 31));
+    }
+  }
+}
+
 static int remove_breakpoint(Bit64u addr, int len)
 {
   if (len != 1)
@@ -334,6 +362,7 @@ static int remove_breakpoint(Bit64u addr, int len)
     {
       BX_INFO(("Removing breakpoint at " FMT_ADDRX64, addr));
       breakpoints[i] = 0;
+      update_breakpoint_hash();
       return(1);
     }
   }
@@ -355,6 +384,7 @@ static void insert_breakpoint(Bit64u addr)
       {
         nr_breakpoints = i + 1;
       }
+      update_breakpoint_hash();
       return;
     }
   }
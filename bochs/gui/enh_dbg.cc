@@ -2664,6 +2664,7 @@ void DelWatchpoint(bx_watchpoint *wp_array, unsigned *TotEntries, int i)
     while (++i < (int) *TotEntries)
         wp_array[i-1] = wp_array[i];
     -- *TotEntries;
+    bx_dbg_watchpoints_changed();
 }
 
 void SetWatchpoint(unsigned *num_watchpoints, bx_watchpoint *watchpoint)
@@ -2690,12 +2691,13 @@ void SetWatchpoint(unsigned *num_watchpoints, bx_watchpoint *watchpoint)
     {
         // Set a watchpoint to last clicked address -- the list is not sorted
         if (*num_watchpoints >= BX_DBG_MAX_WATCHPONTS) {
-            DispMessage("Too many of that type of watchpoint. Max: 16", "Table Overflow");
+            DispMessage("Too many of that type of watchpoint.", "Table Overflow");
         }
         else {
             watchpoint[*num_watchpoints].len  = 1;
             watchpoint[*num_watchpoints].addr = (bx_phy_address) SelectedDataAddress;
             ++(*num_watchpoints);
+            bx_dbg_watchpoints_changed();
         }
     }
     Invalidate(DUMP_WND);   // redraw the MemDump window -- colors may have changed
@@ -34,6 +34,7 @@ extern bx_list_c *root_param;
 #define LOG_THIS siminterface_log->
 
 const char* bx_param_c::default_text_format = NULL;
+Bit32u bx_param_c::tree_changes = 0;
 
 bx_param_c::bx_param_c(Bit32u id, const char *param_name, const char *param_desc)
   : bx_object_c(id),
@@ -82,6 +83,7 @@ bx_param_c::bx_param_c(Bit32u id, const char *param_name, const char *param_labe
 
 bx_param_c::~bx_param_c()
 {
+  tree_changes++;
   delete [] name;
   delete [] label;
   delete [] description;
@@ -1302,6 +1304,7 @@ void bx_list_c::clear()
   }
   list = NULL;
   size = 0;
+  tree_changes++;
 }
 
 void bx_list_c::remove(const char *name)
@@ -1321,6 +1324,7 @@ void bx_list_c::remove(const char *name)
       }
       delete item;
       size--;
+      tree_changes++;
       break;
     } else {
       prev = item;
@@ -96,6 +96,9 @@ public:
 class BOCHSAPI bx_param_c : public bx_object_c {
   BOCHSAPI_CYGONLY static const char *default_text_format;
 protected:
+  // incremented whenever a parameter is deleted or unlinked from a list,
+  // so that cached path lookups can tell when they went stale
+  BOCHSAPI_CYGONLY static Bit32u tree_changes;
   bx_list_c *parent;
   char *name;
   char *description;
@@ -157,6 +160,7 @@ public:
 
   static const char* set_default_format(const char *f);
   static const char *get_default_format() { return default_text_format; }
+  static Bit32u get_tree_changes() { return tree_changes; }
 
   bx_list_c *get_dependent_list() { return dependent_list; }
 
@@ -0,0 +1,491 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+
+// Headless display library that exports the guest screen in a POSIX shared
+// memory object. The VGA code renders directly into the shared framebuffer
+// (new graphics API), so neither copying nor encoding is done here. Only a
+// small frame record with the dirty rectangles is published on each flush.
+// See shmfb.h for the layout of the shared memory object.
+
+// Define BX_PLUGGABLE in files that can be compiled into plugins.  For
+// platforms that require a special tag on exported symbols, BX_PLUGGABLE
+// is used to know when we are exporting symbols and when we are importing.
+#define BX_PLUGGABLE
+
+#include "bochs.h"
+#include "param_names.h"
+#include "iodev.h"
+#if BX_WITH_SHMFB
+
+#include "icon_bochs.h"
+#include "font/vga.bitmap.h"
+#include "shmfb.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class bx_shmfb_gui_c : public bx_gui_c {
+public:
+  bx_shmfb_gui_c (void) {}
+  DECLARE_GUI_VIRTUAL_METHODS()
+  DECLARE_GUI_NEW_VIRTUAL_METHODS()
+  virtual void draw_char(Bit8u ch, Bit8u fc, Bit8u bc, Bit16u xc, Bit16u yc,
+                         Bit8u fw, Bit8u fh, Bit8u fx, Bit8u fy,
+                         bool gfxcharw9, Bit8u cs, Bit8u ce, bool curs);
+  void get_capabilities(Bit16u *xres, Bit16u *yres, Bit16u *bpp);
+private:
+  void begin_update(void);
+  void add_dirty_rect(unsigned x0, unsigned y0, unsigned w, unsigned h);
+  void publish_frame(void);
+};
+
+// declare one instance of the gui object and call macro to insert the
+// plugin code
+static bx_shmfb_gui_c *theGui = NULL;
+IMPLEMENT_GUI_PLUGIN_CODE(shmfb)
+
+#define LOG_THIS theGui->
+
+static char shmfbName[BX_PATHNAME_LEN];
+static bool shmfbKeep = 0;
+static int shmfbFd = -1;
+static size_t shmfbSize = 0;
+static bx_shmfb_header_t *shmfbHeader = NULL;
+static Bit8u *shmfbScreen = NULL;
+static unsigned shmfbPitch = 0;
+static Bit32u shmfbPalette[256];
+
+// changes collected since the last published frame
+static bx_shmfb_frame_t shmfbPending;
+static bool shmfbWriting = 0;
+
+// SHMFB implementation of the bx_gui_c methods (see nogui.cc for details)
+
+void bx_shmfb_gui_c::specific_init(int argc, char **argv, unsigned headerbar_y)
+{
+  int i;
+
+  put("SHMFB");
+  UNUSED(headerbar_y);
+  UNUSED(bochs_icon_bits);
+
+  for (i = 0; i < 256; i++) {
+    for (int j = 0; j < 16; j++) {
+      vga_charmap[i * 32 + j] = reverse_bitorder(bx_vgafont[i].data[j]);
+    }
+  }
+
+  strcpy(shmfbName, BX_SHMFB_DEF_NAME);
+  // parse shmfb specific options
+  if (argc > 1) {
+    for (i = 1; i < argc; i++) {
+      if (!strncmp(argv[i], "name=", 5)) {
+        if ((argv[i][5] != '/') || (strlen(&argv[i][5]) >= BX_PATHNAME_LEN)) {
+          BX_PANIC(("invalid shared memory name '%s'", &argv[i][5]));
+        } else {
+          strcpy(shmfbName, &argv[i][5]);
+        }
+      } else if (!strcmp(argv[i], "keep")) {
+        shmfbKeep = 1;
+      } else {
+        BX_PANIC(("Unknown shmfb option '%s'", argv[i]));
+      }
+    }
+  }
+
+  if (SIM->get_param_bool(BXPN_PRIVATE_COLORMAP)->get()) {
+    BX_INFO(("private_colormap option ignored."));
+  }
+
+  shmfbPitch = max_xres * 4;
+  shmfbSize = sizeof(bx_shmfb_header_t) + shmfbPitch * max_yres;
+  shmfbFd = shm_open(shmfbName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (shmfbFd < 0) {
+    BX_PANIC(("cannot create shared memory object '%s'", shmfbName));
+    return;
+  }
+  if (ftruncate(shmfbFd, shmfbSize) < 0) {
+    BX_PANIC(("cannot resize shared memory object '%s'", shmfbName));
+    return;
+  }
+  shmfbHeader = (bx_shmfb_header_t*)mmap(NULL, shmfbSize, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED, shmfbFd, 0);
+  if (shmfbHeader == (bx_shmfb_header_t*)MAP_FAILED) {
+    shmfbHeader = NULL;
+    BX_PANIC(("cannot map shared memory object '%s'", shmfbName));
+    return;
+  }
+  memset(shmfbHeader, 0, shmfbSize);
+  shmfbHeader->version = BX_SHMFB_VERSION;
+  shmfbHeader->fb_offset = sizeof(bx_shmfb_header_t);
+  shmfbHeader->fb_pitch = shmfbPitch;
+  shmfbHeader->max_xres = max_xres;
+  shmfbHeader->max_yres = max_yres;
+  shmfbHeader->bpp = 32;
+  shmfbHeader->ring_size = BX_SHMFB_RING_SIZE;
+  shmfbHeader->pid = (Bit32u)getpid();
+  shmfbScreen = (Bit8u*)shmfbHeader + shmfbHeader->fb_offset;
+  // the magic value marks the header as valid for readers
+  __sync_synchronize();
+  shmfbHeader->magic = BX_SHMFB_MAGIC;
+  BX_INFO(("exporting %ux%u framebuffer in shared memory object '%s'",
+           max_xres, max_yres, shmfbName));
+
+  memset(&shmfbPending, 0, sizeof(shmfbPending));
+  memset(shmfbPalette, 0, sizeof(shmfbPalette));
+  shmfbWriting = 0;
+
+  new_gfx_api = 1;
+  new_text_api = 1;
+}
+
+void bx_shmfb_gui_c::begin_update(void)
+{
+  if (!shmfbWriting) {
+    shmfbHeader->fb_gen++;
+    __sync_synchronize();
+    shmfbWriting = 1;
+  }
+}
+
+void bx_shmfb_gui_c::add_dirty_rect(unsigned x0, unsigned y0, unsigned w, unsigned h)
+{
+  bx_shmfb_rect_t *last;
+
+  if ((x0 >= guest_xres) || (y0 >= guest_yres)) return;
+  if ((x0 + w) > guest_xres) w = guest_xres - x0;
+  if ((y0 + h) > guest_yres) h = guest_yres - y0;
+  if (shmfbPending.flags & BX_SHMFB_FULL_UPDATE) return;
+
+  // tiles arrive in row-major order: try to extend the previous rectangle
+  if (shmfbPending.n_rects > 0) {
+    last = &shmfbPending.rect[shmfbPending.n_rects - 1];
+    if ((last->y == y0) && (last->h == h) && ((unsigned)(last->x + last->w) == x0)) {
+      last->w += w;
+      // a completed row may continue the rectangle above it
+      if (shmfbPending.n_rects > 1) {
+        bx_shmfb_rect_t *prev = last - 1;
+        if ((prev->x == last->x) && (prev->w == last->w) &&
+            ((prev->y + prev->h) == last->y)) {
+          prev->h += last->h;
+          shmfbPending.n_rects--;
+        }
+      }
+      return;
+    }
+    if ((last->x == x0) && (last->w == w) && ((unsigned)(last->y + last->h) == y0)) {
+      last->h += h;
+      return;
+    }
+  }
+  if (shmfbPending.n_rects < BX_SHMFB_MAX_RECTS) {
+    last = &shmfbPending.rect[shmfbPending.n_rects++];
+    last->x = x0;
+    last->y = y0;
+    last->w = w;
+    last->h = h;
+  } else {
+    shmfbPending.flags |= BX_SHMFB_FULL_UPDATE;
+    shmfbPending.n_rects = 0;
+  }
+}
+
+void bx_shmfb_gui_c::publish_frame(void)
+{
+  Bit64u seq;
+
+  if (shmfbHeader == NULL) return;
+  if ((shmfbPending.n_rects == 0) && (shmfbPending.flags == 0)) {
+    // framebuffer access without visible change
+    if (shmfbWriting) {
+      __sync_synchronize();
+      shmfbHeader->fb_gen++;
+      shmfbWriting = 0;
+    }
+    return;
+  }
+  seq = shmfbHeader->seq;
+  shmfbPending.seq = seq + 1;
+  shmfbPending.timestamp = bx_pc_system.time_usec();
+  shmfbPending.width = guest_xres;
+  shmfbPending.height = guest_yres;
+  if (guest_textmode) {
+    shmfbPending.flags |= BX_SHMFB_TEXT_MODE;
+  }
+  memcpy(&shmfbHeader->ring[seq % BX_SHMFB_RING_SIZE], &shmfbPending,
+         sizeof(bx_shmfb_frame_t));
+  __sync_synchronize();
+  if (shmfbWriting) {
+    shmfbHeader->fb_gen++;
+    shmfbWriting = 0;
+  }
+  shmfbHeader->seq = seq + 1;
+  __sync_synchronize();
+  shmfbPending.flags = 0;
+  shmfbPending.n_rects = 0;
+}
+
+void bx_shmfb_gui_c::handle_events(void)
+{
+}
+
+void bx_shmfb_gui_c::flush(void)
+{
+  publish_frame();
+}
+
+void bx_shmfb_gui_c::clear_screen(void)
+{
+  Bit8u *ptr = shmfbScreen;
+
+  if (ptr == NULL) return;
+  begin_update();
+  for (unsigned y = 0; y < guest_yres; y++) {
+    memset(ptr, 0, guest_xres * 4);
+    ptr += shmfbPitch;
+  }
+  shmfbPending.flags |= BX_SHMFB_FULL_UPDATE;
+  shmfbPending.n_rects = 0;
+}
+
+void bx_shmfb_gui_c::draw_char(Bit8u ch, Bit8u fc, Bit8u bc, Bit16u xc, Bit16u yc,
+                               Bit8u fw, Bit8u fh, Bit8u fx, Bit8u fy,
+                               bool gfxcharw9, Bit8u cs, Bit8u ce, bool curs)
+{
+  Bit32u *buf, fgcolor, bgcolor;
+  Bit16u font_row, mask;
+  Bit8u *font_ptr, fontpixels, h = fh;
+  unsigned pitch = shmfbPitch >> 2;
+  bool dwidth;
+
+  if (shmfbScreen == NULL) return;
+  begin_update();
+  buf = (Bit32u*)shmfbScreen + yc * pitch + xc;
+  fgcolor = shmfbPalette[fc];
+  bgcolor = shmfbPalette[bc];
+  dwidth = (guest_fwidth > 9);
+  font_ptr = &vga_charmap[(ch << 5) + fy];
+  do {
+    font_row = *font_ptr++;
+    if (gfxcharw9) {
+      font_row = (font_row << 1) | (font_row & 0x01);
+    } else {
+      font_row <<= 1;
+    }
+    if (fx > 0) {
+      font_row <<= fx;
+    }
+    fontpixels = fw;
+    if (curs && (fy >= cs) && (fy <= ce))
+      mask = 0x100;
+    else
+      mask = 0x00;
+    do {
+      if ((font_row & 0x100) == mask)
+        *buf = bgcolor;
+      else
+        *buf = fgcolor;
+      buf++;
+      if (!dwidth || (fontpixels & 1)) font_row <<= 1;
+    } while (--fontpixels);
+    buf += (pitch - fw);
+    fy++;
+  } while (--h);
+  add_dirty_rect(xc, yc, fw, fh);
+}
+
+void bx_shmfb_gui_c::text_update(Bit8u *old_text, Bit8u *new_text,
+                                 unsigned long cursor_x, unsigned long cursor_y,
+                                 bx_vga_tminfo_t *tm_info)
+{
+  // present for compatibility
+}
+
+int bx_shmfb_gui_c::get_clipboard_text(Bit8u **bytes, Bit32s *nbytes)
+{
+  UNUSED(bytes);
+  UNUSED(nbytes);
+  return 0;
+}
+
+int bx_shmfb_gui_c::set_clipboard_text(char *text_snapshot, Bit32u len)
+{
+  UNUSED(text_snapshot);
+  UNUSED(len);
+  return 0;
+}
+
+bool bx_shmfb_gui_c::palette_change(Bit8u index, Bit8u red, Bit8u green, Bit8u blue)
+{
+  shmfbPalette[index] = ((Bit32u)red << 16) | ((Bit32u)green << 8) | blue;
+  return 1;
+}
+
+void bx_shmfb_gui_c::graphics_tile_update(Bit8u *tile, unsigned x0, unsigned y0)
+{
+  Bit32u *buf;
+  unsigned x, y, w, h, pitch = shmfbPitch >> 2;
+
+  if (shmfbScreen == NULL) return;
+  if (guest_bpp != 8) {
+    BX_PANIC(("%u bpp modes handled by new graphics API", guest_bpp));
+    return;
+  }
+  if ((x0 >= guest_xres) || (y0 >= guest_yres)) return;
+  w = ((x0 + x_tilesize) > guest_xres) ? (guest_xres - x0) : x_tilesize;
+  h = ((y0 + y_tilesize) > guest_yres) ? (guest_yres - y0) : y_tilesize;
+  begin_update();
+  buf = (Bit32u*)shmfbScreen + y0 * pitch + x0;
+  for (y = 0; y < h; y++) {
+    for (x = 0; x < w; x++) {
+      buf[x] = shmfbPalette[tile[x]];
+    }
+    tile += x_tilesize;
+    buf += pitch;
+  }
+  add_dirty_rect(x0, y0, w, h);
+}
+
+bx_svga_tileinfo_t *bx_shmfb_gui_c::graphics_tile_info(bx_svga_tileinfo_t *info)
+{
+  info->bpp = 32;
+  info->pitch = shmfbPitch;
+  info->red_shift = 24;
+  info->green_shift = 16;
+  info->blue_shift = 8;
+  info->red_mask = 0xff0000;
+  info->green_mask = 0x00ff00;
+  info->blue_mask = 0x0000ff;
+  info->is_indexed = 0;
+#ifdef BX_LITTLE_ENDIAN
+  info->is_little_endian = 1;
+#else
+  info->is_little_endian = 0;
+#endif
+
+  return info;
+}
+
+Bit8u *bx_shmfb_gui_c::graphics_tile_get(unsigned x0, unsigned y0,
+                                         unsigned *w, unsigned *h)
+{
+  if (x0 + x_tilesize > guest_xres) {
+    *w = guest_xres - x0;
+  } else {
+    *w = x_tilesize;
+  }
+
+  if (y0 + y_tilesize > guest_yres) {
+    *h = guest_yres - y0;
+  } else {
+    *h = y_tilesize;
+  }
+
+  // the caller writes pixels directly into the shared framebuffer
+  begin_update();
+  return shmfbScreen + y0 * shmfbPitch + x0 * 4;
+}
+
+void bx_shmfb_gui_c::graphics_tile_update_in_place(unsigned x0, unsigned y0,
+                                                   unsigned w, unsigned h)
+{
+  add_dirty_rect(x0, y0, w, h);
+}
+
+void bx_shmfb_gui_c::dimension_update(unsigned x, unsigned y, unsigned fheight, unsigned fwidth, unsigned bpp)
+{
+  if ((x > max_xres) || (y > max_yres)) {
+    BX_PANIC(("dimension_update(): guest resolution %ux%u exceeds shared framebuffer", x, y));
+    return;
+  }
+  if (bpp == 8 || bpp == 15 || bpp == 16 || bpp == 24 || bpp == 32) {
+    guest_bpp = bpp;
+  } else {
+    BX_PANIC(("%d bpp graphics mode not supported", bpp));
+  }
+  guest_textmode = (fheight > 0);
+  guest_fwidth = fwidth;
+  guest_fheight = fheight;
+  if ((x != guest_xres) || (y != guest_yres)) {
+    guest_xres = x;
+    guest_yres = y;
+    shmfbPending.flags |= BX_SHMFB_MODE_CHANGE;
+    clear_screen();
+  }
+}
+
+void bx_shmfb_gui_c::get_capabilities(Bit16u *xres, Bit16u *yres, Bit16u *bpp)
+{
+  *xres = max_xres;
+  *yres = max_yres;
+  *bpp = 32;
+}
+
+unsigned bx_shmfb_gui_c::create_bitmap(const unsigned char *bmap, unsigned xdim, unsigned ydim)
+{
+  UNUSED(bmap);
+  UNUSED(xdim);
+  UNUSED(ydim);
+  return(0);
+}
+
+unsigned bx_shmfb_gui_c::headerbar_bitmap(unsigned bmap_id, unsigned alignment, void (*f)(void))
+{
+  UNUSED(bmap_id);
+  UNUSED(alignment);
+  UNUSED(f);
+  return(0);
+}
+
+void bx_shmfb_gui_c::show_headerbar(void)
+{
+}
+
+void bx_shmfb_gui_c::replace_bitmap(unsigned hbar_id, unsigned bmap_id)
+{
+  UNUSED(hbar_id);
+  UNUSED(bmap_id);
+}
+
+void bx_shmfb_gui_c::exit(void)
+{
+  if (shmfbHeader != NULL) {
+    publish_frame();
+    munmap(shmfbHeader, shmfbSize);
+    shmfbHeader = NULL;
+    shmfbScreen = NULL;
+  }
+  if (shmfbFd >= 0) {
+    close(shmfbFd);
+    shmfbFd = -1;
+    if (!shmfbKeep) {
+      shm_unlink(shmfbName);
+    }
+  }
+  BX_DEBUG(("bx_shmfb_gui_c::exit()"));
+}
+
+void bx_shmfb_gui_c::mouse_enabled_changed_specific(bool val)
+{
+}
+
+#endif /* if BX_WITH_SHMFB */
@@ -0,0 +1,89 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+// Layout of the POSIX shared memory object exported by the "shmfb" display
+// library. External tools (screenshot / video recorders) can map the object
+// read-only and consume guest frames without any help from Bochs.
+//
+// The object starts with a bx_shmfb_header_t followed by the framebuffer at
+// offset 'fb_offset'. The framebuffer always has the maximum guest size
+// (max_xres * max_yres) and uses 32 bpp little endian pixels (0x00RRGGBB).
+// Only the upper left 'width' x 'height' area of a frame is valid.
+//
+// Every time the emulated display is flushed with pending changes, Bochs
+// stores a frame record in ring[seq % ring_size] and then increments 'seq',
+// so the record of frame n lives in ring[(n - 1) % ring_size]. The record
+// lists the rectangles that changed since the previous frame. A reader
+// remembers the last seq it has processed and walks the ring up to the
+// current seq. If it falls behind by ring_size frames or more, it must
+// re-read the whole screen.
+//
+// The framebuffer is updated in place. 'fb_gen' is odd while Bochs is writing
+// pixels and even when the framebuffer is consistent with frame 'seq'. A
+// reader that needs a tear-free copy reads fb_gen, copies the data and
+// retries if fb_gen was odd or has changed meanwhile (seqlock scheme).
+
+#ifndef BX_SHMFB_H
+#define BX_SHMFB_H
+
+#define BX_SHMFB_MAGIC        0x42464d53  // "SMFB"
+#define BX_SHMFB_VERSION      1
+#define BX_SHMFB_RING_SIZE    64
+#define BX_SHMFB_MAX_RECTS    32
+
+#define BX_SHMFB_DEF_NAME     "/bochs-shmfb"
+
+// frame flags
+#define BX_SHMFB_FULL_UPDATE  0x0001  // whole screen changed, rect[] unused
+#define BX_SHMFB_MODE_CHANGE  0x0002  // guest resolution changed
+#define BX_SHMFB_TEXT_MODE    0x0004  // guest is in text mode
+
+typedef struct {
+  Bit16u x, y, w, h;
+} bx_shmfb_rect_t;
+
+typedef struct {
+  Bit64u seq;         // sequence number of this frame (1 = first frame)
+  Bit64u timestamp;   // emulated time in microseconds
+  Bit16u width;       // valid framebuffer area for this frame
+  Bit16u height;
+  Bit16u flags;
+  Bit16u n_rects;
+  bx_shmfb_rect_t rect[BX_SHMFB_MAX_RECTS];
+} bx_shmfb_frame_t;
+
+typedef struct {
+  Bit32u magic;
+  Bit32u version;
+  Bit32u fb_offset;   // offset of the framebuffer from start of the object
+  Bit32u fb_pitch;    // bytes per framebuffer line
+  Bit16u max_xres;
+  Bit16u max_yres;
+  Bit16u bpp;         // always 32
+  Bit16u ring_size;   // number of entries in ring[]
+  Bit32u pid;         // process id of the Bochs instance
+  Bit32u reserved;
+  volatile Bit64u seq;     // number of frames published so far
+  volatile Bit64u fb_gen;  // odd while the framebuffer is being modified
+  bx_shmfb_frame_t ring[BX_SHMFB_RING_SIZE];
+} bx_shmfb_header_t;
+
+#endif
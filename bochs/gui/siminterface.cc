@@ -28,6 +28,18 @@
 #include "iodev.h"
 #include "bx_debug/debug.h"
 #include "virt_timer.h"
+#include "bxthread.h"
+
+#if BX_HAVE_SYS_MMAN_H && !defined(WIN32)
+#include <sys/mman.h>
+#include <sys/wait.h>
+// Write large binary save/restore data (guest RAM) from a forked child and
+// map it back on restore, see save_state() and restore_bochs_param().
+#define BX_SR_BULK_DATA 1
+#define BX_SR_BULK_MIN_SIZE (1 << 20)
+#else
+#define BX_SR_BULK_DATA 0
+#endif
 
 bx_simulator_interface_c *SIM = NULL;
 logfunctions *siminterface_log = NULL;
@@ -63,6 +75,30 @@ typedef struct _addon_option_t {
   struct _addon_option_t *next;
 } addon_option_t;
 
+// Hashed index of resolved parameter paths, so that repeated lookups of
+// the same name don't walk the tree with string compares every time.
+// Only hits are stored, and the whole index is dropped when a parameter
+// is deleted or unlinked (see bx_param_c::get_tree_changes()).
+#define BX_PARAM_INDEX_MIN_SIZE 256
+
+typedef struct {
+  bx_param_c *base;
+  char *pname;
+  Bit32u hash;
+  bx_param_c *param;
+} param_index_entry_t;
+
+#if BX_SR_BULK_DATA
+typedef struct _sr_bulk_job_t {
+  char path[BX_PATHNAME_LEN+1];
+  char tmppath[BX_PATHNAME_LEN+8];
+  const Bit8u *data;
+  Bit32u size;
+  int fd;
+  struct _sr_bulk_job_t *next;
+} sr_bulk_job_t;
+#endif
+
 class bx_real_sim_c : public bx_simulator_interface_c {
   bxevent_handler bxevent_callback;
   void *bxevent_callback_data;
@@ -80,6 +116,20 @@ class bx_real_sim_c : public bx_simulator_interface_c {
   bool bx_debug_gui;
   bool bx_log_viewer;
   bool wxsel;
+  param_index_entry_t *param_index;
+  unsigned param_index_size;
+  unsigned param_index_count;
+  Bit32u param_index_changes;
+  BX_MUTEX(param_index_mutex);
+  void param_index_flush();
+  void param_index_insert(bx_param_c *base, const char *pname, Bit32u hash, bx_param_c *param);
+#if BX_SR_BULK_DATA
+  sr_bulk_job_t *sr_bulk_jobs;
+  pid_t sr_writer_pid;
+  bool save_bulk_data();
+  bool wait_bulk_writer();
+  bool restore_bulk_data(const char *path, bx_shadow_data_c *dparam);
+#endif
 public:
   bx_real_sim_c();
   virtual ~bx_real_sim_c() {}
@@ -275,6 +325,49 @@ static bx_param_c *find_param(const char *full_pname, const char *rest_of_pname,
   return find_param(full_pname, from, child);
 }
 
+void bx_real_sim_c::param_index_flush()
+{
+  for (unsigned i = 0; i < param_index_size; i++) {
+    if (param_index[i].pname != NULL) {
+      delete [] param_index[i].pname;
+      param_index[i].pname = NULL;
+    }
+  }
+  param_index_count = 0;
+  param_index_changes = bx_param_c::get_tree_changes();
+}
+
+void bx_real_sim_c::param_index_insert(bx_param_c *base, const char *pname, Bit32u hash, bx_param_c *param)
+{
+  unsigned i;
+
+  if ((param_index_count + 1) * 4 > param_index_size * 3) {
+    param_index_entry_t *old_index = param_index;
+    unsigned old_size = param_index_size;
+    param_index_size = old_size ? (old_size * 2) : BX_PARAM_INDEX_MIN_SIZE;
+    param_index = new param_index_entry_t[param_index_size];
+    memset(param_index, 0, param_index_size * sizeof(param_index_entry_t));
+    for (i = 0; i < old_size; i++) {
+      if (old_index[i].pname != NULL) {
+        unsigned j = old_index[i].hash & (param_index_size - 1);
+        while (param_index[j].pname != NULL)
+          j = (j + 1) & (param_index_size - 1);
+        param_index[j] = old_index[i];
+      }
+    }
+    delete [] old_index;
+  }
+  i = hash & (param_index_size - 1);
+  while (param_index[i].pname != NULL)
+    i = (i + 1) & (param_index_size - 1);
+  param_index[i].base = base;
+  param_index[i].pname = new char[strlen(pname) + 1];
+  strcpy(param_index[i].pname, pname);
+  param_index[i].hash = hash;
+  param_index[i].param = param;
+  param_index_count++;
+}
+
 bx_param_c *bx_real_sim_c::get_param(const char *pname, bx_param_c *base)
 {
   if (base == NULL)
@@ -282,7 +375,39 @@ bx_param_c *bx_real_sim_c::get_param(const char *pname, bx_param_c *base)
   // to access top level object, look for parameter "."
   if (pname[0] == '.' && pname[1] == 0)
     return base;
-  return find_param(pname, pname, base);
+
+  // names are matched case-insensitively, so hash them the same way
+  Bit32u hash = 2166136261U ^ (Bit32u)((Bit64u)(bx_ptr_equiv_t) base >> 4);
+  for (const char *c = pname; *c; c++)
+    hash = (hash ^ (Bit8u) tolower(*c)) * 16777619U;
+
+  BX_LOCK(param_index_mutex);
+  if (param_index_changes != bx_param_c::get_tree_changes())
+    param_index_flush();
+  if (param_index_count > 0) {
+    unsigned i = hash & (param_index_size - 1);
+    while (param_index[i].pname != NULL) {
+      if ((param_index[i].hash == hash) && (param_index[i].base == base) &&
+          !stricmp(param_index[i].pname, pname)) {
+        bx_param_c *param = param_index[i].param;
+        BX_UNLOCK(param_index_mutex);
+        return param;
+      }
+      i = (i + 1) & (param_index_size - 1);
+    }
+  }
+  Bit32u changes = param_index_changes;
+  BX_UNLOCK(param_index_mutex);
+  // the tree walk may log or panic, so it is done without holding the lock
+  bx_param_c *param = find_param(pname, pname, base);
+  if (param != NULL) {
+    BX_LOCK(param_index_mutex);
+    if ((changes == param_index_changes) &&
+        (changes == bx_param_c::get_tree_changes()))
+      param_index_insert(base, pname, hash, param);
+    BX_UNLOCK(param_index_mutex);
+  }
+  return param;
 }
 
 bx_param_num_c *bx_real_sim_c::get_param_num(const char *pname, bx_param_c *base)
@@ -371,6 +496,15 @@ bx_real_sim_c::bx_real_sim_c()
   param_id = BXP_NEW_PARAM_ID;
   rt_conf_entries = NULL;
   addon_options = NULL;
+  param_index = NULL;
+  param_index_size = 0;
+  param_index_count = 0;
+  param_index_changes = bx_param_c::get_tree_changes();
+  BX_INIT_MUTEX(param_index_mutex);
+#if BX_SR_BULK_DATA
+  sr_bulk_jobs = NULL;
+  sr_writer_pid = 0;
+#endif
 }
 
 int bx_real_sim_c::set_init_done(bool n)
@@ -1066,6 +1200,11 @@ void bx_real_sim_c::cleanup_save_restore()
 {
   bx_list_c *list = get_bochs_root();
 
+#if BX_SR_BULK_DATA
+  // don't leave an incomplete checkpoint behind
+  wait_bulk_writer();
+#endif
+
   if (list != NULL) {
     list->clear();
   }
@@ -1078,6 +1217,9 @@ bool bx_real_sim_c::save_state(const char *checkpoint_path)
   int dev, ndev = SIM->get_n_log_modules();
   int type, ntype = SIM->get_max_log_level();
 
+#if BX_SR_BULK_DATA
+  wait_bulk_writer();
+#endif
   get_param_string(BXPN_RESTORE_PATH)->set(checkpoint_path);
   sprintf(sr_file, "%s/config", checkpoint_path);
   if (write_rc(sr_file, 1) < 0)
@@ -1113,9 +1255,179 @@ bool bx_real_sim_c::save_state(const char *checkpoint_path)
     }
   }
   get_param_string(BXPN_RESTORE_PATH)->set("none");
+#if BX_SR_BULK_DATA
+  return save_bulk_data();
+#else
   return 1;
+#endif
+}
+
+#if BX_SR_BULK_DATA
+// Writes 'size' bytes to 'fd', leaving holes for all-zero pages, so that
+// mostly unused guest RAM costs neither disk space nor write time.
+// Only uses async-signal-safe calls, since it runs in the forked writer.
+static bool write_sparse(int fd, const Bit8u *data, Bit32u size)
+{
+  const Bit32u chunk = 4096;
+  Bit32u pos = 0, start;
+
+  while (pos < size) {
+    // skip zero pages
+    while (pos < size) {
+      Bit32u len = (size - pos < chunk) ? (size - pos) : chunk;
+      const Bit8u *p = data + pos;
+      Bit32u i = 0;
+      while ((i < len) && (p[i] == 0)) i++;
+      if (i < len) break;
+      pos += len;
+    }
+    // then write out the run of non-zero pages following them
+    start = pos;
+    while (pos < size) {
+      Bit32u len = (size - pos < chunk) ? (size - pos) : chunk;
+      const Bit8u *p = data + pos;
+      Bit32u i = 0;
+      while ((i < len) && (p[i] == 0)) i++;
+      if (i == len) break;
+      pos += len;
+    }
+    if (pos > start) {
+      if (lseek(fd, start, SEEK_SET) < 0)
+        return 0;
+      while (start < pos) {
+        ssize_t ret = write(fd, data + start, pos - start);
+        if (ret <= 0)
+          return 0;
+        start += (Bit32u) ret;
+      }
+    }
+  }
+  return (ftruncate(fd, size) == 0);
 }
 
+// Large binary data queued by save_sr_param() is written by a forked child
+// process. Its copy-on-write snapshot of the address space keeps the data
+// consistent while the simulation continues, so the guest is only stopped
+// for the fork itself. Each file is written as <name>.part and renamed once
+// complete, so a restore never picks up a partially written image.
+bool bx_real_sim_c::save_bulk_data()
+{
+  sr_bulk_job_t *job, *next;
+  bool ret = 1;
+
+  if (sr_bulk_jobs == NULL)
+    return 1;
+
+  for (job = sr_bulk_jobs; job != NULL; job = job->next) {
+    sprintf(job->tmppath, "%s.part", job->path);
+    // unlink first: a restored session may still have the old image mapped
+    unlink(job->path);
+    unlink(job->tmppath);
+    job->fd = open(job->tmppath, O_WRONLY | O_CREAT | O_TRUNC
+#ifdef O_BINARY
+                   | O_BINARY
+#endif
+                   , S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    if (job->fd < 0) {
+      BX_ERROR(("save_state: cannot create '%s'", job->tmppath));
+      ret = 0;
+    }
+  }
+  if (ret) {
+    sr_writer_pid = fork();
+    if (sr_writer_pid == 0) {
+      int status = 0;
+      for (job = sr_bulk_jobs; job != NULL; job = job->next) {
+        if (!write_sparse(job->fd, job->data, job->size) ||
+            (close(job->fd) < 0) || (rename(job->tmppath, job->path) < 0)) {
+          status = 1;
+        }
+      }
+      _exit(status);
+    }
+    if (sr_writer_pid < 0) {
+      BX_INFO(("save_state: fork() failed, writing memory image in place"));
+      sr_writer_pid = 0;
+      for (job = sr_bulk_jobs; job != NULL; job = job->next) {
+        if (!write_sparse(job->fd, job->data, job->size) ||
+            (rename(job->tmppath, job->path) < 0)) {
+          BX_ERROR(("save_state: cannot write '%s'", job->path));
+          ret = 0;
+        }
+      }
+    }
+  }
+  for (job = sr_bulk_jobs; job != NULL; job = next) {
+    next = job->next;
+    if (job->fd >= 0)
+      close(job->fd);
+    delete job;
+  }
+  sr_bulk_jobs = NULL;
+  return ret;
+}
+
+bool bx_real_sim_c::wait_bulk_writer()
+{
+  int status;
+
+  if (sr_writer_pid <= 0)
+    return 1;
+  while (waitpid(sr_writer_pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      sr_writer_pid = 0;
+      return 0;
+    }
+  }
+  sr_writer_pid = 0;
+  if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+    BX_ERROR(("save_state: writing the memory image failed"));
+    return 0;
+  }
+  return 1;
+}
+
+// Maps a large binary data file over the parameter's host buffer instead of
+// reading it. Pages are then read from the page cache on first access and
+// copied privately on first write, so resuming doesn't have to load the
+// whole guest RAM up front. Returns 0 if the caller must read the file.
+bool bx_real_sim_c::restore_bulk_data(const char *path, bx_shadow_data_c *dparam)
+{
+  Bit8u *data = dparam->getptr();
+  Bit32u size = dparam->get_size();
+  long pagesize = sysconf(_SC_PAGESIZE);
+  struct stat st;
+
+  if ((size < BX_SR_BULK_MIN_SIZE) || (pagesize <= 0) ||
+      (((bx_ptr_equiv_t) data) & (pagesize - 1)))
+    return 0;
+  int fd = open(path, O_RDONLY
+#ifdef O_BINARY
+                | O_BINARY
+#endif
+                );
+  if (fd < 0)
+    return 0;
+  if ((fstat(fd, &st) < 0) || ((Bit64u) st.st_size < size)) {
+    close(fd);
+    return 0;
+  }
+  Bit32u maplen = size & ~(Bit32u)(pagesize - 1);
+  void *ptr = mmap(data, maplen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  if (ptr == MAP_FAILED) {
+    // with MAP_FIXED the old contents may already be gone
+    BX_PANIC(("restore_bochs_param(): cannot map '%s'", path));
+    close(fd);
+    return 0;
+  }
+  if ((maplen < size) && (pread(fd, data + maplen, size - maplen, maplen) != (ssize_t)(size - maplen))) {
+    BX_ERROR(("restore_bochs_param(): cannot read '%s'", path));
+  }
+  close(fd);
+  return 1;
+}
+#endif
+
 bool bx_real_sim_c::restore_config()
 {
   char config[BX_PATHNAME_LEN];
@@ -1254,6 +1566,10 @@ bool bx_real_sim_c::restore_bochs_param(bx_list_c *root, const char *sr_path, co
                     bx_shadow_data_c *dparam = (bx_shadow_data_c*)param;
                     if (!dparam->is_text_format()) {
                       sprintf(devdata, "%s/%s", sr_path, ptr);
+#if BX_SR_BULK_DATA
+                      if (restore_bulk_data(devdata, dparam))
+                        break;
+#endif
                       fp2 = fopen(devdata, "rb");
                       if (fp2 != NULL) {
                         fread(dparam->getptr(), 1, dparam->get_size(), fp2);
@@ -1371,6 +1687,19 @@ bool bx_real_sim_c::save_sr_param(FILE *fp, bx_param_c *node, const char *sr_pat
             sprintf(tmpstr, "%s/%s", sr_path, pname);
           else
             strcpy(tmpstr, pname);
+#if BX_SR_BULK_DATA
+          if (dparam->get_size() >= BX_SR_BULK_MIN_SIZE) {
+            // written after the tree walk, see save_bulk_data()
+            sr_bulk_job_t *job = new sr_bulk_job_t;
+            strcpy(job->path, tmpstr);
+            job->data = dparam->getptr();
+            job->size = dparam->get_size();
+            job->fd = -1;
+            job->next = sr_bulk_jobs;
+            sr_bulk_jobs = job;
+            break;
+          }
+#endif
           fp2 = fopen(tmpstr, "wb");
           if (fp2 != NULL) {
             fwrite(dparam->getptr(), 1, dparam->get_size(), fp2);
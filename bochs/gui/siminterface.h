@@ -589,6 +589,9 @@ public:
   virtual int set_init_done(bool n) {return 0;}
   virtual void reset_all_param() {}
   // new param methods
+  // Path lookups are hashed, and the returned object stays valid as long as
+  // the parameter exists, so code that needs a value often should look it
+  // up once at init and keep the pointer.
   virtual bx_param_c *get_param(const char *pname, bx_param_c *base=NULL) {return NULL;}
   virtual bx_param_num_c *get_param_num(const char *pname, bx_param_c *base=NULL) {return NULL;}
   virtual bx_param_string_c *get_param_string(const char *pname, bx_param_c *base=NULL) {return NULL;}
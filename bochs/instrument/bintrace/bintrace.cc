@@ -0,0 +1,207 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+// Trace file headers and block compression. This file is linked into the
+// instrumentation library and into the bxtrace tool, so it must not use
+// anything from the simulator.
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bintrace.h"
+
+void bx_trace_write_header(Bit8u *buf, const bx_trace_header_t *hdr)
+{
+  memset(buf, 0, BX_TRACE_HEADER_SIZE);
+  memcpy(buf, BX_TRACE_MAGIC, strlen(BX_TRACE_MAGIC));
+  bx_trace_put32(buf + 8, hdr->version);
+  bx_trace_put32(buf + 12, hdr->flags);
+  bx_trace_put32(buf + 16, hdr->ncpus);
+  bx_trace_put32(buf + 20, hdr->block_size);
+}
+
+bool bx_trace_read_header(const Bit8u *buf, bx_trace_header_t *hdr)
+{
+  if (memcmp(buf, BX_TRACE_MAGIC, strlen(BX_TRACE_MAGIC) + 1) != 0)
+    return 0;
+  hdr->version = bx_trace_get32(buf + 8);
+  hdr->flags = bx_trace_get32(buf + 12);
+  hdr->ncpus = bx_trace_get32(buf + 16);
+  hdr->block_size = bx_trace_get32(buf + 20);
+  return (hdr->version == BX_TRACE_VERSION);
+}
+
+void bx_trace_write_block_header(Bit8u *buf, const bx_trace_block_t *blk)
+{
+  memset(buf, 0, BX_TRACE_BLOCK_HDR_SIZE);
+  bx_trace_put32(buf, BX_TRACE_BLOCK_MAGIC);
+  bx_trace_put16(buf + 4, blk->cpu);
+  bx_trace_put16(buf + 6, blk->flags);
+  bx_trace_put32(buf + 8, blk->raw_size);
+  bx_trace_put32(buf + 12, blk->stored_size);
+  bx_trace_put64(buf + 16, blk->icount);
+  bx_trace_put64(buf + 24, blk->rip);
+}
+
+bool bx_trace_read_block_header(const Bit8u *buf, bx_trace_block_t *blk)
+{
+  if (bx_trace_get32(buf) != BX_TRACE_BLOCK_MAGIC)
+    return 0;
+  blk->cpu = bx_trace_get16(buf + 4);
+  blk->flags = bx_trace_get16(buf + 6);
+  blk->raw_size = bx_trace_get32(buf + 8);
+  blk->stored_size = bx_trace_get32(buf + 12);
+  blk->icount = bx_trace_get64(buf + 16);
+  blk->rip = bx_trace_get64(buf + 24);
+  return 1;
+}
+
+// The compressed data is a sequence of (literals, match) pairs. Each pair
+// starts with a token byte: the upper 4 bits hold the number of literals,
+// the lower 4 bits the match length minus 4. A value of 15 means that
+// more bytes follow and are added until a byte below 255 is found. The
+// literals follow the literal length, then the 16-bit match offset (little
+// endian) and the extra match length bytes. The last pair has no match.
+
+#define LZ_HASH_BITS   14
+#define LZ_MIN_MATCH   4
+#define LZ_MAX_OFFSET  0xffff
+
+static Bit8u *lz_put_length(Bit8u *op, const Bit8u *oend, Bit32u len)
+{
+  while (len >= 255) {
+    if (op >= oend) return NULL;
+    *op++ = 255;
+    len -= 255;
+  }
+  if (op >= oend) return NULL;
+  *op++ = (Bit8u)len;
+  return op;
+}
+
+static Bit8u *lz_put_sequence(Bit8u *op, const Bit8u *oend, const Bit8u *lit,
+                              Bit32u nlit, Bit32u offset, Bit32u mlen)
+{
+  Bit8u *token = op++;
+
+  if (op > oend) return NULL;
+  *token = (Bit8u)(((nlit < 15) ? nlit : 15) << 4);
+  if (nlit >= 15) {
+    if ((op = lz_put_length(op, oend, nlit - 15)) == NULL) return NULL;
+  }
+  if ((Bit32u)(oend - op) < nlit) return NULL;
+  memcpy(op, lit, nlit);
+  op += nlit;
+  if (mlen > 0) {
+    mlen -= LZ_MIN_MATCH;
+    *token |= (mlen < 15) ? mlen : 15;
+    if ((oend - op) < 2) return NULL;
+    *op++ = (Bit8u)offset;
+    *op++ = (Bit8u)(offset >> 8);
+    if (mlen >= 15) {
+      if ((op = lz_put_length(op, oend, mlen - 15)) == NULL) return NULL;
+    }
+  }
+  return op;
+}
+
+// not reentrant: the hash table is shared by all calls
+Bit32u bx_trace_compress(const Bit8u *src, Bit32u srclen, Bit8u *dst, Bit32u dstlen)
+{
+  static Bit32u hash_table[1 << LZ_HASH_BITS];
+  const Bit8u *oend = dst + dstlen;
+  Bit8u *op = dst;
+  Bit32u ip = 0, anchor = 0, seq, h, ref, mlen;
+
+  // entries store position + 1, so zero marks an empty slot
+  memset(hash_table, 0, sizeof(hash_table));
+  while ((ip + LZ_MIN_MATCH) <= srclen) {
+    memcpy(&seq, src + ip, 4);
+    h = (seq * 2654435761U) >> (32 - LZ_HASH_BITS);
+    ref = hash_table[h];
+    hash_table[h] = ip + 1;
+    if ((ref == 0) || ((ip - (ref - 1)) > LZ_MAX_OFFSET) ||
+        (memcmp(src + ref - 1, src + ip, 4) != 0)) {
+      ip++;
+      continue;
+    }
+    ref--;
+    mlen = LZ_MIN_MATCH;
+    while (((ip + mlen) < srclen) && (src[ref + mlen] == src[ip + mlen])) {
+      mlen++;
+    }
+    op = lz_put_sequence(op, oend, src + anchor, ip - anchor, ip - ref, mlen);
+    if (op == NULL) return 0;
+    ip += mlen;
+    anchor = ip;
+  }
+  op = lz_put_sequence(op, oend, src + anchor, srclen - anchor, 0, 0);
+  if (op == NULL) return 0;
+  return (Bit32u)(op - dst);
+}
+
+static const Bit8u *lz_get_length(const Bit8u *ip, const Bit8u *iend, Bit32u *len)
+{
+  Bit8u b;
+
+  do {
+    if (ip >= iend) return NULL;
+    b = *ip++;
+    *len += b;
+  } while (b == 255);
+  return ip;
+}
+
+Bit32u bx_trace_decompress(const Bit8u *src, Bit32u srclen, Bit8u *dst, Bit32u dstlen)
+{
+  const Bit8u *ip = src, *iend = src + srclen;
+  Bit32u op = 0, nlit, mlen, offset;
+  Bit8u token;
+
+  while (ip < iend) {
+    token = *ip++;
+    nlit = token >> 4;
+    if (nlit == 15) {
+      if ((ip = lz_get_length(ip, iend, &nlit)) == NULL) return 0;
+    }
+    if (((Bit32u)(iend - ip) < nlit) || ((dstlen - op) < nlit)) return 0;
+    memcpy(dst + op, ip, nlit);
+    ip += nlit;
+    op += nlit;
+    if (ip >= iend) break;  // last sequence has no match
+    if ((iend - ip) < 2) return 0;
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    mlen = token & 0x0f;
+    if (mlen == 15) {
+      if ((ip = lz_get_length(ip, iend, &mlen)) == NULL) return 0;
+    }
+    mlen += LZ_MIN_MATCH;
+    if ((offset == 0) || (offset > op) || ((dstlen - op) < mlen)) return 0;
+    // byte by byte, the match may overlap the output
+    for (Bit32u n = 0; n < mlen; n++, op++) {
+      dst[op] = dst[op - offset];
+    }
+  }
+  return op;
+}
@@ -0,0 +1,220 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+// Binary execution trace file format, shared by the "bintrace"
+// instrumentation library and the bxtrace reader.
+//
+// A trace file starts with a file header followed by a sequence of blocks.
+// Each block holds the events of one CPU and starts with a block header.
+// All header fields are stored in little endian byte order.
+//
+//   file header (24 bytes)
+//     0  magic "BXTRACE\0"
+//     8  version
+//    12  flags (BX_TRACE_F_*)
+//    16  number of CPUs
+//    20  maximum size of an uncompressed block
+//
+//   block header (32 bytes)
+//     0  magic BX_TRACE_BLOCK_MAGIC
+//     4  cpu
+//     6  block flags (BX_TRACE_BLOCK_*)
+//     8  size of the uncompressed event data
+//    12  size of the stored event data following the header
+//    16  number of instructions this CPU executed before the block
+//    24  linear address of the instruction executing at the block start
+//
+// The event data is compressed with a byte oriented LZ77 coder (see
+// bx_trace_compress()) unless that doesn't make the block smaller. Inside
+// a block every event starts with a tag byte. Addresses are delta encoded
+// against the previous event of the same kind and stored as zigzag
+// varints. The delta state is reset at the start of each block, so blocks
+// can be decoded independently. Branch targets are relative to the address
+// of the branch instruction, which may have been recorded in the previous
+// block, so the block header carries it.
+//
+//   0x00 | len        instruction at the expected address (previous
+//                     instruction + length, or the last branch target)
+//   0x10 | len        instruction elsewhere, followed by
+//                     svarint(address - expected address)
+//                     With BX_TRACE_F_OPCODES, 'len' opcode bytes follow
+//                     either tag.
+//   0x20 | kind       near branch; taken branches are followed by
+//                     svarint(target - address of the branch)
+//   0x30 | kind       far branch, followed by varint(new cs) and
+//                     varint(linear target)
+//   0x40 - 0x7f       memory access: bits 5..3 = access type (BX_READ...),
+//                     bits 2..0 = log2(size), 7 = varint(size) follows.
+//                     Followed by svarint(linear - previous linear) and
+//                     svarint(offset - previous offset) with
+//                     offset = physical - linear.
+//   0x80              exception: varint(vector), varint(error code)
+//   0x81              software interrupt: varint(vector)
+//   0x82              hardware interrupt: varint(vector), varint(cs),
+//                     varint(rip)
+//   0x83              reset: varint(type)
+//
+// All instruction and branch addresses are linear addresses.
+
+#ifndef BX_BINTRACE_H
+#define BX_BINTRACE_H
+
+#define BX_TRACE_MAGIC          "BXTRACE"
+#define BX_TRACE_VERSION        1
+#define BX_TRACE_HEADER_SIZE    24
+
+#define BX_TRACE_BLOCK_MAGIC    0x4b4c4254  // "TBLK"
+#define BX_TRACE_BLOCK_HDR_SIZE 32
+#define BX_TRACE_BLOCK_SIZE     (256 * 1024)
+
+// file flags
+#define BX_TRACE_F_OPCODES      0x0001  // opcode bytes are stored
+#define BX_TRACE_F_MEMORY       0x0002  // memory accesses are stored
+
+// block flags
+#define BX_TRACE_BLOCK_COMPRESSED 0x0001
+
+// event tags
+#define BX_TRACE_EV_INSN        0x00
+#define BX_TRACE_EV_INSN_JUMP   0x10
+#define BX_TRACE_EV_BRANCH      0x20
+#define BX_TRACE_EV_FAR_BRANCH  0x30
+#define BX_TRACE_EV_MEM         0x40
+#define BX_TRACE_EV_EXCEPTION   0x80
+#define BX_TRACE_EV_INTERRUPT   0x81
+#define BX_TRACE_EV_HWINT       0x82
+#define BX_TRACE_EV_RESET       0x83
+
+// branch kinds
+#define BX_TRACE_BR_NOT_TAKEN   0
+#define BX_TRACE_BR_TAKEN       1
+// 2 .. 12 are the BX_INSTR_IS_JMP .. BX_INSTR_IS_SYSEXIT types minus 8
+#define BX_TRACE_BR_TYPE_OFFSET 8
+
+// longest encoding of a single event
+#define BX_TRACE_MAX_EVENT      48
+
+typedef struct {
+  Bit32u version;
+  Bit32u flags;
+  Bit32u ncpus;
+  Bit32u block_size;
+} bx_trace_header_t;
+
+typedef struct {
+  Bit16u cpu;
+  Bit16u flags;
+  Bit32u raw_size;
+  Bit32u stored_size;
+  Bit64u icount;
+  Bit64u rip;
+} bx_trace_block_t;
+
+// little endian helpers
+
+BX_CPP_INLINE void bx_trace_put16(Bit8u *p, Bit16u val)
+{
+  p[0] = (Bit8u)val;
+  p[1] = (Bit8u)(val >> 8);
+}
+
+BX_CPP_INLINE void bx_trace_put32(Bit8u *p, Bit32u val)
+{
+  bx_trace_put16(p, (Bit16u)val);
+  bx_trace_put16(p + 2, (Bit16u)(val >> 16));
+}
+
+BX_CPP_INLINE void bx_trace_put64(Bit8u *p, Bit64u val)
+{
+  bx_trace_put32(p, (Bit32u)val);
+  bx_trace_put32(p + 4, (Bit32u)(val >> 32));
+}
+
+BX_CPP_INLINE Bit16u bx_trace_get16(const Bit8u *p)
+{
+  return (Bit16u)(p[0] | (p[1] << 8));
+}
+
+BX_CPP_INLINE Bit32u bx_trace_get32(const Bit8u *p)
+{
+  return bx_trace_get16(p) | ((Bit32u)bx_trace_get16(p + 2) << 16);
+}
+
+BX_CPP_INLINE Bit64u bx_trace_get64(const Bit8u *p)
+{
+  return bx_trace_get32(p) | ((Bit64u)bx_trace_get32(p + 4) << 32);
+}
+
+// varint helpers (7 bits per byte, least significant group first)
+
+BX_CPP_INLINE Bit8u *bx_trace_put_varint(Bit8u *p, Bit64u val)
+{
+  while (val >= 0x80) {
+    *p++ = (Bit8u)(val | 0x80);
+    val >>= 7;
+  }
+  *p++ = (Bit8u)val;
+  return p;
+}
+
+BX_CPP_INLINE Bit8u *bx_trace_put_svarint(Bit8u *p, Bit64s val)
+{
+  return bx_trace_put_varint(p, ((Bit64u)val << 1) ^ (Bit64u)(val >> 63));
+}
+
+BX_CPP_INLINE const Bit8u *bx_trace_get_varint(const Bit8u *p, const Bit8u *end, Bit64u *val)
+{
+  Bit64u result = 0;
+  unsigned shift = 0;
+
+  while (p < end) {
+    Bit8u b = *p++;
+    result |= (Bit64u)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *val = result;
+      return p;
+    }
+    shift += 7;
+    if (shift >= 64) break;
+  }
+  return NULL;
+}
+
+BX_CPP_INLINE const Bit8u *bx_trace_get_svarint(const Bit8u *p, const Bit8u *end, Bit64s *val)
+{
+  Bit64u u;
+
+  p = bx_trace_get_varint(p, end, &u);
+  *val = (Bit64s)(u >> 1) ^ -(Bit64s)(u & 1);
+  return p;
+}
+
+void bx_trace_write_header(Bit8u *buf, const bx_trace_header_t *hdr);
+bool bx_trace_read_header(const Bit8u *buf, bx_trace_header_t *hdr);
+void bx_trace_write_block_header(Bit8u *buf, const bx_trace_block_t *blk);
+bool bx_trace_read_block_header(const Bit8u *buf, bx_trace_block_t *blk);
+
+// block compression; both return the output size or 0 if the output
+// buffer is too small or the input is corrupted
+Bit32u bx_trace_compress(const Bit8u *src, Bit32u srclen, Bit8u *dst, Bit32u dstlen);
+Bit32u bx_trace_decompress(const Bit8u *src, Bit32u srclen, Bit8u *dst, Bit32u dstlen);
+
+#endif
@@ -0,0 +1,301 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+// bxtrace: reader for binary execution traces written by the "bintrace"
+// instrumentation library. Prints the events as text or a summary.
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osdep.h"
+#include "bintrace.h"
+
+#define BX_TRACE_MAX_CPUS 256
+
+const char *usage_msg =
+  "Usage: bxtrace [options] tracefile\n\n"
+  "Supported options:\n"
+  "  -s         print summary only\n"
+  "  -c cpu     print events of this CPU only\n"
+  "  -n count   stop after 'count' instructions\n"
+  "  -nomem     don't print memory accesses\n"
+  "  -h         show this help\n\n";
+
+static const char *branch_name[16] = {
+  "not taken", "taken", "jmp", "jmp indirect", "call", "call indirect",
+  "ret", "iret", "int", "syscall", "sysret", "sysenter", "sysexit",
+  "?", "?", "?"
+};
+
+static const char *access_name[8] = {
+  "RD", "WR", "EX", "RW", "SS-RD", "SS-WR", "SS-INV", "SS-RW"
+};
+
+typedef struct {
+  Bit64u insns;
+  Bit64u jumps;        // instructions not at the expected address
+  Bit64u branches[16];
+  Bit64u far_branches;
+  Bit64u mem[8];
+  Bit64u exceptions;
+  Bit64u interrupts;
+  Bit64u hw_interrupts;
+  Bit64u resets;
+} trace_stats_t;
+
+static int opt_summary = 0;
+static int opt_cpu = -1;
+static Bit64u opt_count = 0;
+static int opt_nomem = 0;
+
+static trace_stats_t stats[BX_TRACE_MAX_CPUS];
+static Bit64u total_insns = 0;
+
+void fatal(const char *msg)
+{
+  fprintf(stderr, "bxtrace: %s\n", msg);
+  exit(1);
+}
+
+// Decodes the events of one block. Returns 0 if the instruction limit has
+// been reached.
+static int decode_block(const bx_trace_header_t *hdr, const bx_trace_block_t *blk,
+                        const Bit8u *data)
+{
+  const Bit8u *p = data, *end = data + blk->raw_size;
+  trace_stats_t *st = &stats[blk->cpu];
+  Bit64u icount = blk->icount, next_rip = 0, insn_rip = blk->rip, lin = 0, val, val2, val3;
+  Bit64s delta, offset = 0;
+  int print = !opt_summary && ((opt_cpu < 0) || (opt_cpu == blk->cpu));
+  unsigned tag, len, n;
+
+  while (p < end) {
+    tag = *p++;
+    if (tag < BX_TRACE_EV_BRANCH) {
+      // instruction
+      len = tag & 0x0f;
+      if (tag & BX_TRACE_EV_INSN_JUMP) {
+        if ((p = bx_trace_get_svarint(p, end, &delta)) == NULL) return -1;
+        next_rip += delta;
+        st->jumps++;
+      }
+      insn_rip = next_rip;
+      next_rip = insn_rip + len;
+      icount++;
+      st->insns++;
+      if (print) {
+        printf("CPU%u %12" FMT_64 "u  " FMT_ADDRX64 "  len=%u", blk->cpu, icount, insn_rip, len);
+      }
+      if (hdr->flags & BX_TRACE_F_OPCODES) {
+        if ((unsigned)(end - p) < len) return -1;
+        if (print) {
+          printf("  ");
+          for (n = 0; n < len; n++) printf("%02x", p[n]);
+        }
+        p += len;
+      }
+      if (print) printf("\n");
+      if (opt_count && (++total_insns >= opt_count)) return 0;
+    } else if (tag < BX_TRACE_EV_FAR_BRANCH) {
+      // near branch
+      n = tag & 0x0f;
+      st->branches[n]++;
+      if (n != BX_TRACE_BR_NOT_TAKEN) {
+        if ((p = bx_trace_get_svarint(p, end, &delta)) == NULL) return -1;
+        next_rip = insn_rip + delta;
+        if (print) printf("       branch %s -> " FMT_ADDRX64 "\n", branch_name[n], next_rip);
+      } else {
+        if (print) printf("       branch %s\n", branch_name[n]);
+      }
+    } else if (tag < BX_TRACE_EV_MEM) {
+      // far branch
+      n = tag & 0x0f;
+      st->far_branches++;
+      if ((p = bx_trace_get_varint(p, end, &val)) == NULL) return -1;
+      if ((p = bx_trace_get_varint(p, end, &next_rip)) == NULL) return -1;
+      if (print) printf("       far %s -> %04x:" FMT_ADDRX64 "\n", branch_name[n], (unsigned)val, next_rip);
+    } else if (tag < BX_TRACE_EV_EXCEPTION) {
+      // memory access
+      unsigned rw = (tag >> 3) & 7;
+      len = 1 << (tag & 7);
+      if ((tag & 7) == 7) {
+        if ((p = bx_trace_get_varint(p, end, &val)) == NULL) return -1;
+        len = (unsigned)val;
+      }
+      if ((p = bx_trace_get_svarint(p, end, &delta)) == NULL) return -1;
+      lin += delta;
+      if ((p = bx_trace_get_svarint(p, end, &delta)) == NULL) return -1;
+      offset += delta;
+      st->mem[rw]++;
+      if (print && !opt_nomem) {
+        printf("       mem %-6s %2u  lin=" FMT_ADDRX64 " phy=" FMT_ADDRX64 "\n",
+               access_name[rw], len, lin, lin + offset);
+      }
+    } else {
+      switch (tag) {
+        case BX_TRACE_EV_EXCEPTION:
+          if ((p = bx_trace_get_varint(p, end, &val)) == NULL) return -1;
+          if ((p = bx_trace_get_varint(p, end, &val2)) == NULL) return -1;
+          st->exceptions++;
+          if (print) printf("       exception %02x error_code=%x\n", (unsigned)val, (unsigned)val2);
+          break;
+        case BX_TRACE_EV_INTERRUPT:
+          if ((p = bx_trace_get_varint(p, end, &val)) == NULL) return -1;
+          st->interrupts++;
+          if (print) printf("       interrupt %02x\n", (unsigned)val);
+          break;
+        case BX_TRACE_EV_HWINT:
+          if ((p = bx_trace_get_varint(p, end, &val)) == NULL) return -1;
+          if ((p = bx_trace_get_varint(p, end, &val2)) == NULL) return -1;
+          if ((p = bx_trace_get_varint(p, end, &val3)) == NULL) return -1;
+          st->hw_interrupts++;
+          if (print) printf("       hardware interrupt %02x (%04x:" FMT_ADDRX64 ")\n",
+                            (unsigned)val, (unsigned)val2, val3);
+          break;
+        case BX_TRACE_EV_RESET:
+          if ((p = bx_trace_get_varint(p, end, &val)) == NULL) return -1;
+          st->resets++;
+          if (print) printf("       reset (type %u)\n", (unsigned)val);
+          break;
+        default:
+          return -1;
+      }
+    }
+  }
+  return 1;
+}
+
+static void print_summary(const bx_trace_header_t *hdr, Bit64u nblocks,
+                          Bit64u raw_bytes, Bit64u file_bytes)
+{
+  Bit64u insns = 0;
+  unsigned cpu, n;
+
+  printf("trace version %u, %u CPU(s), flags:%s%s\n", hdr->version, hdr->ncpus,
+         (hdr->flags & BX_TRACE_F_MEMORY) ? " memory" : "",
+         (hdr->flags & BX_TRACE_F_OPCODES) ? " opcodes" : "");
+  for (cpu = 0; (cpu < hdr->ncpus) && (cpu < BX_TRACE_MAX_CPUS); cpu++) {
+    trace_stats_t *st = &stats[cpu];
+    insns += st->insns;
+    printf("\nCPU%u\n", cpu);
+    printf("  instructions:        %" FMT_64 "u (%" FMT_64 "u not sequential)\n", st->insns, st->jumps);
+    for (n = 0; n < 16; n++) {
+      if (st->branches[n] > 0)
+        printf("  branch %-13s %" FMT_64 "u\n", branch_name[n], st->branches[n]);
+    }
+    printf("  far branches:        %" FMT_64 "u\n", st->far_branches);
+    for (n = 0; n < 8; n++) {
+      if (st->mem[n] > 0)
+        printf("  memory %-13s %" FMT_64 "u\n", access_name[n], st->mem[n]);
+    }
+    printf("  exceptions:          %" FMT_64 "u\n", st->exceptions);
+    printf("  interrupts:          %" FMT_64 "u\n", st->interrupts);
+    printf("  hardware interrupts: %" FMT_64 "u\n", st->hw_interrupts);
+    printf("  resets:              %" FMT_64 "u\n", st->resets);
+  }
+  printf("\n%" FMT_64 "u blocks, %" FMT_64 "u bytes of events, %" FMT_64 "u bytes in file", nblocks, raw_bytes, file_bytes);
+  if (insns > 0) {
+    printf(", %.2f bytes per instruction", (double)file_bytes / (double)insns);
+  }
+  printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+  Bit8u header[BX_TRACE_HEADER_SIZE], blkhdr[BX_TRACE_BLOCK_HDR_SIZE];
+  bx_trace_header_t hdr;
+  bx_trace_block_t blk;
+  Bit8u *stored, *raw;
+  Bit64u nblocks = 0, raw_bytes = 0, file_bytes = BX_TRACE_HEADER_SIZE;
+  const char *filename = NULL;
+  int arg, ret = 1;
+  FILE *fp;
+
+  for (arg = 1; arg < argc; arg++) {
+    if (!strcmp(argv[arg], "-s")) {
+      opt_summary = 1;
+    } else if (!strcmp(argv[arg], "-c") && ((arg + 1) < argc)) {
+      opt_cpu = atoi(argv[++arg]);
+    } else if (!strcmp(argv[arg], "-n") && ((arg + 1) < argc)) {
+      opt_count = strtoull(argv[++arg], NULL, 0);
+    } else if (!strcmp(argv[arg], "-nomem")) {
+      opt_nomem = 1;
+    } else if (argv[arg][0] == '-') {
+      printf("%s", usage_msg);
+      return (strcmp(argv[arg], "-h") != 0);
+    } else {
+      filename = argv[arg];
+    }
+  }
+  if (filename == NULL) {
+    printf("%s", usage_msg);
+    return 1;
+  }
+  if ((fp = fopen(filename, "rb")) == NULL) {
+    fatal("cannot open trace file");
+  }
+  if ((fread(header, sizeof(header), 1, fp) != 1) || !bx_trace_read_header(header, &hdr)) {
+    fatal("not a supported trace file");
+  }
+  if ((hdr.block_size == 0) || (hdr.block_size > (64 << 20))) {
+    fatal("invalid block size");
+  }
+  stored = new Bit8u[hdr.block_size];
+  raw = new Bit8u[hdr.block_size];
+  memset(stats, 0, sizeof(stats));
+
+  while (fread(blkhdr, sizeof(blkhdr), 1, fp) == 1) {
+    if (!bx_trace_read_block_header(blkhdr, &blk) || (blk.cpu >= BX_TRACE_MAX_CPUS) ||
+        (blk.raw_size > hdr.block_size) || (blk.stored_size > hdr.block_size)) {
+      fatal("corrupted block header");
+    }
+    if (fread(stored, blk.stored_size, 1, fp) != 1) {
+      fprintf(stderr, "bxtrace: trace file is truncated\n");
+      break;
+    }
+    if (blk.flags & BX_TRACE_BLOCK_COMPRESSED) {
+      if (bx_trace_decompress(stored, blk.stored_size, raw, hdr.block_size) != blk.raw_size) {
+        fatal("corrupted block data");
+      }
+    } else {
+      memcpy(raw, stored, blk.raw_size);
+    }
+    nblocks++;
+    raw_bytes += blk.raw_size;
+    file_bytes += BX_TRACE_BLOCK_HDR_SIZE + blk.stored_size;
+    ret = decode_block(&hdr, &blk, raw);
+    if (ret < 0) {
+      fatal("corrupted event data");
+    } else if (ret == 0) {
+      break;
+    }
+  }
+  fclose(fp);
+  if (opt_summary) {
+    print_summary(&hdr, nblocks, raw_bytes, file_bytes);
+  }
+  delete [] stored;
+  delete [] raw;
+  return 0;
+}
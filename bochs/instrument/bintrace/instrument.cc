@@ -0,0 +1,492 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+
+// Binary execution trace recorder
+//
+// The CPU callbacks append delta encoded events to a per-CPU buffer. A full
+// buffer is handed over to a writer thread that compresses it and appends
+// it to the trace file as one block, while the CPU continues with a free
+// buffer. Only the buffer handover takes a lock.
+//
+// bochsrc option:
+//   bintrace: enabled=1, file=bxtrace.bin, memory=1, opcodes=0
+
+#include <assert.h>
+
+#include "bochs.h"
+#include "cpu/cpu.h"
+#include "gui/siminterface.h"
+#include "bxthread.h"
+#include "bintrace.h"
+
+// maximum number of block buffers in use at the same time
+#define TRACE_MAX_BUFFERS 32
+
+// address deltas are computed modulo 2^64, so the reader can apply them
+// with 64-bit arithmetic no matter how wide bx_address is
+#define TRACE_DELTA(a, b) ((Bit64s)((Bit64u)(a) - (Bit64u)(b)))
+
+typedef struct trace_buffer {
+  Bit8u *data;
+  Bit32u size;
+  unsigned cpu;
+  Bit64u icount;
+  bx_address rip;
+  struct trace_buffer *next;
+} trace_buffer_t;
+
+static struct trace_cpu_t {
+  trace_buffer_t *buf;
+  Bit8u *ptr;
+  Bit8u *limit;
+  Bit64u icount;        // instructions executed by this CPU
+  bx_address insn_rip;  // linear address of the current instruction
+  bx_address next_rip;  // expected address of the next instruction
+  bx_address last_lin;
+  Bit64s last_offset;
+} *trace_cpu = NULL;
+
+// options
+static bool trace_enabled = 1;
+static bool trace_memory = 1;
+static bool trace_opcodes = 0;
+static char trace_filename[BX_PATHNAME_LEN] = "bxtrace.bin";
+
+static bool trace_active = 0;
+static FILE *trace_file = NULL;
+static Bit64u trace_raw_bytes, trace_stored_bytes;
+
+static BX_MUTEX(trace_mutex);
+static trace_buffer_t *trace_queue_head = NULL, *trace_queue_tail = NULL;
+static trace_buffer_t *trace_free_list = NULL;
+static unsigned trace_num_buffers = 0;
+static bool trace_writer_running = 0;
+static volatile bool trace_writer_active = 0;
+static BX_THREAD_VAR(trace_writer_var);
+
+static logfunctions *instrument_log = new logfunctions ();
+#define LOG_THIS instrument_log->
+
+// writer thread
+
+static void trace_write_block(trace_buffer_t *buf)
+{
+  static Bit8u zbuf[BX_TRACE_BLOCK_SIZE];
+  Bit8u header[BX_TRACE_BLOCK_HDR_SIZE];
+  bx_trace_block_t blk;
+  const Bit8u *data = buf->data;
+
+  blk.cpu = buf->cpu;
+  blk.flags = 0;
+  blk.raw_size = buf->size;
+  blk.stored_size = bx_trace_compress(buf->data, buf->size, zbuf, buf->size);
+  blk.icount = buf->icount;
+  blk.rip = buf->rip;
+  if ((blk.stored_size > 0) && (blk.stored_size < buf->size)) {
+    blk.flags |= BX_TRACE_BLOCK_COMPRESSED;
+    data = zbuf;
+  } else {
+    blk.stored_size = buf->size;
+  }
+  bx_trace_write_block_header(header, &blk);
+  if ((fwrite(header, sizeof(header), 1, trace_file) != 1) ||
+      (fwrite(data, blk.stored_size, 1, trace_file) != 1)) {
+    BX_ERROR(("error writing trace file '%s'", trace_filename));
+  }
+  trace_raw_bytes += blk.raw_size;
+  trace_stored_bytes += blk.stored_size + sizeof(header);
+}
+
+BX_THREAD_FUNC(trace_writer_thread, indata)
+{
+  trace_buffer_t *buf;
+  bool running;
+
+  while (1) {
+    BX_LOCK(trace_mutex);
+    buf = trace_queue_head;
+    if (buf != NULL) {
+      trace_queue_head = buf->next;
+      if (trace_queue_head == NULL) trace_queue_tail = NULL;
+    }
+    running = trace_writer_running;
+    BX_UNLOCK(trace_mutex);
+    if (buf == NULL) {
+      if (!running) break;
+      BX_MSLEEP(2);
+      continue;
+    }
+    trace_write_block(buf);
+    BX_LOCK(trace_mutex);
+    buf->next = trace_free_list;
+    trace_free_list = buf;
+    BX_UNLOCK(trace_mutex);
+  }
+  trace_writer_active = 0;
+  BX_THREAD_EXIT;
+}
+
+// buffer management
+
+static trace_buffer_t *trace_get_buffer(void)
+{
+  trace_buffer_t *buf;
+
+  while (1) {
+    BX_LOCK(trace_mutex);
+    buf = trace_free_list;
+    if (buf != NULL) {
+      trace_free_list = buf->next;
+    } else if (trace_num_buffers < TRACE_MAX_BUFFERS) {
+      buf = new trace_buffer_t;
+      buf->data = new Bit8u[BX_TRACE_BLOCK_SIZE];
+      trace_num_buffers++;
+    }
+    BX_UNLOCK(trace_mutex);
+    if (buf != NULL) break;
+    // all buffers are waiting for the writer thread
+    BX_MSLEEP(1);
+  }
+  return buf;
+}
+
+static void trace_start_block(unsigned cpu)
+{
+  trace_cpu_t *t = &trace_cpu[cpu];
+
+  t->buf = trace_get_buffer();
+  t->buf->cpu = cpu;
+  t->buf->icount = t->icount;
+  t->buf->rip = t->insn_rip;
+  t->ptr = t->buf->data;
+  t->limit = t->buf->data + BX_TRACE_BLOCK_SIZE - BX_TRACE_MAX_EVENT;
+  // every block starts with a fresh delta state
+  t->next_rip = 0;
+  t->last_lin = 0;
+  t->last_offset = 0;
+}
+
+static void trace_submit_block(unsigned cpu)
+{
+  trace_cpu_t *t = &trace_cpu[cpu];
+  trace_buffer_t *buf = t->buf;
+
+  if (buf == NULL) return;
+  t->buf = NULL;
+  buf->size = (Bit32u)(t->ptr - buf->data);
+  if (buf->size == 0) {
+    BX_LOCK(trace_mutex);
+    buf->next = trace_free_list;
+    trace_free_list = buf;
+    BX_UNLOCK(trace_mutex);
+    return;
+  }
+  buf->next = NULL;
+  BX_LOCK(trace_mutex);
+  if (trace_queue_tail != NULL) {
+    trace_queue_tail->next = buf;
+  } else {
+    trace_queue_head = buf;
+  }
+  trace_queue_tail = buf;
+  BX_UNLOCK(trace_mutex);
+}
+
+// returns the write pointer for the next event of this CPU
+BX_CPP_INLINE Bit8u *trace_event_ptr(unsigned cpu)
+{
+  trace_cpu_t *t = &trace_cpu[cpu];
+
+  if ((t->buf == NULL) || (t->ptr > t->limit)) {
+    trace_submit_block(cpu);
+    trace_start_block(cpu);
+  }
+  return t->ptr;
+}
+
+// trace file handling
+
+static void trace_close(void)
+{
+  if (trace_file == NULL) return;
+
+  trace_active = 0;
+  for (unsigned cpu = 0; cpu < BX_SMP_PROCESSORS; cpu++) {
+    trace_submit_block(cpu);
+  }
+  BX_LOCK(trace_mutex);
+  trace_writer_running = 0;
+  BX_UNLOCK(trace_mutex);
+  while (trace_writer_active) {
+    BX_MSLEEP(1);
+  }
+  fclose(trace_file);
+  trace_file = NULL;
+
+  Bit64u icount = 0;
+  for (unsigned cpu = 0; cpu < BX_SMP_PROCESSORS; cpu++) {
+    icount += trace_cpu[cpu].icount;
+  }
+  BX_INFO(("trace file '%s' closed: " FMT_LL "u instructions, " FMT_LL "u bytes (" FMT_LL "u uncompressed)",
+           trace_filename, icount, trace_stored_bytes, trace_raw_bytes));
+
+  while (trace_free_list != NULL) {
+    trace_buffer_t *buf = trace_free_list;
+    trace_free_list = buf->next;
+    delete [] buf->data;
+    delete buf;
+  }
+  trace_num_buffers = 0;
+}
+
+static void trace_open(void)
+{
+  Bit8u header[BX_TRACE_HEADER_SIZE];
+  bx_trace_header_t hdr;
+
+  trace_file = fopen(trace_filename, "wb");
+  if (trace_file == NULL) {
+    BX_ERROR(("could not open trace file '%s'", trace_filename));
+    return;
+  }
+  hdr.version = BX_TRACE_VERSION;
+  hdr.flags = 0;
+  if (trace_opcodes) hdr.flags |= BX_TRACE_F_OPCODES;
+  if (trace_memory) hdr.flags |= BX_TRACE_F_MEMORY;
+  hdr.ncpus = BX_SMP_PROCESSORS;
+  hdr.block_size = BX_TRACE_BLOCK_SIZE;
+  bx_trace_write_header(header, &hdr);
+  fwrite(header, sizeof(header), 1, trace_file);
+  trace_raw_bytes = 0;
+  trace_stored_bytes = sizeof(header);
+
+  trace_writer_running = 1;
+  trace_writer_active = 1;
+  BX_THREAD_CREATE(trace_writer_thread, NULL, trace_writer_var);
+  // also finish the trace if Bochs exits from a fatal error
+  atexit(trace_close);
+  BX_INFO(("writing binary execution trace to '%s'", trace_filename));
+}
+
+// bochsrc option handling
+
+static Bit32s bintrace_options_parser(const char *context, int num_params, char *params[])
+{
+  for (int i = 1; i < num_params; i++) {
+    if (!strncmp(params[i], "enabled=", 8)) {
+      trace_enabled = atol(&params[i][8]) != 0;
+    } else if (!strncmp(params[i], "file=", 5)) {
+      strncpy(trace_filename, &params[i][5], BX_PATHNAME_LEN - 1);
+      trace_filename[BX_PATHNAME_LEN - 1] = 0;
+    } else if (!strncmp(params[i], "memory=", 7)) {
+      trace_memory = atol(&params[i][7]) != 0;
+    } else if (!strncmp(params[i], "opcodes=", 8)) {
+      trace_opcodes = atol(&params[i][8]) != 0;
+    } else {
+      BX_ERROR(("%s: unknown parameter for bintrace ignored.", context));
+    }
+  }
+  return 0;
+}
+
+static Bit32s bintrace_options_save(FILE *fp)
+{
+  fprintf(fp, "bintrace: enabled=%d, file=%s, memory=%d, opcodes=%d\n",
+          trace_enabled, trace_filename, trace_memory, trace_opcodes);
+  return 0;
+}
+
+void bx_instr_init_env(void)
+{
+  instrument_log->put("bintrace", "TRACE");
+  BX_INIT_MUTEX(trace_mutex);
+  SIM->register_addon_option("bintrace", bintrace_options_parser, bintrace_options_save);
+}
+
+void bx_instr_exit_env(void)
+{
+  trace_close();
+  SIM->unregister_addon_option("bintrace");
+}
+
+void bx_instr_initialize(unsigned cpu)
+{
+  assert(cpu < BX_SMP_PROCESSORS);
+
+  if (trace_cpu == NULL) {
+    trace_cpu = new trace_cpu_t[BX_SMP_PROCESSORS];
+    memset(trace_cpu, 0, sizeof(trace_cpu_t) * BX_SMP_PROCESSORS);
+    if (trace_enabled) trace_open();
+  }
+  if (trace_file != NULL) {
+    trace_start_block(cpu);
+    trace_active = 1;
+  }
+}
+
+void bx_instr_exit(unsigned cpu)
+{
+  if (trace_active) trace_submit_block(cpu);
+}
+
+void bx_instr_reset(unsigned cpu, unsigned type)
+{
+  if (!trace_active) return;
+
+  Bit8u *p = trace_event_ptr(cpu);
+  *p++ = BX_TRACE_EV_RESET;
+  trace_cpu[cpu].ptr = bx_trace_put_varint(p, type);
+}
+
+// instruction and branch events
+
+void bx_instr_before_execution(unsigned cpu, bxInstruction_c *i)
+{
+  if (!trace_active) return;
+
+  trace_cpu_t *t = &trace_cpu[cpu];
+  Bit8u *p = trace_event_ptr(cpu);
+  bx_address rip = BX_CPU(cpu)->get_laddr(BX_SEG_REG_CS, BX_CPU(cpu)->get_instruction_pointer());
+  unsigned len = i->ilen();
+
+  if (rip == t->next_rip) {
+    *p++ = BX_TRACE_EV_INSN | len;
+  } else {
+    *p++ = BX_TRACE_EV_INSN_JUMP | len;
+    p = bx_trace_put_svarint(p, TRACE_DELTA(rip, t->next_rip));
+  }
+  if (trace_opcodes) {
+    memcpy(p, i->get_opcode_bytes(), len);
+    p += len;
+  }
+  t->ptr = p;
+  t->insn_rip = rip;
+  t->next_rip = rip + len;
+  t->icount++;
+}
+
+static void trace_near_branch(unsigned cpu, unsigned kind, bx_address new_eip)
+{
+  if (!trace_active) return;
+
+  trace_cpu_t *t = &trace_cpu[cpu];
+  Bit8u *p = trace_event_ptr(cpu);
+  bx_address target = BX_CPU(cpu)->get_laddr(BX_SEG_REG_CS, new_eip);
+
+  *p++ = BX_TRACE_EV_BRANCH | kind;
+  t->ptr = bx_trace_put_svarint(p, TRACE_DELTA(target, t->insn_rip));
+  t->next_rip = target;
+}
+
+void bx_instr_cnear_branch_taken(unsigned cpu, bx_address branch_eip, bx_address new_eip)
+{
+  trace_near_branch(cpu, BX_TRACE_BR_TAKEN, new_eip);
+}
+
+void bx_instr_cnear_branch_not_taken(unsigned cpu, bx_address branch_eip)
+{
+  if (!trace_active) return;
+
+  Bit8u *p = trace_event_ptr(cpu);
+  *p++ = BX_TRACE_EV_BRANCH | BX_TRACE_BR_NOT_TAKEN;
+  trace_cpu[cpu].ptr = p;
+}
+
+void bx_instr_ucnear_branch(unsigned cpu, unsigned what, bx_address branch_eip, bx_address new_eip)
+{
+  trace_near_branch(cpu, what - BX_TRACE_BR_TYPE_OFFSET, new_eip);
+}
+
+void bx_instr_far_branch(unsigned cpu, unsigned what, Bit16u prev_cs, bx_address prev_eip, Bit16u new_cs, bx_address new_eip)
+{
+  if (!trace_active) return;
+
+  trace_cpu_t *t = &trace_cpu[cpu];
+  Bit8u *p = trace_event_ptr(cpu);
+  bx_address target = BX_CPU(cpu)->get_laddr(BX_SEG_REG_CS, new_eip);
+
+  *p++ = BX_TRACE_EV_FAR_BRANCH | (what - BX_TRACE_BR_TYPE_OFFSET);
+  p = bx_trace_put_varint(p, new_cs);
+  t->ptr = bx_trace_put_varint(p, target);
+  t->next_rip = target;
+}
+
+// interrupts and exceptions
+
+void bx_instr_interrupt(unsigned cpu, unsigned vector)
+{
+  if (!trace_active) return;
+
+  Bit8u *p = trace_event_ptr(cpu);
+  *p++ = BX_TRACE_EV_INTERRUPT;
+  trace_cpu[cpu].ptr = bx_trace_put_varint(p, vector);
+}
+
+void bx_instr_exception(unsigned cpu, unsigned vector, unsigned error_code)
+{
+  if (!trace_active) return;
+
+  Bit8u *p = trace_event_ptr(cpu);
+  *p++ = BX_TRACE_EV_EXCEPTION;
+  p = bx_trace_put_varint(p, vector);
+  trace_cpu[cpu].ptr = bx_trace_put_varint(p, error_code);
+}
+
+void bx_instr_hwinterrupt(unsigned cpu, unsigned vector, Bit16u cs, bx_address eip)
+{
+  if (!trace_active) return;
+
+  Bit8u *p = trace_event_ptr(cpu);
+  *p++ = BX_TRACE_EV_HWINT;
+  p = bx_trace_put_varint(p, vector);
+  p = bx_trace_put_varint(p, cs);
+  trace_cpu[cpu].ptr = bx_trace_put_varint(p, eip);
+}
+
+// memory accesses
+
+void bx_instr_lin_access(unsigned cpu, bx_address lin, bx_phy_address phy, unsigned len, unsigned memtype, unsigned rw)
+{
+  if (!trace_active || !trace_memory) return;
+
+  trace_cpu_t *t = &trace_cpu[cpu];
+  Bit8u *p = trace_event_ptr(cpu);
+  Bit64s offset = TRACE_DELTA(phy, lin);
+  unsigned size_code;
+
+  switch (len) {
+    case 1:  size_code = 0; break;
+    case 2:  size_code = 1; break;
+    case 4:  size_code = 2; break;
+    case 8:  size_code = 3; break;
+    case 16: size_code = 4; break;
+    case 32: size_code = 5; break;
+    case 64: size_code = 6; break;
+    default: size_code = 7;
+  }
+  *p++ = BX_TRACE_EV_MEM | ((rw & 7) << 3) | size_code;
+  if (size_code == 7) {
+    p = bx_trace_put_varint(p, len);
+  }
+  p = bx_trace_put_svarint(p, TRACE_DELTA(lin, t->last_lin));
+  t->ptr = bx_trace_put_svarint(p, TRACE_DELTA(offset, t->last_offset));
+  t->last_lin = lin;
+  t->last_offset = offset;
+}
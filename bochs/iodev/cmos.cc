@@ -27,6 +27,7 @@
 #include "iodev.h"
 #include "cmos.h"
 #include "virt_timer.h"
+#include "replay.h"
 
 #define LOG_THIS theCmosDevice->
 
@@ -173,13 +174,13 @@ void bx_cmos_c::init(void)
 
   if (SIM->get_param_num(BXPN_CLOCK_TIME0)->get() == BX_CLOCK_TIME0_LOCAL) {
     BX_INFO(("Using local time for initial clock"));
-    BX_CMOS_THIS s.timeval = time(NULL);
+    BX_CMOS_THIS s.timeval = (time_t)bx_replay.host_value(BX_REPLAY_VAL_TIME0, time(NULL));
   } else if (SIM->get_param_num(BXPN_CLOCK_TIME0)->get() == BX_CLOCK_TIME0_UTC) {
     bool utc_ok = 0;
 
     BX_INFO(("Using utc time for initial clock"));
 
-    BX_CMOS_THIS s.timeval = time(NULL);
+    BX_CMOS_THIS s.timeval = (time_t)bx_replay.host_value(BX_REPLAY_VAL_TIME0, time(NULL));
 
 #if BX_HAVE_GMTIME
 #if BX_HAVE_MKTIME
@@ -25,6 +25,7 @@
 
 #include "iodev.h"
 #include "gui/keymap.h"
+#include "replay.h"
 
 #include "iodev/virt_timer.h"
 #include "iodev/slowdown_timer.h"
@@ -1198,13 +1199,23 @@ void bx_devices_c::unregister_removable_mouse(void *dev)
 // common keyboard device handlers
 void bx_devices_c::gen_scancode(Bit32u key)
 {
-  bool ret = 0;
+  // live input is ignored while replaying a journal
+  if (bx_replay.replaying())
+    return;
 
   bx_keyboard[0].bxkey_state[key & 0xff] = ((key & BX_KEY_RELEASED) == 0);
   if ((paste.buf != NULL) && (!paste.service)) {
     paste.stop = 1;
     return;
   }
+  bx_replay.key_event(key);
+  send_scancode(key);
+}
+
+void bx_devices_c::send_scancode(Bit32u key)
+{
+  bool ret = 0;
+
   if (bx_keyboard[1].dev != NULL) {
     ret = bx_keyboard[1].gen_scancode(bx_keyboard[1].dev, key);
   }
@@ -1346,9 +1357,15 @@ void bx_devices_c::mouse_motion(int delta_x, int delta_y, int delta_z, unsigned
 {
   // If mouse events are disabled on the GUI headerbar, don't
   // generate any mouse data
-  if (!mouse_captured)
+  if (!mouse_captured || bx_replay.replaying())
     return;
 
+  bx_replay.mouse_event(delta_x, delta_y, delta_z, button_state, absxy);
+  send_mouse_event(delta_x, delta_y, delta_z, button_state, absxy);
+}
+
+void bx_devices_c::send_mouse_event(int delta_x, int delta_y, int delta_z, unsigned button_state, bool absxy)
+{
   // if a removable mouse is connected, redirect mouse data to the device
   if (bx_mouse[1].dev != NULL) {
     bx_mouse[1].enq_event(bx_mouse[1].dev, delta_x, delta_y, delta_z, button_state, absxy);
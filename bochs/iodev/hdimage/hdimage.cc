@@ -643,7 +643,14 @@ Bit32u device_image_t::get_timestamp()
   return (fat_datetime(mtime, 1) | (fat_datetime(mtime, 0) << 16));
 }
 
-#ifndef BXIMAGE
+#ifdef BXIMAGE
+bool device_image_t::is_allocated(Bit64u offset, Bit64u *len)
+{
+  // without format specific information all of the data has to be copied
+  *len = hd_size - offset;
+  return 1;
+}
+#else
 void device_image_t::register_state(bx_list_c *parent)
 {
   bx_param_bool_c *image = new bx_param_bool_c(parent, "image", NULL, NULL, 0);
@@ -702,7 +709,33 @@ int flat_image_t::check_format(int fd, Bit64u imgsize)
   }
 }
 
-#ifndef BXIMAGE
+#ifdef BXIMAGE
+bool flat_image_t::is_allocated(Bit64u offset, Bit64u *len)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+  off_t data, hole;
+
+  data = ::lseek(fd, (off_t)offset, SEEK_DATA);
+  if (data < 0) {
+    if (errno == ENXIO) {
+      // hole up to the end of file
+      *len = hd_size - offset;
+      return 0;
+    }
+  } else if ((Bit64u)data > offset) {
+    *len = (Bit64u)data - offset;
+    return 0;
+  } else {
+    hole = ::lseek(fd, (off_t)offset, SEEK_HOLE);
+    if ((hole > 0) && ((Bit64u)hole > offset)) {
+      *len = (Bit64u)hole - offset;
+      return 1;
+    }
+  }
+#endif
+  return device_image_t::is_allocated(offset, len);
+}
+#else
 bool flat_image_t::save_state(const char *backup_fname)
 {
   return hdimage_backup_file(fd, backup_fname);
@@ -2103,62 +2136,77 @@ int redolog_t::check_format(int fd, const char *subtype)
 }
 
 #ifdef BXIMAGE
+bool redolog_t::is_allocated(Bit64u offset, Bit64u *len)
+{
+  Bit32u extent_size = dtoh32(header.specific.extent);
+  Bit32u catalog_size = dtoh32(header.specific.catalog);
+  Bit32u i = (Bit32u)(offset / extent_size);
+  Bit64u end;
+  bool allocated;
+
+  allocated = (dtoh32(catalog[i]) != REDOLOG_PAGE_NOT_ALLOCATED);
+  while ((++i < catalog_size) &&
+         ((dtoh32(catalog[i]) != REDOLOG_PAGE_NOT_ALLOCATED) == allocated));
+  end = (Bit64u)i * extent_size;
+  if (end > dtoh64(header.specific.disk)) {
+    end = dtoh64(header.specific.disk);
+  }
+  *len = end - offset;
+  return allocated;
+}
+
 int redolog_t::commit(device_image_t *base_image)
 {
-  int ret = 0;
-  Bit32u i;
-  Bit8u buffer[512];
+  int ret = 0, percent = -1;
+  Bit32u i, j, run, catalog_size, bitmap_size, extent_size, extent_len;
+  Bit64s bitmap_offset, base_offset;
+  Bit8u *buffer;
 
-  printf("\nCommitting changes to base image file: [  0%%]");
+  catalog_size = dtoh32(header.specific.catalog);
+  bitmap_size = dtoh32(header.specific.bitmap);
+  extent_size = dtoh32(header.specific.extent);
+  extent_len = extent_blocks * 512;
+  buffer = new Bit8u[extent_len];
 
-  for (i = 0; i < dtoh32(header.specific.catalog); i++) {
-    printf("\x8\x8\x8\x8\x8%3d%%]", (i+1)*100/dtoh32(header.specific.catalog));
-    fflush(stdout);
+  printf("\nCommitting changes to base image file: [  0%%]");
 
-    if (dtoh32(catalog[i]) != REDOLOG_PAGE_NOT_ALLOCATED) {
-      Bit64s bitmap_offset;
-      Bit32u bitmap_size, j;
+  for (i = 0; (i < catalog_size) && (ret == 0); i++) {
+    if ((int)((i+1)*100/catalog_size) != percent) {
+      percent = (int)((i+1)*100/catalog_size);
+      printf("\x8\x8\x8\x8\x8%3d%%]", percent);
+      fflush(stdout);
+    }
+    if (dtoh32(catalog[i]) == REDOLOG_PAGE_NOT_ALLOCATED) {
+      continue;
+    }
 
-      bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
-      bitmap_offset += (Bit64s)512 * dtoh32(catalog[i]) * (extent_blocks + bitmap_blocks);
+    bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (catalog_size * sizeof(Bit32u));
+    bitmap_offset += (Bit64s)512 * dtoh32(catalog[i]) * (extent_blocks + bitmap_blocks);
 
-      // Read bitmap
-      bitmap_size = dtoh32(header.specific.bitmap);
-      if ((Bit32u)bx_read_image(fd, (off_t)bitmap_offset, bitmap, bitmap_size) != bitmap_size) {
+    // Read bitmap and extent data, then write back runs of used blocks
+    if (((Bit32u)bx_read_image(fd, (off_t)bitmap_offset, bitmap, bitmap_size) != bitmap_size) ||
+        ((Bit32u)bx_read_image(fd, (off_t)(bitmap_offset + 512 * bitmap_blocks), buffer, extent_len) != extent_len)) {
+      ret = -1;
+      break;
+    }
+    for (j = 0; j < (bitmap_size * 8); j += run) {
+      run = 1;
+      if ((bitmap[j/8] & (1 << (j%8))) == 0) {
+        continue;
+      }
+      while (((j + run) < (bitmap_size * 8)) &&
+             ((bitmap[(j+run)/8] & (1 << ((j+run)%8))) != 0)) {
+        run++;
+      }
+      base_offset = (Bit64s)i * extent_size + (Bit64s)512 * j;
+      if ((base_image->lseek(base_offset, SEEK_SET) < 0) ||
+          (base_image->write(buffer + 512 * j, 512 * run) < 0)) {
         ret = -1;
         break;
       }
-
-      for (j = 0; j < dtoh32(header.specific.bitmap); j++) {
-        Bit32u bit;
-
-        for (bit = 0; bit < 8; bit++) {
-          if ( (bitmap[j] & (1 << bit)) != 0) {
-            Bit64s base_offset, block_offset;
-
-            block_offset = bitmap_offset + ((Bit64s)512 * (bitmap_blocks + ((j * 8) + bit)));
-
-            if (bx_read_image(fd, (off_t)block_offset, buffer, 512) != 512) {
-              ret = -1;
-              break;
-            }
-
-            base_offset  = (Bit64s)i * (dtoh32(header.specific.extent));
-            base_offset += (Bit64s)512 * ((j * 8) + bit);
-
-            if (base_image->lseek(base_offset, SEEK_SET) < 0) {
-              ret = -1;
-              break;
-            }
-            if (base_image->write(buffer, 512) < 0) {
-              ret = -1;
-              break;
-            }
-          }
-        }
-      }
     }
   }
+  delete [] buffer;
   return ret;
 }
 #endif
@@ -2211,6 +2259,10 @@ ssize_t growing_image_t::read(void* buf, size_t count)
   while (n < count) {
     ret = redolog->read(cbuf, 512);
     if (ret < 0) break;
+    if (ret == 0) {
+      // block not allocated - the redolog doesn't advance in this case
+      redolog->lseek(512, SEEK_CUR);
+    }
     cbuf += 512;
     n += 512;
   }
@@ -2251,6 +2303,11 @@ int growing_image_t::create_image(const char *pathname, Bit64u size)
   redolog->close();
   return 0;
 }
+
+bool growing_image_t::is_allocated(Bit64u offset, Bit64u *len)
+{
+  return redolog->is_allocated(offset, len);
+}
 #else
 bool growing_image_t::save_state(const char *backup_fname)
 {
@@ -204,6 +204,10 @@ class BOCHSAPI_MSVCONLY device_image_t
 #ifdef BXIMAGE
       // Create new image file
       virtual int create_image(const char *pathname, Bit64u size) {return 0;}
+
+      // Check if the data at offset is allocated in the image. The length of
+      // the range with the same state is returned in len.
+      virtual bool is_allocated(Bit64u offset, Bit64u *len);
 #else
       // Save/restore support
       virtual void register_state(bx_list_c *parent);
@@ -249,7 +253,10 @@ class flat_image_t : public device_image_t
       // Check image format
       static int check_format(int fd, Bit64u imgsize);
 
-#ifndef BXIMAGE
+#ifdef BXIMAGE
+      // Check if the data at offset is allocated in the image file
+      bool is_allocated(Bit64u offset, Bit64u *len);
+#else
       // Save/restore support
       bool save_state(const char *backup_fname);
       void restore_state(const char *backup_fname);
@@ -453,6 +460,7 @@ class BOCHSAPI_MSVCONLY redolog_t
       static int check_format(int fd, const char *subtype);
 
 #ifdef BXIMAGE
+      bool is_allocated(Bit64u offset, Bit64u *len);
       int commit(device_image_t *base_image);
 #else
       bool save_state(const char *backup_fname);
@@ -511,6 +519,9 @@ class growing_image_t : public device_image_t
 #ifdef BXIMAGE
       // Create new image file
       int create_image(const char *pathname, Bit64u size);
+
+      // Check if the data at offset is allocated in the image file
+      bool is_allocated(Bit64u offset, Bit64u *len);
 #else
       // Save/restore support
       bool save_state(const char *backup_fname);
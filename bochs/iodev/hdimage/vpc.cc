@@ -267,10 +267,10 @@ ssize_t vpc_image_t::read(void* buf, size_t count)
     }
 
     if (offset == -1) {
-      memset(buf, 0, 512);
+      memset(cbuf, 0, (size_t)sectors * 512);
     } else {
       ret = bx_read_image(fd, offset, cbuf, (int)sectors * 512);
-      if (ret != 512) {
+      if (ret != (int)sectors * 512) {
         return -1;
       }
     }
@@ -410,6 +410,28 @@ int vpc_image_t::create_image(const char *pathname, Bit64u size)
   ::close(fd);
   return 0;
 }
+
+bool vpc_image_t::is_allocated(Bit64u offset, Bit64u *len)
+{
+  vhd_footer_t *footer = (vhd_footer_t*)footer_buf;
+  Bit32u i, entries;
+  Bit64u end;
+  bool allocated;
+
+  if (cpu_to_be32(footer->type) == VHD_FIXED) {
+    return device_image_t::is_allocated(offset, len);
+  }
+  i = (Bit32u)(offset / block_size);
+  entries = (Bit32u)max_table_entries;
+  allocated = (i < entries) && (pagetable[i] != 0xffffffff);
+  while ((++i < entries) && ((pagetable[i] != 0xffffffff) == allocated));
+  end = (Bit64u)i * block_size;
+  if ((i >= entries) || (end > hd_size)) {
+    end = hd_size;
+  }
+  *len = end - offset;
+  return allocated;
+}
 #else
 bool vpc_image_t::save_state(const char *backup_fname)
 {
@@ -167,6 +167,7 @@ class vpc_image_t : public device_image_t
 
 #ifdef BXIMAGE
     int create_image(const char *pathname, Bit64u size);
+    bool is_allocated(Bit64u offset, Bit64u *len);
 #else
     bool save_state(const char *backup_fname);
     void restore_state(const char *backup_fname);
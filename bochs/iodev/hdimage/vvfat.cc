@@ -661,6 +661,7 @@ int vvfat_image_t::read_directory(int mapping_index)
   mapping_t* parent_mapping = (mapping_t*)
       (parent_index >= 0 ? array_get(&this->mapping, parent_index) : NULL);
   int first_cluster_of_parent = parent_mapping ? (int)parent_mapping->begin : -1;
+  mapping_t* current_mapping;
   int count = 0;
 
 #ifndef WIN32
@@ -932,7 +933,9 @@ int vvfat_image_t::init_directories(const char* dirname)
   Bit64u volume_sector_count = 0, tmpsc;
 
   cluster_size   = sectors_per_cluster * 0x200;
-  cluster_buffer = new Bit8u[cluster_size];
+  readahead_max  = VVFAT_READAHEAD_MAX / cluster_size;
+  if (readahead_max < 1) readahead_max = 1;
+  cluster_buffer = new Bit8u[cluster_size * readahead_max];
 
   bootsector = (bootsector_t*)(first_sectors + offset_to_bootsector * 0x200);
 
@@ -1042,8 +1045,6 @@ int vvfat_image_t::init_directories(const char* dirname)
   fat_set(0, max_fat_value);
   fat_set(1, max_fat_value);
 
-  current_mapping = NULL;
-
   if (!use_boot_file) {
     bootsector->jump[0] = 0xeb;
     if (fat_type != 32) {
@@ -1347,14 +1348,23 @@ int vvfat_image_t::open(const char* dirname, int flags)
     }
   }
 
-  current_cluster = 0xffff;
-  current_fd = 0;
+  for (int i = 0; i < VVFAT_FD_CACHE_SIZE; i++) {
+    fd_cache[i].fd = -1;
+    fd_cache[i].mapping = NULL;
+  }
+  fd_cache_clock = 0;
+  cluster_map = NULL;
+  buffer_first = 0;
+  buffer_count = 0;
+  readahead = 1;
+  next_cluster = 0;
 
   if ((!use_mbr_file) && (offset_to_bootsector > 0))
     init_mbr();
 
   init_directories(dirname);
   set_file_attributes();
+  build_cluster_map();
 
   // VOLATILE WRITE SUPPORT
   snprintf(path, BX_PATHNAME_LEN, "%s/vvfat.dir", dirname);
@@ -1751,6 +1761,7 @@ void vvfat_image_t::close(void)
   char msg[BX_PATHNAME_LEN + 80];
   mapping_t *mapping;
 
+  close_files();
   if (vvfat_modified) {
     sprintf(msg, "Write back changes to directory '%s'?\n\nWARNING: This feature is still experimental!", vvfat_path);
     if (SIM->ask_yes_no("Bochs VVFAT modified", msg, 0)) {
@@ -1766,6 +1777,8 @@ void vvfat_image_t::close(void)
   array_free(&this->mapping);
   if (cluster_buffer != NULL)
     delete [] cluster_buffer;
+  if (cluster_map != NULL)
+    delete [] cluster_map;
 
   redolog->close();
 
@@ -1796,53 +1809,49 @@ Bit64s vvfat_image_t::lseek(Bit64s offset, int whence)
   return 0;
 }
 
-void vvfat_image_t::close_current_file(void)
+void vvfat_image_t::close_files(void)
 {
-  if(current_mapping) {
-    current_mapping = NULL;
-    if (current_fd) {
-      ::close(current_fd);
-      current_fd = 0;
+  for (int i = 0; i < VVFAT_FD_CACHE_SIZE; i++) {
+    if (fd_cache[i].fd >= 0) {
+      ::close(fd_cache[i].fd);
+      fd_cache[i].fd = -1;
     }
+    fd_cache[i].mapping = NULL;
   }
-  current_cluster = 0xffff;
+  buffer_count = 0;
 }
 
-// mappings between index1 and index2-1 are supposed to be ordered
-// return value is the index of the last mapping for which end>cluster_num
-int vvfat_image_t::find_mapping_for_cluster_aux(int cluster_num, int index1, int index2)
+// The mappings are ordered by cluster and don't change after the directory
+// tree has been read, so a flat table gives the mapping of any cluster
+// without a search.
+void vvfat_image_t::build_cluster_map(void)
 {
-  while(1) {
-    int index3;
-    mapping_t* mapping;
-    index3 = (index1+index2) / 2;
-    mapping = (mapping_t*)array_get(&this->mapping, index3);
+  Bit32u i, c;
+  mapping_t* mapping;
+
+  cluster_map_size = 0;
+  for (i = 0; i < this->mapping.next; i++) {
+    mapping = (mapping_t*)array_get(&this->mapping, i);
+    if (mapping->end > cluster_map_size)
+      cluster_map_size = mapping->end;
+  }
+  cluster_map = new Bit32u[cluster_map_size];
+  memset(cluster_map, 0, cluster_map_size * sizeof(Bit32u));
+  for (i = 0; i < this->mapping.next; i++) {
+    mapping = (mapping_t*)array_get(&this->mapping, i);
     assert(mapping->begin < mapping->end);
-    if (mapping->begin >= (unsigned int)cluster_num) {
-      assert(index2 != index3 || index2 == 0);
-      if (index2 == index3)
-        return index1;
-      index2 = index3;
-    } else {
-      if (index1 == index3)
-        return (mapping->end <= (unsigned int)cluster_num) ? index2 : index1;
-      index1 = index3;
+    for (c = mapping->begin; c < mapping->end; c++) {
+      cluster_map[c] = i + 1;
     }
-    assert(index1 <= index2);
   }
 }
 
 mapping_t* vvfat_image_t::find_mapping_for_cluster(int cluster_num)
 {
-  int index = find_mapping_for_cluster_aux(cluster_num, 0, mapping.next);
-  mapping_t* mapping;
-  if (index >= (int)this->mapping.next)
-    return NULL;
-  mapping = (mapping_t*)array_get(&this->mapping, index);
-  if ((int)mapping->begin > cluster_num)
+  if ((cluster_num < 0) || ((Bit32u)cluster_num >= cluster_map_size) ||
+      (cluster_map[cluster_num] == 0))
     return NULL;
-  assert(((int)mapping->begin <= cluster_num) && ((int)mapping->end > cluster_num));
-  return mapping;
+  return (mapping_t*)array_get(&this->mapping, cluster_map[cluster_num] - 1);
 }
 
 // This function simply compares path == mapping->path. Since the mappings
@@ -1859,77 +1868,101 @@ mapping_t* vvfat_image_t::find_mapping_for_path(const char* path)
     return NULL;
 }
 
+// Returns a file descriptor for the mapping's host file. The most recently
+// used files are kept open, so that guests reading several files in turn
+// don't reopen them for every cluster.
 int vvfat_image_t::open_file(mapping_t* mapping)
 {
+  int i, lru = 0;
+
   if (!mapping)
     return -1;
-  if (!current_mapping ||
-    strcmp(current_mapping->path, mapping->path)) {
-    /* open file */
-    int fd = ::open(mapping->path, O_RDONLY
+  for (i = 0; i < VVFAT_FD_CACHE_SIZE; i++) {
+    if ((fd_cache[i].fd >= 0) && (fd_cache[i].mapping == mapping)) {
+      fd_cache[i].last_used = ++fd_cache_clock;
+      return fd_cache[i].fd;
+    }
+    if ((fd_cache[i].fd < 0) ||
+        ((fd_cache[lru].fd >= 0) && (fd_cache[i].last_used < fd_cache[lru].last_used))) {
+      lru = i;
+    }
+  }
+  /* open file */
+  int fd = ::open(mapping->path, O_RDONLY
 #ifdef O_BINARY
-                    | O_BINARY
+                  | O_BINARY
 #endif
 #ifdef O_LARGEFILE
-                    | O_LARGEFILE
+                  | O_LARGEFILE
 #endif
-                    );
-    if (fd < 0)
-      return -1;
-    close_current_file();
-    current_fd = fd;
-    current_mapping = mapping;
-  }
-  return 0;
+                  );
+  if (fd < 0)
+    return -1;
+  if (fd_cache[lru].fd >= 0)
+    ::close(fd_cache[lru].fd);
+  fd_cache[lru].fd = fd;
+  fd_cache[lru].mapping = mapping;
+  fd_cache[lru].last_used = ++fd_cache_clock;
+  return fd;
 }
 
 int vvfat_image_t::read_cluster(int cluster_num)
 {
   mapping_t* mapping;
+  off_t offset;
+  Bit32u count;
+  int fd;
 
-  if (current_cluster != cluster_num) {
-    int result=0;
-    off_t offset;
-    assert(!current_mapping || current_fd || (current_mapping->mode & MODE_DIRECTORY));
-    if (!current_mapping
-        || ((int)current_mapping->begin > cluster_num)
-        || ((int)current_mapping->end <= cluster_num)) {
-      // binary search of mappings for file
-      mapping = find_mapping_for_cluster(cluster_num);
-
-      assert(!mapping || ((cluster_num >= (int)mapping->begin) && (cluster_num < (int)mapping->end)));
-
-      if (mapping && mapping->mode & MODE_DIRECTORY) {
-        close_current_file();
-        current_mapping = mapping;
-read_cluster_directory:
-        offset = cluster_size * (cluster_num - current_mapping->begin);
-        cluster = (unsigned char*)directory.pointer+offset
-                     + 0x20 * current_mapping->info.dir.first_dir_index;
-        assert(((cluster -(unsigned char*)directory.pointer) % cluster_size) == 0);
-        assert((char*)cluster + cluster_size <= directory.pointer + directory.next * directory.item_size);
-        current_cluster = cluster_num;
-        return 0;
-      }
-
-      if (open_file(mapping))
-        return -2;
-    } else if (current_mapping->mode & MODE_DIRECTORY)
-      goto read_cluster_directory;
-
-    assert(current_fd);
-
-    offset = cluster_size * (cluster_num - current_mapping->begin) + current_mapping->info.file.offset;
-    if (::lseek(current_fd, offset, SEEK_SET) != offset)
-      return -3;
-    cluster = cluster_buffer;
-    result = ::read(current_fd, cluster, cluster_size);
-    if (result < 0) {
-      current_cluster = 0xffff;
-      return -1;
-    }
-    current_cluster = cluster_num;
+  if ((buffer_count > 0) && ((Bit32u)cluster_num >= buffer_first) &&
+      ((Bit32u)cluster_num < (buffer_first + buffer_count))) {
+    cluster = cluster_buffer + (cluster_num - buffer_first) * cluster_size;
+    return 0;
+  }
+  mapping = find_mapping_for_cluster(cluster_num);
+  if (mapping && (mapping->mode & MODE_DIRECTORY)) {
+    offset = cluster_size * (cluster_num - mapping->begin);
+    cluster = (unsigned char*)directory.pointer+offset
+                 + 0x20 * mapping->info.dir.first_dir_index;
+    assert(((cluster -(unsigned char*)directory.pointer) % cluster_size) == 0);
+    assert((char*)cluster + cluster_size <= directory.pointer + directory.next * directory.item_size);
+    return 0;
   }
+  fd = open_file(mapping);
+  if (fd < 0)
+    return -2;
+
+  // read ahead while the guest reads the file sequentially, doubling
+  // the amount each time up to the buffer size
+  if ((Bit32u)cluster_num == next_cluster) {
+    count = readahead;
+    if (readahead < readahead_max)
+      readahead <<= 1;
+  } else {
+    count = 1;
+    readahead = 2;
+  }
+  if (count > (mapping->end - cluster_num))
+    count = mapping->end - cluster_num;
+
+  offset = cluster_size * (cluster_num - mapping->begin) + mapping->info.file.offset;
+  if (::lseek(fd, offset, SEEK_SET) != offset)
+    return -3;
+  buffer_count = 0;
+  ssize_t result = ::read(fd, cluster_buffer, count * cluster_size);
+  if (result < 0)
+    return -1;
+  if (result < (ssize_t)(count * cluster_size))
+    memset(cluster_buffer + result, 0, count * cluster_size - result);
+#if defined(POSIX_FADV_WILLNEED)
+  // let the host start reading the next chunk while the guest consumes this one
+  if ((count > 1) && ((Bit32u)cluster_num + count < mapping->end)) {
+    posix_fadvise(fd, offset + count * cluster_size, readahead * cluster_size, POSIX_FADV_WILLNEED);
+  }
+#endif
+  buffer_first = cluster_num;
+  buffer_count = count;
+  next_cluster = cluster_num + count;
+  cluster = cluster_buffer;
   return 0;
 }
 
@@ -84,6 +84,11 @@ enum {
   MODE_DELETED = 16, MODE_RENAMED = 32
 };
 
+// number of host files kept open for cluster reads
+#define VVFAT_FD_CACHE_SIZE 8
+// largest host read issued for sequential cluster reads
+#define VVFAT_READAHEAD_MAX 0x10000
+
 typedef struct mapping_t {
   // begin is the first cluster, end is the last+1
   Bit32u begin, end;
@@ -145,9 +150,9 @@ class vvfat_image_t : public device_image_t
     direntry_t* read_direntry(Bit8u *buffer, char *filename);
     void parse_directory(const char *path, Bit32u start_cluster);
     void commit_changes(void);
-    void close_current_file(void);
+    void close_files(void);
     int open_file(mapping_t* mapping);
-    int find_mapping_for_cluster_aux(int cluster_num, int index1, int index2);
+    void build_cluster_map(void);
     mapping_t* find_mapping_for_cluster(int cluster_num);
     mapping_t* find_mapping_for_path(const char* path);
     int read_cluster(int cluster_num);
@@ -171,11 +176,22 @@ class vvfat_image_t : public device_image_t
     Bit8u  fat_type;
     array_t fat, directory, mapping;
 
-    int current_fd;
-    mapping_t* current_mapping;
+    // mapping index + 1 for each cluster up to the end of the last mapping
+    Bit32u *cluster_map;
+    Bit32u cluster_map_size;
+    struct {
+      int fd;
+      mapping_t *mapping;
+      Bit32u last_used;
+    } fd_cache[VVFAT_FD_CACHE_SIZE];
+    Bit32u fd_cache_clock;
     Bit8u  *cluster; // points to current cluster
-    Bit8u  *cluster_buffer; // points to a buffer to hold temp data
-    Bit16u current_cluster;
+    Bit8u  *cluster_buffer; // holds up to readahead_max clusters read from a file
+    Bit32u buffer_first; // first cluster in cluster_buffer
+    Bit32u buffer_count; // number of valid clusters in cluster_buffer
+    Bit32u readahead; // clusters to read next if the access is sequential
+    Bit32u readahead_max;
+    Bit32u next_cluster; // cluster following the last host read
 
     const char *vvfat_path;
     Bit32u sector_num;
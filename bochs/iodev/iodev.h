@@ -424,12 +424,14 @@ public:
   void register_removable_mouse(void *dev, bx_mouse_enq_t mouse_enq, bx_mouse_enabled_changed_t mouse_enabled_changed);
   void unregister_removable_mouse(void *dev);
   void gen_scancode(Bit32u key);
+  void send_scancode(Bit32u key);
   Bit8u kbd_get_elements(void);
   void release_keys(void);
   void paste_bytes(Bit8u *data, Bit32s length);
   void kbd_set_indicator(Bit8u devid, Bit8u ledid, bool state);
   void mouse_enabled_changed(bool enabled);
   void mouse_motion(int delta_x, int delta_y, int delta_z, unsigned button_state, bool absxy);
+  void send_mouse_event(int delta_x, int delta_y, int delta_z, unsigned button_state, bool absxy);
   void add_sound_device(void);
   void remove_sound_device(void);
 
@@ -667,6 +669,19 @@ BX_CPP_INLINE void DEV_MEM_WRITE_PHYSICAL_DMA(bx_phy_address phy_addr, unsigned
   }
 }
 
+// Host address for accessing guest memory in place, or NULL if the range
+// must be copied with DEV_MEM_{READ,WRITE}_PHYSICAL_DMA.
+BX_CPP_INLINE Bit8u* DEV_MEM_DMA_HOST_ADDR(bx_phy_address phy_addr, unsigned len, unsigned rw)
+{
+  return BX_MEM(0)->getHostDmaAddr(phy_addr, len, rw);
+}
+
+// Must follow writes through a pointer from DEV_MEM_DMA_HOST_ADDR()
+BX_CPP_INLINE void DEV_MEM_DMA_WRITTEN(bx_phy_address phy_addr, unsigned len)
+{
+  BX_MEM(0)->dmaWriteNotify(phy_addr, len);
+}
+
 BOCHSAPI extern bx_devices_c bx_devices;
 
 #endif /* IODEV_H */
@@ -37,6 +37,20 @@
 
 #include "slirp/slirp.h"
 #include "slirp/libslirp.h"
+#include "bxthread.h"
+
+// On hosts with a pipe to wake it up, the slirp sockets are served by a
+// poll thread that sleeps in select() until a socket is ready, a guest
+// packet arrives or a slirp timer expires. Otherwise the emulator timer
+// polls them.
+#ifndef WIN32
+#define BX_SLIRP_POLL_THREAD 1
+#else
+#define BX_SLIRP_POLL_THREAD 0
+#endif
+
+// Received frames queued for the guest per slirp instance (power of 2)
+#define SLIRP_RX_QUEUE 64
 
 static unsigned int bx_slirp_instances = 0;
 
@@ -57,8 +71,17 @@ PLUGIN_ENTRY_FOR_NET_MODULE(slirp)
 #define MAX_HOSTFWD 5
 
 static int rx_timer_index = BX_NULL_TIMER_HANDLE;
+#if BX_SLIRP_POLL_THREAD
+// slirp_mutex protects all slirp state against the poll thread
+static BX_MUTEX(slirp_mutex);
+static BX_THREAD_VAR(slirp_poll_var);
+static bool slirp_poll_running = 0; // protected by slirp_mutex
+static int slirp_wake_fd[2];
+static Bit32u slirp_wake_pending = 0; // a wake-up byte is in the pipe
+#else
 fd_set rfds, wfds, xfds;
 int nfds;
+#endif
 
 extern int slirp_hostfwd(Slirp *s, const char *redir_str, int legacy_format);
 #ifndef WIN32
@@ -76,10 +99,22 @@ public:
   void sendpkt(void *buf, unsigned io_len);
   void receive(void *pkt, unsigned pkt_len);
   int can_receive(void);
+  int can_queue(void);
+  void queue(const Bit8u *pkt, unsigned pkt_len);
 private:
   Slirp *slirp;
   unsigned netdev_speed;
 
+  // frames from slirp to the guest, written with slirp_mutex held and
+  // read by the emulator thread
+  struct rx_frame_t {
+    unsigned len;
+    Bit8u data[BX_PACKET_BUFSIZE];
+  } *rx_queue;
+  volatile Bit32u rx_head, rx_tail;
+  volatile bool rx_blocked;
+  bx_slirp_pktmover_c *next;
+
   int restricted;
   struct in_addr net, mask, host, dhcp, dns;
   char *bootfile, *hostname, **dnssearch;
@@ -94,9 +129,31 @@ private:
   bool slirp_logging;
 
   bool parse_slirp_conf(const char *conf);
+  void deliver(void);
   static void rx_timer_handler(void *);
+#if BX_SLIRP_POLL_THREAD
+  static void wake_poll_thread(void);
+  static BX_THREAD_FUNC(poll_thread, indata);
+#endif
 };
 
+// all slirp instances, for the shared receive timer
+static bx_slirp_pktmover_c *bx_slirp_movers = NULL;
+
+static inline void slirp_lock(void)
+{
+#if BX_SLIRP_POLL_THREAD
+  BX_LOCK(slirp_mutex);
+#endif
+}
+
+static inline void slirp_unlock(void)
+{
+#if BX_SLIRP_POLL_THREAD
+  BX_UNLOCK(slirp_mutex);
+#endif
+}
+
 class bx_slirp_locator_c : public eth_locator_c {
 public:
   bx_slirp_locator_c(void) : eth_locator_c("slirp") {}
@@ -112,6 +169,7 @@ protected:
 bx_slirp_pktmover_c::~bx_slirp_pktmover_c()
 {
   if (slirp != NULL) {
+    slirp_lock();
     slirp_cleanup(slirp);
 #ifndef WIN32
     if ((smb_export != NULL) && (smb_tmpdir != NULL)) {
@@ -120,6 +178,14 @@ bx_slirp_pktmover_c::~bx_slirp_pktmover_c()
       free(smb_export);
     }
 #endif
+    slirp_unlock();
+    for (bx_slirp_pktmover_c **pp = &bx_slirp_movers; *pp != NULL; pp = &(*pp)->next) {
+      if (*pp == this) {
+        *pp = next;
+        break;
+      }
+    }
+    delete [] rx_queue;
     if (bootfile != NULL) free(bootfile);
     if (hostname != NULL) free(hostname);
     if (dnssearch != NULL) {
@@ -134,6 +200,16 @@ bx_slirp_pktmover_c::~bx_slirp_pktmover_c()
     }
     if (--bx_slirp_instances == 0) {
       bx_pc_system.deactivate_timer(rx_timer_index);
+#if BX_SLIRP_POLL_THREAD
+      BX_LOCK(slirp_mutex);
+      slirp_poll_running = 0;
+      BX_UNLOCK(slirp_mutex);
+      wake_poll_thread();
+      BX_THREAD_JOIN(slirp_poll_var);
+      close(slirp_wake_fd[0]);
+      close(slirp_wake_fd[1]);
+      BX_FINI_MUTEX(slirp_mutex);
+#endif
 #ifndef WIN32
       signal(SIGPIPE, SIG_DFL);
 #endif
@@ -296,6 +372,9 @@ bx_slirp_pktmover_c::bx_slirp_pktmover_c(const char *netif,
 
   restricted = 0;
   slirp = NULL;
+  rx_queue = NULL;
+  rx_head = rx_tail = 0;
+  rx_blocked = 0;
   hostname = NULL;
   bootfile = NULL;
   dnssearch = NULL;
@@ -328,8 +407,20 @@ bx_slirp_pktmover_c::bx_slirp_pktmover_c(const char *netif,
     rx_timer_index =
       DEV_register_timer(this, this->rx_timer_handler, 1000, 1, 1,
                          "eth_slirp");
+    slirp_set_time_usec(bx_pc_system.time_usec());
 #ifndef WIN32
     signal(SIGPIPE, SIG_IGN);
+#endif
+#if BX_SLIRP_POLL_THREAD
+    BX_INIT_MUTEX(slirp_mutex);
+    if (pipe(slirp_wake_fd) < 0) {
+      BX_PANIC(("slirp: failed to create wakeup pipe"));
+    }
+    fcntl(slirp_wake_fd[0], F_SETFL, O_NONBLOCK);
+    fcntl(slirp_wake_fd[1], F_SETFL, O_NONBLOCK);
+    slirp_wake_pending = 0;
+    slirp_poll_running = 1;
+    BX_THREAD_CREATE(poll_thread, NULL, slirp_poll_var);
 #endif
   }
 
@@ -341,6 +432,8 @@ bx_slirp_pktmover_c::bx_slirp_pktmover_c(const char *netif,
   slirplog = new logfunctions();
   sprintf(prefix, "SLIRP%d", bx_slirp_instances);
   slirplog->put(prefix);
+  rx_queue = new rx_frame_t[SLIRP_RX_QUEUE];
+  slirp_lock();
   slirp = slirp_init(restricted, net, mask, host, hostname, netif, bootfile, dhcp, dns,
                      (const char**)dnssearch, this, slirplog);
   if (n_hostfwd > 0) {
@@ -356,6 +449,7 @@ bx_slirp_pktmover_c::bx_slirp_pktmover_c(const char *netif,
     }
   }
 #endif
+  slirp_unlock();
   if (pktlog_fn != NULL) {
     pktlog_txt = fopen(pktlog_fn, "wb");
     slirp_logging = (pktlog_txt != NULL);
@@ -377,7 +471,13 @@ bx_slirp_pktmover_c::bx_slirp_pktmover_c(const char *netif,
   } else {
     slirp_logging = 0;
   }
+  next = bx_slirp_movers;
+  bx_slirp_movers = this;
   bx_slirp_instances++;
+#if BX_SLIRP_POLL_THREAD
+  // let the poll thread pick up the host forwarding sockets
+  wake_poll_thread();
+#endif
 }
 
 void bx_slirp_pktmover_c::sendpkt(void *buf, unsigned io_len)
@@ -385,19 +485,103 @@ void bx_slirp_pktmover_c::sendpkt(void *buf, unsigned io_len)
   if (slirp_logging) {
     write_pktlog_txt(pktlog_txt, (const Bit8u*)buf, io_len, 0);
   }
+  slirp_lock();
   slirp_input(slirp, (Bit8u*)buf, io_len);
+  slirp_unlock();
+#if BX_SLIRP_POLL_THREAD
+  // the packet may have opened a socket or queued data for one
+  wake_poll_thread();
+#endif
+}
+
+#if BX_SLIRP_POLL_THREAD
+
+void bx_slirp_pktmover_c::wake_poll_thread(void)
+{
+  if (BX_ATOMIC_EXCHANGE(slirp_wake_pending, 1) == 0) {
+    if (write(slirp_wake_fd[1], "", 1) < 0) {
+      BX_ATOMIC_EXCHANGE(slirp_wake_pending, 0);
+    }
+  }
+}
+
+BX_THREAD_FUNC(bx_slirp_pktmover_c::poll_thread, indata)
+{
+  fd_set rfds, wfds, xfds;
+  struct timeval tv;
+  Bit32u timeout;
+  int nfds, ret;
+  char buf[64];
+
+  while (1) {
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&xfds);
+    FD_SET(slirp_wake_fd[0], &rfds);
+    nfds = slirp_wake_fd[0];
+    timeout = 1000;
+    BX_LOCK(slirp_mutex);
+    if (!slirp_poll_running) {
+      BX_UNLOCK(slirp_mutex);
+      break;
+    }
+    slirp_select_fill(&nfds, &rfds, &wfds, &xfds, &timeout);
+    BX_UNLOCK(slirp_mutex);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    ret = select(nfds + 1, &rfds, &wfds, &xfds, &tv);
+    if ((ret > 0) && FD_ISSET(slirp_wake_fd[0], &rfds)) {
+      // drain the pipe before clearing the flag, so that a wake-up
+      // posted in between leaves its byte for the next select()
+      while (read(slirp_wake_fd[0], buf, sizeof(buf)) > 0);
+      BX_MEMORY_BARRIER();
+      BX_ATOMIC_EXCHANGE(slirp_wake_pending, 0);
+    }
+    BX_LOCK(slirp_mutex);
+    slirp_select_poll(&rfds, &wfds, &xfds, (ret < 0));
+    BX_UNLOCK(slirp_mutex);
+  }
+  BX_THREAD_EXIT;
+}
+
+#endif
+
+// Passes queued frames to the guest as far as the NIC takes them.
+void bx_slirp_pktmover_c::deliver(void)
+{
+  Bit32u tail = rx_tail, old_tail = rx_tail;
+
+  while ((tail != rx_head) && can_receive()) {
+    BX_MEMORY_BARRIER();
+    receive(rx_queue[tail & (SLIRP_RX_QUEUE - 1)].data,
+            rx_queue[tail & (SLIRP_RX_QUEUE - 1)].len);
+    BX_MEMORY_BARRIER();
+    rx_tail = ++tail;
+  }
+#if BX_SLIRP_POLL_THREAD
+  // slirp holds back frames while the queue is full
+  if (rx_blocked && (tail != old_tail)) {
+    rx_blocked = 0;
+    wake_poll_thread();
+  }
+#endif
 }
 
 void bx_slirp_pktmover_c::rx_timer_handler(void *this_ptr)
 {
+#if !BX_SLIRP_POLL_THREAD
   Bit32u timeout = 0;
   int ret;
 #ifdef WIN32
   TIMEVAL tv;
 #else
   struct timeval tv;
+#endif
 #endif
 
+  // the poll thread must not read bx_pc_system itself
+  slirp_set_time_usec(bx_pc_system.time_usec());
+#if !BX_SLIRP_POLL_THREAD
   nfds = -1;
   FD_ZERO(&rfds);
   FD_ZERO(&wfds);
@@ -407,12 +591,12 @@ void bx_slirp_pktmover_c::rx_timer_handler(void *this_ptr)
   tv.tv_usec = 0;
   ret = select(nfds + 1, &rfds, &wfds, &xfds, &tv);
   slirp_select_poll(&rfds, &wfds, &xfds, (ret < 0));
-}
-
-int slirp_can_output(void *this_ptr)
-{
-  bx_slirp_pktmover_c *class_ptr = (bx_slirp_pktmover_c *)this_ptr;
-  return class_ptr->can_receive();
+#endif
+  for (bx_slirp_pktmover_c *mover = bx_slirp_movers; mover != NULL; mover = mover->next) {
+    if (mover->rx_tail != mover->rx_head) {
+      mover->deliver();
+    }
+  }
 }
 
 int bx_slirp_pktmover_c::can_receive()
@@ -420,12 +604,6 @@ int bx_slirp_pktmover_c::can_receive()
   return ((this->rxstat(this->netdev) & BX_NETDEV_RXREADY) != 0);
 }
 
-void slirp_output(void *this_ptr, const Bit8u *pkt, int pkt_len)
-{
-  bx_slirp_pktmover_c *class_ptr = (bx_slirp_pktmover_c *)this_ptr;
-  class_ptr->receive((void*)pkt, pkt_len);
-}
-
 void bx_slirp_pktmover_c::receive(void *pkt, unsigned pkt_len)
 {
   if (this->rxstat(this->netdev) & BX_NETDEV_RXREADY) {
@@ -439,4 +617,45 @@ void bx_slirp_pktmover_c::receive(void *pkt, unsigned pkt_len)
   }
 }
 
+// The functions below are called by slirp with slirp_mutex held.
+
+int slirp_can_output(void *this_ptr)
+{
+  bx_slirp_pktmover_c *class_ptr = (bx_slirp_pktmover_c *)this_ptr;
+  return class_ptr->can_queue();
+}
+
+int bx_slirp_pktmover_c::can_queue()
+{
+  if ((rx_head - rx_tail) < SLIRP_RX_QUEUE) {
+    return 1;
+  }
+  rx_blocked = 1;
+  return 0;
+}
+
+void slirp_output(void *this_ptr, const Bit8u *pkt, int pkt_len)
+{
+  bx_slirp_pktmover_c *class_ptr = (bx_slirp_pktmover_c *)this_ptr;
+  class_ptr->queue(pkt, pkt_len);
+}
+
+void bx_slirp_pktmover_c::queue(const Bit8u *pkt, unsigned pkt_len)
+{
+  Bit32u head = rx_head;
+
+  if ((head - rx_tail) >= SLIRP_RX_QUEUE) {
+    BX_ERROR(("receive queue full, dropping packet"));
+    return;
+  }
+  if (pkt_len > BX_PACKET_BUFSIZE) {
+    BX_ERROR(("dropping oversized packet (%u bytes)", pkt_len));
+    return;
+  }
+  memcpy(rx_queue[head & (SLIRP_RX_QUEUE - 1)].data, pkt, pkt_len);
+  rx_queue[head & (SLIRP_RX_QUEUE - 1)].len = pkt_len;
+  BX_MEMORY_BARRIER();
+  rx_head = head + 1;
+}
+
 #endif /* if BX_NETWORKING && BX_NETMOD_SLIRP */
@@ -31,11 +31,30 @@
 #if BX_NETWORKING
 
 #include "netmod.h"
+#include "replay.h"
 
 #define LOG_THIS bx_netmod_ctl.
 
 bx_netmod_ctl_c bx_netmod_ctl;
 
+// Pktmover wrapper used when recording or replaying host input. Received
+// frames are passed to bx_replay, and sending a frame is a sync point for
+// modules that answer synchronously.
+class eth_replay_c : public eth_pktmover_c {
+public:
+  eth_replay_c(eth_pktmover_c *ethmod) : ethmod(ethmod) {}
+  virtual ~eth_replay_c() { delete ethmod; }
+  void sendpkt(void *buf, unsigned io_len) {
+    ethmod->sendpkt(buf, io_len);
+    bx_replay.sync_point();
+  }
+  static void rx_handler(void *arg, const void *buf, unsigned len) {
+    bx_replay.net_rx(arg, buf, len);
+  }
+private:
+  eth_pktmover_c *ethmod;
+};
+
 const char **net_module_names;
 
 bx_netmod_ctl_c::bx_netmod_ctl_c()
@@ -104,7 +123,12 @@ void bx_netmod_ctl_c::exit(void)
 void* bx_netmod_ctl_c::init_module(bx_list_c *base, void *rxh, void *rxstat, logfunctions *netdev)
 {
   eth_pktmover_c *ethmod;
+  bool replay = bx_replay.recording() || bx_replay.replaying();
 
+  if (replay) {
+    bx_replay.register_netdev(netdev, (bx_replay_rx_handler_t)rxh);
+    rxh = (void*)eth_replay_c::rx_handler;
+  }
   // Attach to the selected ethernet module
   const char *modname = SIM->get_param_enum("ethmod", base)->get_selected();
   if (!eth_locator_c::module_present(modname)) {
@@ -131,6 +155,9 @@ void* bx_netmod_ctl_c::init_module(bx_list_c *base, void *rxh, void *rxstat, log
     if (ethmod == NULL)
       BX_PANIC(("could not locate 'null' module"));
   }
+  if (replay && (ethmod != NULL)) {
+    ethmod = new eth_replay_c(ethmod);
+  }
   return ethmod;
 }
 
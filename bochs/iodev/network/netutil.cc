@@ -30,6 +30,7 @@
 #else
 #include "bochs.h"
 #include "pc_system.h"
+#include "replay.h"
 #endif
 
 #if BX_NETWORKING
@@ -232,7 +233,12 @@ void vnet_server_c::init(logfunctions *_netdev, dhcp_cfg_t *dhcpc, const char *t
   if (strlen(tftp_root) > 0) {
     register_layer4_handler(0x11, INET_PORT_TFTP_SERVER, udpipv4_tftp_handler);
     register_tcp_handler(INET_PORT_FTP, tcpipv4_ftp_handler);
+#ifdef BXHUB
     srand((unsigned)time(NULL)); // for random FTP data port
+#else
+    // for random FTP data port (this also reseeds RDRAND)
+    srand((unsigned)bx_replay.host_value(BX_REPLAY_VAL_SEED, time(NULL)));
+#endif
   }
 }
 
@@ -161,7 +161,7 @@ diddit:
  */
 void if_start(Slirp *slirp)
 {
-    uint64_t now = bx_pc_system.time_usec() * 1000ULL;
+    uint64_t now = slirp_time_usec() * 1000ULL;
     bool from_batchq, next_from_batchq;
     struct mbuf *ifm, *ifm_next, *ifqt;
 
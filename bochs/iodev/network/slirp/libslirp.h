@@ -28,6 +28,11 @@ void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds,
 
 void slirp_input(Slirp *slirp, const uint8_t *pkt, int pkt_len);
 
+/* slirp may run on a poll thread, so the emulator thread publishes the
+ * emulated time for it */
+void slirp_set_time_usec(Bit64u usec);
+Bit64u slirp_time_usec(void);
+
 /* you must provide the following functions: */
 int slirp_can_output(void *opaque);
 void slirp_output(void *opaque, const uint8_t *pkt, int pkt_len);
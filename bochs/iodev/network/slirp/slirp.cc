@@ -28,6 +28,7 @@
 
 #include "slirp.h"
 #include "iodev.h"
+#include "bxthread.h"
 
 #if BX_NETWORKING && BX_NETMOD_SLIRP
 
@@ -50,6 +51,9 @@ fd_set *global_readfds, *global_writefds, *global_xfds;
 
 u_int curtime;
 
+/* emulated time in microseconds, see slirp_set_time_usec() */
+static Bit64u slirp_time_snapshot;
+
 static QTAILQ_HEAD(slirp_instances, Slirp) slirp_instances =
     QTAILQ_HEAD_INITIALIZER(slirp_instances);
 
@@ -452,6 +456,16 @@ void slirp_select_fill(int *pnfds, fd_set *readfds, fd_set *writefds,
     *pnfds = nfds;
 }
 
+void slirp_set_time_usec(Bit64u usec)
+{
+    BX_ATOMIC_STORE64(slirp_time_snapshot, usec);
+}
+
+Bit64u slirp_time_usec(void)
+{
+    return BX_ATOMIC_LOAD64(slirp_time_snapshot);
+}
+
 void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds,
                        int select_error)
 {
@@ -467,7 +481,7 @@ void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds,
     global_writefds = writefds;
     global_xfds = xfds;
 
-    curtime = (u_int)(bx_pc_system.time_usec() / 1000);
+    curtime = (u_int)(slirp_time_usec() / 1000);
 
     QTAILQ_FOREACH(slirp, &slirp_instances, entry) {
         /*
@@ -798,7 +812,7 @@ int if_encap(Slirp *slirp, struct mbuf *ifm)
             ifm->arp_requested = true;
 
             /* Expire request and drop outgoing packet after 1 second */
-            ifm->expiration_date = (bx_pc_system.time_usec() + 1000000ULL) * 1000ULL;
+            ifm->expiration_date = (slirp_time_usec() + 1000000ULL) * 1000ULL;
         }
         return 0;
     } else {
@@ -45,6 +45,7 @@ typedef int SOCKET;
 #endif
 
 #include "serial.h"
+#include "replay.h"
 
 #if defined(WIN32) && !defined(FILE_FLAG_FIRST_PIPE_INSTANCE)
 #define FILE_FLAG_FIRST_PIPE_INSTANCE 0
@@ -1639,6 +1640,11 @@ void bx_serial_c::rx_timer(void)
 #endif
         break;
     }
+    if (BX_SER_THIS s[port].io_mode != BX_SER_MODE_MOUSE) {
+      // host input is journaled when recording and taken from the journal
+      // when replaying
+      data_ready = bx_replay.serial_rx(port, data_ready, &chbuf);
+    }
     if (data_ready) {
       if (!BX_SER_THIS s[port].modem_cntl.local_loopback) {
         rx_fifo_enq(port, chbuf);
@@ -141,6 +141,7 @@ struct USBPacket {
   Bit8u devep;
   Bit8u *data;
   int len;
+  bool host_buf; // data points into guest memory and is not owned
   USBCallback *complete_cb;
   void *complete_dev;
   usb_device_c *dev;
@@ -274,9 +275,20 @@ static BX_CPP_INLINE void usb_packet_init(USBPacket *p, int size)
 static BX_CPP_INLINE void usb_packet_cleanup(USBPacket *p)
 {
   if (p->data) {
-    delete [] p->data;
+    if (!p->host_buf)
+      delete [] p->data;
     p->data = NULL;
   }
+  p->host_buf = 0;
+}
+
+// Let the device transfer directly to / from guest memory mapped at
+// the host address 'buf' instead of the packet's own buffer.
+static BX_CPP_INLINE void usb_packet_set_host_buf(USBPacket *p, Bit8u *buf)
+{
+  usb_packet_cleanup(p);
+  p->data = buf;
+  p->host_buf = 1;
 }
 
 static BX_CPP_INLINE void usb_defer_packet(USBPacket *p, usb_device_c *dev)
@@ -1940,6 +1940,7 @@ void bx_usb_xhci_c::process_transfer_ring(const int slot, const int ep)
   Bit32u bytes_not_transferred = 0;
   int comp_code = 0;
   Bit8u immed_data[8];
+  Bit8u *host_buf;
 
   // this assumes that we are starting at the first of the TD when this function is called.
   // this is usually the case, and rarely isn't.
@@ -2121,8 +2122,13 @@ void bx_usb_xhci_c::process_transfer_ring(const int slot, const int ep)
             case USB_TOKEN_SETUP:
               if (is_immed_data)
                 memcpy(p->packet.data, immed_data, transfer_length);
-              else if (transfer_length > 0)
-                DEV_MEM_READ_PHYSICAL_DMA((bx_phy_address) address, transfer_length, p->packet.data);
+              else if (transfer_length > 0) {
+                host_buf = DEV_MEM_DMA_HOST_ADDR((bx_phy_address) address, transfer_length, BX_READ);
+                if (host_buf != NULL)
+                  usb_packet_set_host_buf(&p->packet, host_buf);
+                else
+                  DEV_MEM_READ_PHYSICAL_DMA((bx_phy_address) address, transfer_length, p->packet.data);
+              }
               // The XHCI should block all SET_ADDRESS SETUP TOKEN's
               if ((cur_direction == USB_TOKEN_SETUP)   &&
                   (p->packet.data[0] == 0) &&  // Request type
@@ -2137,6 +2143,11 @@ void bx_usb_xhci_c::process_transfer_ring(const int slot, const int ep)
               }
               break;
             case USB_TOKEN_IN:
+              if (transfer_length > 0) {
+                host_buf = DEV_MEM_DMA_HOST_ADDR((bx_phy_address) address, transfer_length, BX_WRITE);
+                if (host_buf != NULL)
+                  usb_packet_set_host_buf(&p->packet, host_buf);
+              }
               ret = BX_XHCI_THIS broadcast_packet(&p->packet, port_num - 1);
               break;
           }
@@ -2149,8 +2160,12 @@ void bx_usb_xhci_c::process_transfer_ring(const int slot, const int ep)
           if (ret >= 0) {
             len = ret;
             BX_XHCI_THIS hub.slots[slot].ep_context[ep].edtla += len;
-            if (len > 0)
-              DEV_MEM_WRITE_PHYSICAL_DMA((bx_phy_address) address, len, p->packet.data);
+            if (len > 0) {
+              if (p->packet.host_buf)
+                DEV_MEM_DMA_WRITTEN((bx_phy_address) address, len);
+              else
+                DEV_MEM_WRITE_PHYSICAL_DMA((bx_phy_address) address, len, p->packet.data);
+            }
             BX_DEBUG(("IN: Transferred %i bytes, requested %i bytes", len, transfer_length));
             if (len < (int) transfer_length) {
               bytes_not_transferred = transfer_length - len;
@@ -2749,8 +2764,18 @@ void bx_usb_xhci_c::write_event_TRB(const unsigned interrupter, const Bit64u par
   }
 }
 
+// TRBs are 16-byte aligned and never cross a page, so a ring walk can
+// usually access them in place instead of through three physical accesses
 void bx_usb_xhci_c::read_TRB(bx_phy_address addr, struct TRB *trb)
 {
+  Bit8u *host = DEV_MEM_DMA_HOST_ADDR(addr, 16, BX_READ);
+
+  if (host != NULL) {
+    trb->parameter = ReadHostQWordFromLittleEndian((Bit64u*) host);
+    trb->status    = ReadHostDWordFromLittleEndian((Bit32u*)(host +  8));
+    trb->command   = ReadHostDWordFromLittleEndian((Bit32u*)(host + 12));
+    return;
+  }
   DEV_MEM_READ_PHYSICAL(addr,      8, (Bit8u*)&trb->parameter);
   DEV_MEM_READ_PHYSICAL(addr +  8, 4, (Bit8u*)&trb->status);
   DEV_MEM_READ_PHYSICAL(addr + 12, 4, (Bit8u*)&trb->command);
@@ -2758,6 +2783,16 @@ void bx_usb_xhci_c::read_TRB(bx_phy_address addr, struct TRB *trb)
 
 void bx_usb_xhci_c::write_TRB(bx_phy_address addr, const Bit64u parameter, const Bit32u status, const Bit32u command)
 {
+  Bit8u *host = DEV_MEM_DMA_HOST_ADDR(addr, 16, BX_WRITE);
+
+  if (host != NULL) {
+    // the command dword holds the cycle bit, so it goes last
+    WriteHostQWordToLittleEndian((Bit64u*) host, parameter);
+    WriteHostDWordToLittleEndian((Bit32u*)(host +  8), status);
+    WriteHostDWordToLittleEndian((Bit32u*)(host + 12), command);
+    DEV_MEM_DMA_WRITTEN(addr, 16);
+    return;
+  }
   DEV_MEM_WRITE_PHYSICAL(addr     , 8, (Bit8u*)&parameter);
   DEV_MEM_WRITE_PHYSICAL(addr +  8, 4, (Bit8u*)&status);
   DEV_MEM_WRITE_PHYSICAL(addr + 12, 4, (Bit8u*)&command);
@@ -61,6 +61,7 @@
 #include "gui/siminterface.h"
 #include "param_names.h"
 #include "virt_timer.h"
+#include "replay.h"
 
 //Important constant #defines:
 #define USEC_PER_SECOND (1000000)
@@ -448,7 +449,8 @@ void bx_virt_timer_c::timer_handler(bool mode)
   if (usec_delta) {
 #if BX_HAVE_REALTIME_USEC
     Bit64u ticks_delta = 0;
-    Bit64u real_time_delta = GET_VIRT_REALTIME64_USEC() - last_real_time - real_time_delay;
+    Bit64u real_time_delta = bx_replay.host_value(BX_REPLAY_VAL_REALTIME,
+                               GET_VIRT_REALTIME64_USEC() - last_real_time - real_time_delay);
     Bit64u real_time_total = real_time_delta + total_real_usec;
     Bit64u system_time_delta = (Bit64u)usec_delta + (Bit64u)stored_delta;
     if (real_time_delta) {
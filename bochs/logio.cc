@@ -26,6 +26,7 @@
 #include "bxthread.h"
 #include "cpu/cpu.h"
 #include <assert.h>
+#include <stddef.h>
 
 #if BX_WITH_CARBON
 #include <Carbon/Carbon.h>
@@ -38,6 +39,329 @@ const int MAGIC_LOGNUM = 0x12345678;
 static int Allocio=0;
 BX_MUTEX(logio_mutex);
 
+// Asynchronous log writer
+//
+// Messages for a log file are not formatted on the calling thread. Instead
+// out() stores the format string, the arguments, the tick count and the
+// device prefix in a slot of a lock-free ring and the writer thread formats
+// and writes them in batches. Slot 'pos' belongs to a producer while
+// seq == pos and to the writer while seq == pos + 1 (bounded MPSC queue).
+// Panics, messages for the log viewer and messages that don't fit into a
+// slot take the synchronous path after the ring has been drained, so the
+// order in the log file is kept.
+
+#define BX_LOG_RING_SIZE  2048  // must be a power of 2
+#define BX_LOG_MAX_ARGS   16
+#define BX_LOG_DATA_SIZE  344
+#define BX_LOG_NULL_STR   0xffffffff
+
+struct bx_log_entry_t {
+  volatile Bit32u seq;
+  Bit8u  level;
+  Bit8u  nargs;
+  Bit16u len;     // bytes used in data[]
+  Bit32u eip;
+  Bit64u ticks;
+  char prefix[12];
+  union {
+    Bit64u u;
+    double d;
+  } arg[BX_LOG_MAX_ARGS];
+  char data[BX_LOG_DATA_SIZE]; // format string followed by string arguments
+};
+
+static bx_log_entry_t *log_ring = NULL;
+static volatile Bit32u log_head = 0;
+static Bit32u log_tail = 0;
+static BX_THREAD_VAR(log_writer_var);
+
+// argument types of a conversion specification
+enum {
+  LOGARG_NONE,    // "%%"
+  LOGARG_INT,
+  LOGARG_LONG,
+  LOGARG_LLONG,
+  LOGARG_SIZE,
+  LOGARG_DOUBLE,
+  LOGARG_STRING,
+  LOGARG_PTR,
+  LOGARG_UNSUPPORTED
+};
+
+typedef struct {
+  int type;
+  bool is_unsigned;
+  bool width_arg;
+  bool prec_arg;
+} logio_spec_t;
+
+// Parses the conversion specification following a '%' and returns a
+// pointer behind it.
+static const char *logio_parse_spec(const char *p, logio_spec_t *spec)
+{
+  int len = 0; // 0 = none, 1 = l, 2 = ll, 3 = size_t, 4 = L
+  char conv;
+
+  spec->width_arg = 0;
+  spec->prec_arg = 0;
+  spec->is_unsigned = 0;
+  while ((*p != 0) && (strchr("-+ #0'", *p) != NULL)) p++;
+  if (*p == '*') {
+    spec->width_arg = 1;
+    p++;
+  } else {
+    while (isdigit(*p)) p++;
+  }
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      spec->prec_arg = 1;
+      p++;
+    } else {
+      while (isdigit(*p)) p++;
+    }
+  }
+  if (*p == 'h') {
+    p++;
+    if (*p == 'h') p++;
+  } else if (*p == 'l') {
+    len = 1;
+    p++;
+    if (*p == 'l') {
+      len = 2;
+      p++;
+    }
+  } else if ((*p == 'q') || (*p == 'j')) {
+    len = 2;
+    p++;
+  } else if ((*p == 'z') || (*p == 't')) {
+    len = 3;
+    p++;
+  } else if (*p == 'L') {
+    len = 4;
+    p++;
+  } else if (*p == 'I') {
+    p++;
+    if ((p[0] == '6') && (p[1] == '4')) {
+      len = 2;
+      p += 2;
+    } else if ((p[0] == '3') && (p[1] == '2')) {
+      p += 2;
+    } else {
+      len = 3;
+    }
+  }
+  conv = *p;
+  if (conv != 0) p++;
+  switch (conv) {
+    case '%':
+      spec->type = LOGARG_NONE;
+      break;
+    case 'o': case 'u': case 'x': case 'X':
+      spec->is_unsigned = 1;
+      // fall through
+    case 'd': case 'i':
+      switch (len) {
+        case 1: spec->type = LOGARG_LONG; break;
+        case 2: case 4: spec->type = LOGARG_LLONG; break;
+        case 3: spec->type = LOGARG_SIZE; break;
+        default: spec->type = LOGARG_INT;
+      }
+      break;
+    case 'c':
+      spec->type = (len == 0) ? LOGARG_INT : LOGARG_UNSUPPORTED;
+      break;
+    case 's':
+      spec->type = (len == 0) ? LOGARG_STRING : LOGARG_UNSUPPORTED;
+      break;
+    case 'p':
+      spec->type = LOGARG_PTR;
+      break;
+    case 'f': case 'F': case 'e': case 'E':
+    case 'g': case 'G': case 'a': case 'A':
+      spec->type = (len <= 1) ? LOGARG_DOUBLE : LOGARG_UNSUPPORTED;
+      break;
+    default:
+      spec->type = LOGARG_UNSUPPORTED;
+  }
+  return p;
+}
+
+// Stores the format string and the arguments in the entry. Returns 0 if the
+// message cannot be handled by the writer thread.
+static bool logio_encode(bx_log_entry_t *entry, const char *fmt, va_list ap)
+{
+  logio_spec_t spec;
+  size_t used = strlen(fmt) + 1;
+  const char *p = fmt;
+  int n = 0;
+
+  if (used > BX_LOG_DATA_SIZE) return 0;
+  memcpy(entry->data, fmt, used);
+  while (*p) {
+    if (*p++ != '%') continue;
+    p = logio_parse_spec(p, &spec);
+    if (spec.type == LOGARG_NONE) continue;
+    if (spec.type == LOGARG_UNSUPPORTED) return 0;
+    if ((n + spec.width_arg + spec.prec_arg) >= BX_LOG_MAX_ARGS) return 0;
+    if (spec.width_arg) entry->arg[n++].u = (Bit64s) va_arg(ap, int);
+    if (spec.prec_arg) entry->arg[n++].u = (Bit64s) va_arg(ap, int);
+    switch (spec.type) {
+      case LOGARG_INT:
+        if (spec.is_unsigned)
+          entry->arg[n].u = va_arg(ap, unsigned);
+        else
+          entry->arg[n].u = (Bit64s) va_arg(ap, int);
+        break;
+      case LOGARG_LONG:
+        if (spec.is_unsigned)
+          entry->arg[n].u = va_arg(ap, unsigned long);
+        else
+          entry->arg[n].u = (Bit64s) va_arg(ap, long);
+        break;
+      case LOGARG_LLONG:
+        entry->arg[n].u = va_arg(ap, Bit64u);
+        break;
+      case LOGARG_SIZE:
+        entry->arg[n].u = va_arg(ap, size_t);
+        break;
+      case LOGARG_DOUBLE:
+        entry->arg[n].d = va_arg(ap, double);
+        break;
+      case LOGARG_PTR:
+        entry->arg[n].u = (bx_ptr_equiv_t) va_arg(ap, void*);
+        break;
+      case LOGARG_STRING:
+        {
+          // the string may not survive the call, so keep a copy
+          const char *str = va_arg(ap, const char*);
+          if (str == NULL) {
+            entry->arg[n].u = BX_LOG_NULL_STR;
+          } else {
+            size_t len = strlen(str) + 1;
+            if ((used + len) > BX_LOG_DATA_SIZE) return 0;
+            memcpy(entry->data + used, str, len);
+            entry->arg[n].u = used;
+            used += len;
+          }
+        }
+        break;
+    }
+    n++;
+  }
+  entry->nargs = n;
+  entry->len = (Bit16u)used;
+  return 1;
+}
+
+// Formats a message stored by logio_encode() like vsnprintf() would do.
+static void logio_format(char *msg, size_t size, const bx_log_entry_t *entry)
+{
+  logio_spec_t spec;
+  char specstr[48];
+  const char *p = entry->data, *start;
+  size_t pos = 0, room;
+  int n = 0, i, ret, val;
+
+  while ((*p != 0) && (pos < (size - 1))) {
+    if (*p != '%') {
+      msg[pos++] = *p++;
+      continue;
+    }
+    start = p;
+    p = logio_parse_spec(p + 1, &spec);
+    if (spec.type == LOGARG_NONE) {
+      msg[pos++] = '%';
+      continue;
+    }
+    // rebuild the specification with '*' replaced by the argument value
+    i = 0;
+    while ((start < p) && (i < (int)(sizeof(specstr) - 12))) {
+      if (*start == '*') {
+        val = (int)(Bit64s) entry->arg[n++].u;
+        if (start[-1] != '.') {
+          i += sprintf(specstr + i, "%d", val);
+        } else if (val >= 0) {
+          i += sprintf(specstr + i, "%d", val);
+        } else {
+          i--; // negative precision is taken as if it were omitted
+        }
+        start++;
+      } else {
+        specstr[i++] = *start++;
+      }
+    }
+    specstr[i] = 0;
+    room = size - pos;
+    switch (spec.type) {
+      case LOGARG_INT:
+        if (spec.is_unsigned)
+          ret = snprintf(msg + pos, room, specstr, (unsigned) entry->arg[n].u);
+        else
+          ret = snprintf(msg + pos, room, specstr, (int)(Bit64s) entry->arg[n].u);
+        break;
+      case LOGARG_LONG:
+        if (spec.is_unsigned)
+          ret = snprintf(msg + pos, room, specstr, (unsigned long) entry->arg[n].u);
+        else
+          ret = snprintf(msg + pos, room, specstr, (long)(Bit64s) entry->arg[n].u);
+        break;
+      case LOGARG_LLONG:
+        ret = snprintf(msg + pos, room, specstr, entry->arg[n].u);
+        break;
+      case LOGARG_SIZE:
+        ret = snprintf(msg + pos, room, specstr, (size_t) entry->arg[n].u);
+        break;
+      case LOGARG_DOUBLE:
+        ret = snprintf(msg + pos, room, specstr, entry->arg[n].d);
+        break;
+      case LOGARG_PTR:
+        ret = snprintf(msg + pos, room, specstr, (void*)(bx_ptr_equiv_t) entry->arg[n].u);
+        break;
+      case LOGARG_STRING:
+        if (entry->arg[n].u == BX_LOG_NULL_STR)
+          ret = snprintf(msg + pos, room, specstr, (const char*) NULL);
+        else
+          ret = snprintf(msg + pos, room, specstr, entry->data + entry->arg[n].u);
+        break;
+      default:
+        ret = 0;
+    }
+    n++;
+    if ((ret < 0) || ((size_t)ret >= room)) {
+      pos = size - 1;
+    } else {
+      pos += ret;
+    }
+  }
+  msg[pos] = 0;
+}
+
+BX_THREAD_FUNC(log_writer_thread, indata)
+{
+  iofunctions *logio = (iofunctions*)indata;
+  int count;
+
+  while (logio->writer_running()) {
+    BX_LOCK(logio_mutex);
+    count = logio->write_pending();
+    BX_UNLOCK(logio_mutex);
+    if (count == 0) {
+      BX_MSLEEP(5);
+    }
+  }
+  logio->writer_done();
+  BX_THREAD_EXIT;
+}
+
+static void log_atexit(void)
+{
+  // write out queued messages if the process exits without exit_log()
+  if (io != NULL) {
+    io->flush();
+  }
+}
+
 const char* iofunctions::getlevel(int i) const
 {
   static const char *loglevel[N_LOGLEV] = {
@@ -75,7 +399,58 @@ int iofunctions::isaction(const char *val) const
 void iofunctions::flush(void)
 {
   if(logfd && magic == MAGIC_LOGNUM) {
+    BX_LOCK(logio_mutex);
+    write_pending();
     fflush(logfd);
+    BX_UNLOCK(logio_mutex);
+  }
+}
+
+// Writes all messages queued in the log ring. The caller must hold the
+// log mutex.
+int iofunctions::write_pending(void)
+{
+  bx_log_entry_t *entry;
+  int count = 0;
+
+  if (log_ring == NULL) return 0;
+  while (1) {
+    entry = &log_ring[log_tail & (BX_LOG_RING_SIZE - 1)];
+    if (entry->seq != (log_tail + 1)) break;
+    BX_MEMORY_BARRIER();
+    write_entry(entry);
+    BX_MEMORY_BARRIER();
+    entry->seq = log_tail + BX_LOG_RING_SIZE;
+    log_tail++;
+    count++;
+  }
+  if (count > 0) {
+    fflush(logfd);
+  }
+  return count;
+}
+
+void iofunctions::start_writer(void)
+{
+  if (async_log) return;
+  if (log_ring == NULL) {
+    log_ring = new bx_log_entry_t[BX_LOG_RING_SIZE];
+    for (Bit32u i = 0; i < BX_LOG_RING_SIZE; i++) {
+      log_ring[i].seq = i;
+    }
+    atexit(log_atexit);
+  }
+  async_log = 1;
+  writer_active = 1;
+  BX_THREAD_CREATE(log_writer_thread, this, log_writer_var);
+}
+
+void iofunctions::stop_writer(void)
+{
+  if (!async_log) return;
+  async_log = 0;
+  while (writer_active) {
+    BX_MSLEEP(1);
   }
 }
 
@@ -84,6 +459,9 @@ void iofunctions::init(void)
   // iofunctions methods must not be called before this magic
   // number is set.
   magic=MAGIC_LOGNUM;
+  logfd = NULL;
+  async_log = 0;
+  writer_active = 0;
 
   BX_INIT_MUTEX(logio_mutex);
 
@@ -141,13 +519,22 @@ void iofunctions::init_log(const char *fn)
       newfd = stderr;
     }
   }
+  flush();
+  BX_LOCK(logio_mutex);
   logfd = newfd;
   logfn = newfn;
+  BX_UNLOCK(logio_mutex);
+  // messages for a log file are written by a separate thread
+  if (logfd != stderr) {
+    start_writer();
+  }
 }
 
 void iofunctions::init_log(FILE *fs)
 {
   assert(magic==MAGIC_LOGNUM);
+  stop_writer();
+  flush();
   logfd = fs;
 
   if(fs == stderr) {
@@ -173,6 +560,7 @@ void iofunctions::init_log(int fd)
 
 void iofunctions::exit_log()
 {
+  stop_writer();
   flush();
   if (logfd != stderr) {
     fclose(logfd);
@@ -189,23 +577,17 @@ void iofunctions::exit_log()
 // 1. timer, 2. event, 3. cpu0 eip, 4. device
 void iofunctions::set_log_prefix(const char* prefix)
 {
+  BX_LOCK(logio_mutex);
   strcpy(logprefix, prefix);
+  BX_UNLOCK(logio_mutex);
 }
 
-//  iofunctions::out(level, prefix, fmt, ap)
-//  DO NOT nest out() from ::info() and the like.
-//    fmt and ap retained for direct printinf from iofunctions only!
-
-void iofunctions::out(int level, const char *prefix, const char *fmt, va_list ap)
+// Builds the prefix of a log line from the 'logprefix' template.
+static void logio_prefix(char *msgpfx, const char *logprefix, int level,
+                         const char *prefix, Bit64u ticks, Bit32u eip)
 {
-  char c = ' ', *s;
-  char tmpstr[80], msgpfx[80], msg[1024];
-
-  assert(magic==MAGIC_LOGNUM);
-  assert(this != NULL);
-  assert(logfd != NULL);
-
-  BX_LOCK(logio_mutex);
+  char c = ' ', tmpstr[80];
+  const char *s;
 
   switch (level) {
     case LOGLEV_INFO: c='i'; break;
@@ -227,11 +609,11 @@ void iofunctions::out(int level, const char *prefix, const char *fmt, va_list ap
             sprintf(tmpstr, "%s", prefix==NULL?"":prefix);
             break;
           case 't':
-            sprintf(tmpstr, FMT_TICK, bx_pc_system.time_ticks());
+            sprintf(tmpstr, FMT_TICK, ticks);
             break;
           case 'i':
 #if BX_SUPPORT_SMP == 0
-            sprintf(tmpstr, "%08x", BX_CPU(0)->get_eip());
+            sprintf(tmpstr, "%08x", eip);
 #endif
             break;
           case 'e':
@@ -250,6 +632,71 @@ void iofunctions::out(int level, const char *prefix, const char *fmt, va_list ap
     strcat(msgpfx, tmpstr);
     s++;
   }
+}
+
+void iofunctions::write_entry(const bx_log_entry_t *entry)
+{
+  char msgpfx[80], msg[1024];
+
+  logio_prefix(msgpfx, logprefix, entry->level, entry->prefix, entry->ticks, entry->eip);
+  logio_format(msg, sizeof(msg), entry);
+  fprintf(logfd, "%s %s\n", msgpfx, msg);
+}
+
+//  iofunctions::out(level, prefix, fmt, ap)
+//  DO NOT nest out() from ::info() and the like.
+//    fmt and ap retained for direct printinf from iofunctions only!
+
+void iofunctions::out(int level, const char *prefix, const char *fmt, va_list ap)
+{
+  char msgpfx[80], msg[1024];
+  Bit32u eip = 0;
+
+  assert(magic==MAGIC_LOGNUM);
+  assert(this != NULL);
+  assert(logfd != NULL);
+
+#if BX_SUPPORT_SMP == 0
+  eip = BX_CPU(0)->get_eip();
+#endif
+
+  if (async_log && (level != LOGLEV_PANIC) && !SIM->has_log_viewer()) {
+    bx_log_entry_t entry;
+    va_list aq;
+
+    va_copy(aq, ap);
+    bool queued = logio_encode(&entry, fmt, aq);
+    va_end(aq);
+    if (queued) {
+      entry.level = (Bit8u)level;
+      entry.eip = eip;
+      entry.ticks = bx_pc_system.time_ticks();
+      if (prefix == NULL) {
+        entry.prefix[0] = 0;
+      } else {
+        strncpy(entry.prefix, prefix, sizeof(entry.prefix) - 1);
+        entry.prefix[sizeof(entry.prefix) - 1] = 0;
+      }
+      Bit32u pos = BX_ATOMIC_FETCH_INC(log_head);
+      bx_log_entry_t *slot = &log_ring[pos & (BX_LOG_RING_SIZE - 1)];
+      // ring is full: wait for the writer thread
+      while (slot->seq != pos) {
+        BX_MSLEEP(1);
+      }
+      memcpy((Bit8u*)slot + offsetof(bx_log_entry_t, level), &entry.level,
+             offsetof(bx_log_entry_t, data) - offsetof(bx_log_entry_t, level) + entry.len);
+      BX_MEMORY_BARRIER();
+      slot->seq = pos + 1;
+      return;
+    }
+  }
+
+  BX_LOCK(logio_mutex);
+
+  // keep the order of the log file
+  write_pending();
+
+  logio_prefix(msgpfx, logprefix, level, prefix, bx_pc_system.time_ticks(), eip);
 
   fprintf(logfd,"%s ", msgpfx);
 
@@ -290,11 +737,12 @@ iofunctions::iofunctions()
 
 iofunctions::~iofunctions(void)
 {
-  BX_FINI_MUTEX(logio_mutex);
-
+  stop_writer();
   // flush before erasing magic number, or flush does nothing.
   flush();
   magic=0;
+
+  BX_FINI_MUTEX(logio_mutex);
 }
 
 #define LOG_THIS genlog->
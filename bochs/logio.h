@@ -90,13 +90,20 @@ public:
 
 #define BX_LOGPREFIX_LEN 20
 
+struct bx_log_entry_t;
+
 class BOCHSAPI iofunctions {
   int magic;
   char logprefix[BX_LOGPREFIX_LEN + 1];
   FILE *logfd;
   class logfunctions *log;
+  // set while the log file is written by the background writer thread
+  volatile bool async_log;
+  volatile bool writer_active;
   void init(void);
-  void flush(void);
+  void start_writer(void);
+  void stop_writer(void);
+  void write_entry(const bx_log_entry_t *entry);
 
 // Log Class types
 public:
@@ -107,6 +114,11 @@ public:
  ~iofunctions(void);
 
   void out(int level, const char *pre, const char *fmt, va_list ap);
+  void flush(void);
+  // used by the log writer thread
+  bool writer_running() const { return async_log; }
+  void writer_done() { writer_active = 0; }
+  int write_pending(void);
 
   void init_log(const char *fn);
   void init_log(int fd);
@@ -33,6 +33,7 @@
 #if BX_SUPPORT_PCIUSB
 #include "iodev/usb/usb_common.h"
 #endif
+#include "replay.h"
 
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
@@ -1170,6 +1171,9 @@ void bx_init_hardware()
 
   io->set_log_prefix(SIM->get_param_string(BXPN_LOG_PREFIX)->getptr());
 
+  // open the record/replay journal before any host input is read
+  bx_replay.init();
+
   // Output to the log file the cpu and device settings
   // This will by handy for bug reports
   BX_INFO(("Bochs x86 Emulator %s", VERSION));
@@ -1444,6 +1448,7 @@ int bx_atexit(void)
   BX_MEM(0)->cleanup_memory();
 
   bx_pc_system.exit();
+  bx_replay.exit();
 
   // restore signal handling to defaults
 #if BX_DEBUGGER == 0
@@ -144,6 +144,10 @@ public:
   BX_MEM_SMF void    dmaReadPhysicalPage(bx_phy_address addr, unsigned len, Bit8u *data);
   BX_MEM_SMF void    dmaWritePhysicalPage(bx_phy_address addr, unsigned len, Bit8u *data);
 
+  // Direct device access to guest RAM, see memory.cc
+  BX_MEM_SMF Bit8u*  getHostDmaAddr(bx_phy_address addr, unsigned len, unsigned rw);
+  BX_MEM_SMF void    dmaWriteNotify(bx_phy_address addr, unsigned len);
+
   BX_MEM_SMF void    load_ROM(const char *path, bx_phy_address romaddress, Bit8u type);
   BX_MEM_SMF void    load_RAM(const char *path, bx_phy_address romaddress);
 
@@ -470,3 +470,45 @@ void BX_MEM_C::dmaWritePhysicalPage(bx_phy_address addr, unsigned len, Bit8u *da
     }
   }
 }
+
+// Returns a host pointer through which a device can access the guest
+// physical range addr .. addr+len-1 in place, or NULL if the range is not
+// backed by one contiguous piece of host memory; the caller then has to
+// use dma{Read,Write}PhysicalPage(). The range may span pages. The pointer
+// stays valid until the memory configuration changes. After writing through
+// it, the device must call dmaWriteNotify() for the range.
+Bit8u *BX_MEM_C::getHostDmaAddr(bx_phy_address addr, unsigned len, unsigned rw)
+{
+#if BX_LARGE_RAMFILE
+  // blocks may be swapped out while the pointer is in use
+  return NULL;
+#else
+  if (len == 0) return NULL;
+
+  Bit8u *memptr = getHostMemAddr(NULL, addr, rw);
+  if (memptr == NULL) return NULL;
+
+  bx_phy_address page = (addr & ~(bx_phy_address)0xfff) + 0x1000;
+  for (; page < addr + len; page += 0x1000) {
+    if (getHostMemAddr(NULL, page, rw) != memptr + (page - addr))
+      return NULL;
+  }
+  return memptr;
+#endif
+}
+
+// Tells the CPUs that a device wrote the given range through a pointer
+// from getHostDmaAddr().
+void BX_MEM_C::dmaWriteNotify(bx_phy_address addr, unsigned len)
+{
+  while (len > 0) {
+    unsigned remainingInPage = 0x1000 - (addr & 0xfff);
+    if (len < remainingInPage) remainingInPage = len;
+#if BX_SUPPORT_MONITOR_MWAIT
+    BX_MEM_THIS check_monitor(A20ADDR(addr), remainingInPage);
+#endif
+    pageWriteStampTable.decWriteStamp(A20ADDR(addr));
+    addr += remainingInPage;
+    len -= remainingInPage;
+  }
+}
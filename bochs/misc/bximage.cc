@@ -39,6 +39,7 @@
 
 #include "osdep.h"
 #include "bswap.h"
+#include "bxthread.h"
 
 #include "iodev/hdimage/hdimage.h"
 #include "iodev/hdimage/vmware3.h"
@@ -55,6 +56,11 @@
 
 #define BX_MAX_CYL_BITS 24 // 8 TB
 
+// image conversion is done in chunks of this size by a reader thread and the
+// main thread writing the data
+#define BXIMAGE_COPY_CHUNK   0x100000
+#define BXIMAGE_COPY_BUFFERS 8
+
 const int bx_max_hd_megs = (int)(((1 << BX_MAX_CYL_BITS) - 1) * 16.0 * 63.0 / 2048.0);
 
 int  bximage_func;
@@ -419,12 +425,83 @@ device_image_t* create_hard_disk_image(const char *filename, const char *imgmode
   return hdimage;
 }
 
+typedef struct {
+  Bit8u  *buffer;
+  Bit64u  offset;
+  Bit64u  len;
+  bool    data;
+  bool    error;
+  bool    full;
+} copy_chunk_t;
+
+copy_chunk_t copy_chunk[BXIMAGE_COPY_BUFFERS];
+bool copy_abort;
+BX_MUTEX(copy_mutex);
+BX_COND(copy_chunk_filled);
+BX_COND(copy_chunk_emptied);
+BX_THREAD_VAR(copy_reader_var);
+
+// Reads the source image ahead of the main thread. Ranges not allocated in
+// the source image are passed on without data, so they are skipped.
+BX_THREAD_FUNC(copy_reader_thread, indata)
+{
+  device_image_t *image = (device_image_t*)indata;
+  copy_chunk_t *chunk;
+  Bit64u offset = 0, len;
+  unsigned head = 0;
+  bool abort;
+
+  while (1) {
+    chunk = &copy_chunk[head % BXIMAGE_COPY_BUFFERS];
+    BX_LOCK(copy_mutex);
+    while (chunk->full && !copy_abort) {
+      BX_COND_WAIT(copy_chunk_emptied, copy_mutex);
+    }
+    abort = copy_abort;
+    BX_UNLOCK(copy_mutex);
+    if (abort) break;
+    chunk->offset = offset;
+    chunk->len = 0;
+    chunk->data = 0;
+    chunk->error = 0;
+    if (offset < image->hd_size) {
+      chunk->data = image->is_allocated(offset, &len);
+      if ((len == 0) || (len > (image->hd_size - offset))) {
+        len = image->hd_size - offset;
+      }
+      if (chunk->data && (len > BXIMAGE_COPY_CHUNK)) {
+        len = BXIMAGE_COPY_CHUNK;
+      }
+      if (chunk->data) {
+        if ((image->lseek(offset, SEEK_SET) < 0) ||
+            (image->read(chunk->buffer, (size_t)len) != (ssize_t)len)) {
+          chunk->error = 1;
+        }
+      }
+      chunk->len = len;
+      offset += len;
+    }
+    // a chunk without length marks the end of the image
+    abort = (chunk->len == 0) || chunk->error;
+    BX_LOCK(copy_mutex);
+    chunk->full = 1;
+    BX_COND_SIGNAL(copy_chunk_filled);
+    BX_UNLOCK(copy_mutex);
+    if (abort) break;
+    head++;
+  }
+  BX_THREAD_EXIT;
+}
+
 void convert_image(const char *newimgmode, Bit64u newsize)
 {
   device_image_t *source_image, *dest_image;
-  Bit64u i, sc, s;
-  char buffer[512], null_sector[512];
+  copy_chunk_t *chunk;
+  Bit64u i, run;
+  char null_sector[512];
   const char *imgmode = NULL;
+  unsigned tail = 0;
+  int percent = 0;
   bool error = false;
 
   printf("\n");
@@ -466,27 +543,72 @@ void convert_image(const char *newimgmode, Bit64u newsize)
 
   printf("\nConverting image file: [  0%%]");
 
-  sc = source_image->hd_size / 512;
-  s = 0;
-  for (i = 0; i < source_image->hd_size; i+=512) {
-    printf("\x8\x8\x8\x8\x8%3d%%]", (int)((s+1)*100/sc));
-    fflush(stdout);
-    if (source_image->lseek(i, SEEK_SET) < 0) {
+  for (i = 0; i < BXIMAGE_COPY_BUFFERS; i++) {
+    copy_chunk[i].buffer = new Bit8u[BXIMAGE_COPY_CHUNK];
+    copy_chunk[i].full = 0;
+  }
+  copy_abort = 0;
+  BX_INIT_MUTEX(copy_mutex);
+  BX_INIT_COND(copy_chunk_filled);
+  BX_INIT_COND(copy_chunk_emptied);
+  BX_THREAD_CREATE(copy_reader_thread, source_image, copy_reader_var);
+
+  while (1) {
+    chunk = &copy_chunk[tail % BXIMAGE_COPY_BUFFERS];
+    BX_LOCK(copy_mutex);
+    while (!chunk->full) {
+      BX_COND_WAIT(copy_chunk_filled, copy_mutex);
+    }
+    BX_UNLOCK(copy_mutex);
+    if (chunk->error) {
       error = true;
       break;
     }
-    if ((source_image->read(buffer, 512) == 512) &&
-        (memcmp(buffer, null_sector, 512) != 0)) {
-      if (dest_image->lseek(i, SEEK_SET) < 0) {
-        error = true;
-        break;
-      }
-      if (dest_image->write(buffer, 512) < 0) {
-        error = true;
-        break;
+    if (chunk->len == 0) {
+      break;
+    }
+    if (chunk->data) {
+      // write runs of sectors containing data
+      for (i = 0; i < chunk->len; i += run) {
+        run = 512;
+        if (memcmp(chunk->buffer + i, null_sector, 512) == 0) {
+          continue;
+        }
+        while (((i + run) < chunk->len) &&
+               (memcmp(chunk->buffer + i + run, null_sector, 512) != 0)) {
+          run += 512;
+        }
+        if ((dest_image->lseek(chunk->offset + i, SEEK_SET) < 0) ||
+            (dest_image->write(chunk->buffer + i, (size_t)run) < 0)) {
+          error = true;
+          break;
+        }
       }
+      if (error) break;
     }
-    s++;
+    if ((int)((chunk->offset + chunk->len) * 100 / source_image->hd_size) != percent) {
+      percent = (int)((chunk->offset + chunk->len) * 100 / source_image->hd_size);
+      printf("\x8\x8\x8\x8\x8%3d%%]", percent);
+      fflush(stdout);
+    }
+    BX_LOCK(copy_mutex);
+    chunk->full = 0;
+    BX_COND_SIGNAL(copy_chunk_emptied);
+    BX_UNLOCK(copy_mutex);
+    tail++;
+  }
+
+  // stop the reader if it is still waiting for a free chunk
+  BX_LOCK(copy_mutex);
+  copy_abort = 1;
+  BX_COND_SIGNAL(copy_chunk_emptied);
+  BX_UNLOCK(copy_mutex);
+  BX_THREAD_JOIN(copy_reader_var);
+  BX_FINI_COND(copy_chunk_filled);
+  BX_FINI_COND(copy_chunk_emptied);
+  BX_FINI_MUTEX(copy_mutex);
+  for (i = 0; i < BXIMAGE_COPY_BUFFERS; i++) {
+    delete [] copy_chunk[i].buffer;
   }
 
   source_image->close();
@@ -23,6 +23,7 @@
 #include "bochs.h"
 #include "cpu/cpu.h"
 #include "iodev/iodev.h"
+#include "replay.h"
 #define LOG_THIS bx_pc_system.
 
 #if defined(PROVIDE_M_IPS)
@@ -373,12 +374,17 @@ void bx_pc_system_c::countdownEvent(void)
   currCountdown = currCountdownPeriod =
       Bit32u(minTimeToFire - ticksTotal);
 
+  // Inject replayed host input that was recorded outside of timer handlers.
+  bx_replay.countdown();
+
   for (i = first; i <= last; i++) {
     // Call requested timer function.  It may request a different
     // timer period or deactivate etc.
     if (triggered[i] && (timer[i].funct != NULL)) {
       triggeredTimer = i;
       timer[i].funct(timer[i].this_ptr);
+      // Inject replayed host input that this handler received when recording.
+      bx_replay.sync_point();
       triggeredTimer = 0;
     }
   }
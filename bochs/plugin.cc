@@ -995,6 +995,9 @@ plugin_t bx_builtin_plugins[] = {
 #if BX_WITH_SDL2
   BUILTIN_GUI_PLUGIN_ENTRY(sdl2),
 #endif
+#if BX_WITH_SHMFB
+  BUILTIN_GUI_PLUGIN_ENTRY(shmfb),
+#endif
 #if BX_WITH_TERM
   BUILTIN_GUI_PLUGIN_ENTRY(term),
 #endif
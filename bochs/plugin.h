@@ -452,6 +452,7 @@ PLUGIN_ENTRY_FOR_GUI_MODULE(nogui);
 PLUGIN_ENTRY_FOR_GUI_MODULE(rfb);
 PLUGIN_ENTRY_FOR_GUI_MODULE(sdl);
 PLUGIN_ENTRY_FOR_GUI_MODULE(sdl2);
+PLUGIN_ENTRY_FOR_GUI_MODULE(shmfb);
 PLUGIN_ENTRY_FOR_GUI_MODULE(term);
 PLUGIN_ENTRY_FOR_GUI_MODULE(vncsrv);
 PLUGIN_ENTRY_FOR_GUI_MODULE(win32);
@@ -0,0 +1,426 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "bochs.h"
+#include "iodev/iodev.h"
+#include "replay.h"
+
+#define LOG_THIS bx_replay.
+
+bx_replay_c bx_replay;
+
+// Journal layout: a 16 byte header ("BXRPLAY\0", version, ips as 32-bit
+// little endian values) followed by records. Each record starts with a
+// type byte and varint(tick - tick of the previous record). Asynchronous
+// records (type < 0x80) continue with varint(timer id), then the payload:
+//
+//   KEY     varint(key)
+//   MOUSE   svarint(dx), svarint(dy), svarint(dz), varint(buttons),
+//           varint(absxy)
+//   NET     varint(netdev), varint(length), frame data
+//   VALUE   varint(kind), varint(value)
+//   SERIAL  varint(port), varint(data)
+
+#define BX_REPLAY_MAGIC       "BXRPLAY"
+#define BX_REPLAY_VERSION     1
+#define BX_REPLAY_HEADER_SIZE 16
+#define BX_REPLAY_MAX_DATA    65536
+
+#define BX_REPLAY_REC_SYNC    0x80
+#define BX_REPLAY_REC_KEY     0x01
+#define BX_REPLAY_REC_MOUSE   0x02
+#define BX_REPLAY_REC_NET     0x03
+#define BX_REPLAY_REC_VALUE   0x80
+#define BX_REPLAY_REC_SERIAL  0x81
+
+static bool replay_get_varint(FILE *fp, Bit64u *val)
+{
+  Bit64u result = 0;
+  int b;
+
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if ((b = getc(fp)) == EOF)
+      return 0;
+    result |= (Bit64u)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *val = result;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static bool replay_get_svarint(FILE *fp, Bit32s *val)
+{
+  Bit64u u;
+
+  if (!replay_get_varint(fp, &u))
+    return 0;
+  *val = (Bit32s)((Bit64s)(u >> 1) ^ -(Bit64s)(u & 1));
+  return 1;
+}
+
+bx_replay_c::bx_replay_c()
+{
+  put("replay", "RPLY");
+  mode = BX_REPLAY_MODE_NONE;
+  journal = NULL;
+  last_tick = 0;
+  nrecords = 0;
+  divergence = 0;
+  memset(&async_in, 0, sizeof(async_in));
+  memset(&sync_in, 0, sizeof(sync_in));
+  sync_in.sync = 1;
+  num_netdevs = 0;
+}
+
+void bx_replay_c::init(void)
+{
+  bx_list_c *base = (bx_list_c*) SIM->get_param(BXPN_REPLAY);
+  unsigned new_mode = SIM->get_param_enum("mode", base)->get();
+  const char *fname = SIM->get_param_string("file", base)->getptr();
+  Bit32u ips = (Bit32u)SIM->get_param_num(BXPN_IPS)->get();
+  Bit32u header[BX_REPLAY_HEADER_SIZE / 4];
+
+  if (new_mode == BX_REPLAY_MODE_NONE)
+    return;
+  if (SIM->get_param_bool(BXPN_RESTORE_FLAG)->get()) {
+    BX_ERROR(("record/replay is not supported when restoring a saved state"));
+    return;
+  }
+  if (new_mode == BX_REPLAY_MODE_RECORD) {
+    journal = fopen(fname, "wb");
+    if (journal == NULL) {
+      BX_PANIC(("cannot create replay journal '%s'", fname));
+      return;
+    }
+    memset(header, 0, sizeof(header));
+    memcpy(header, BX_REPLAY_MAGIC, strlen(BX_REPLAY_MAGIC));
+    WriteHostDWordToLittleEndian(&header[2], BX_REPLAY_VERSION);
+    WriteHostDWordToLittleEndian(&header[3], ips);
+    fwrite(header, 1, sizeof(header), journal);
+    BX_INFO(("recording host input to '%s'", fname));
+    mode = new_mode;
+  } else {
+    async_in.fp = fopen(fname, "rb");
+    sync_in.fp = fopen(fname, "rb");
+    if ((async_in.fp == NULL) || (sync_in.fp == NULL)) {
+      BX_PANIC(("cannot open replay journal '%s'", fname));
+      finish();
+      return;
+    }
+    if ((fread(header, 1, sizeof(header), async_in.fp) != sizeof(header)) ||
+        (memcmp(header, BX_REPLAY_MAGIC, strlen(BX_REPLAY_MAGIC) + 1) != 0) ||
+        (ReadHostDWordFromLittleEndian(&header[2]) != BX_REPLAY_VERSION)) {
+      BX_PANIC(("'%s' is not a replay journal", fname));
+      finish();
+      return;
+    }
+    if (ReadHostDWordFromLittleEndian(&header[3]) != ips) {
+      BX_ERROR(("journal was recorded with a different ips value"));
+    }
+    fseek(sync_in.fp, BX_REPLAY_HEADER_SIZE, SEEK_SET);
+    async_in.data = new Bit8u[BX_REPLAY_MAX_DATA];
+    BX_INFO(("replaying host input from '%s'", fname));
+    read_record(&async_in);
+    read_record(&sync_in);
+    mode = new_mode;
+  }
+}
+
+void bx_replay_c::exit(void)
+{
+  if (mode == BX_REPLAY_MODE_RECORD) {
+    BX_INFO(("%u records written to the replay journal", (unsigned)nrecords));
+  } else if (mode == BX_REPLAY_MODE_REPLAY) {
+    BX_INFO(("replay stopped before the end of the journal"));
+  }
+  finish();
+}
+
+void bx_replay_c::finish(void)
+{
+  if (journal != NULL) {
+    fclose(journal);
+    journal = NULL;
+  }
+  if (async_in.fp != NULL) {
+    fclose(async_in.fp);
+    async_in.fp = NULL;
+  }
+  if (sync_in.fp != NULL) {
+    fclose(sync_in.fp);
+    sync_in.fp = NULL;
+  }
+  if (async_in.data != NULL) {
+    delete [] async_in.data;
+    async_in.data = NULL;
+  }
+  async_in.valid = 0;
+  sync_in.valid = 0;
+  mode = BX_REPLAY_MODE_NONE;
+}
+
+void bx_replay_c::write_varint(Bit64u val)
+{
+  while (val >= 0x80) {
+    putc((int)(val & 0x7f) | 0x80, journal);
+    val >>= 7;
+  }
+  putc((int)val, journal);
+}
+
+void bx_replay_c::write_svarint(Bit64s val)
+{
+  write_varint(((Bit64u)val << 1) ^ (Bit64u)(val >> 63));
+}
+
+void bx_replay_c::write_record(Bit8u type)
+{
+  Bit64u now = bx_pc_system.time_ticks();
+
+  putc(type, journal);
+  write_varint(now - last_tick);
+  if (!(type & BX_REPLAY_REC_SYNC)) {
+    write_varint(bx_pc_system.triggeredTimerID());
+  }
+  last_tick = now;
+  nrecords++;
+}
+
+// Reads the next record for the cursor and skips the records of the other
+// class. Returns 0 at the end of the journal.
+bool bx_replay_c::read_record(bx_replay_cursor_t *c)
+{
+  Bit64u delta, tmp = 0, tmp2 = 0;
+  int type;
+  bool ok;
+
+  c->valid = 0;
+  while ((type = getc(c->fp)) != EOF) {
+    if (!replay_get_varint(c->fp, &delta))
+      break;
+    c->last_tick += delta;
+    c->type = (Bit8u)type;
+    c->tick = c->last_tick;
+    ok = 1;
+    if (!(type & BX_REPLAY_REC_SYNC)) {
+      ok = replay_get_varint(c->fp, &tmp);
+      c->timer = (unsigned)tmp;
+    }
+    switch (type) {
+      case BX_REPLAY_REC_KEY:
+        ok = ok && replay_get_varint(c->fp, &c->value);
+        break;
+      case BX_REPLAY_REC_MOUSE:
+        ok = ok && replay_get_svarint(c->fp, &c->arg[0]) &&
+             replay_get_svarint(c->fp, &c->arg[1]) &&
+             replay_get_svarint(c->fp, &c->arg[2]) &&
+             replay_get_varint(c->fp, &c->value) &&
+             replay_get_varint(c->fp, &tmp);
+        c->channel = (unsigned)tmp;
+        break;
+      case BX_REPLAY_REC_NET:
+        ok = ok && replay_get_varint(c->fp, &tmp) && replay_get_varint(c->fp, &tmp2) &&
+             (tmp2 <= BX_REPLAY_MAX_DATA);
+        if (ok) {
+          c->channel = (unsigned)tmp;
+          c->len = (unsigned)tmp2;
+          if (c->sync) {
+            ok = (fseek(c->fp, c->len, SEEK_CUR) == 0);
+          } else {
+            ok = (fread(c->data, 1, c->len, c->fp) == c->len);
+          }
+        }
+        break;
+      case BX_REPLAY_REC_VALUE:
+      case BX_REPLAY_REC_SERIAL:
+        ok = ok && replay_get_varint(c->fp, &tmp) && replay_get_varint(c->fp, &c->value);
+        c->channel = (unsigned)tmp;
+        break;
+      default:
+        ok = 0;
+    }
+    if (!ok) {
+      BX_ERROR(("replay journal is truncated or corrupted"));
+      break;
+    }
+    if (((type & BX_REPLAY_REC_SYNC) != 0) == c->sync) {
+      c->valid = 1;
+      return 1;
+    }
+  }
+  if (!async_in.valid && !sync_in.valid && (mode == BX_REPLAY_MODE_REPLAY)) {
+    BX_INFO(("end of replay journal reached at tick " FMT_LL "u, using live input",
+             bx_pc_system.time_ticks()));
+    finish();
+  }
+  return 0;
+}
+
+void bx_replay_c::diverged(const char *what, Bit64u tick)
+{
+  if (!divergence) {
+    BX_ERROR(("replay diverged from the journal: %s recorded at tick " FMT_LL "u, now at " FMT_LL "u",
+              what, tick, bx_pc_system.time_ticks()));
+    divergence = 1;
+  }
+}
+
+// Returns 1 if the next host value in the journal matches the request.
+// Values that should have been requested earlier are dropped.
+bool bx_replay_c::next_value(Bit8u type, Bit64u channel)
+{
+  Bit64u now = bx_pc_system.time_ticks();
+
+  while (sync_in.valid && (sync_in.tick < now)) {
+    diverged("host input", sync_in.tick);
+    read_record(&sync_in);
+  }
+  return (sync_in.valid && (sync_in.tick == now) && (sync_in.type == type) &&
+          (sync_in.channel == channel));
+}
+
+Bit64u bx_replay_c::host_value(unsigned kind, Bit64u value)
+{
+  if (mode == BX_REPLAY_MODE_RECORD) {
+    write_record(BX_REPLAY_REC_VALUE);
+    write_varint(kind);
+    write_varint(value);
+  } else if (mode == BX_REPLAY_MODE_REPLAY) {
+    if (next_value(BX_REPLAY_REC_VALUE, kind)) {
+      value = sync_in.value;
+      read_record(&sync_in);
+    } else if (sync_in.valid) {
+      diverged("host value", sync_in.tick);
+    }
+  }
+  return value;
+}
+
+bool bx_replay_c::serial_rx(unsigned port, bool ready, Bit8u *data)
+{
+  if (mode == BX_REPLAY_MODE_RECORD) {
+    if (ready) {
+      write_record(BX_REPLAY_REC_SERIAL);
+      write_varint(port);
+      write_varint(*data);
+    }
+  } else if (mode == BX_REPLAY_MODE_REPLAY) {
+    ready = next_value(BX_REPLAY_REC_SERIAL, port);
+    if (ready) {
+      *data = (Bit8u)sync_in.value;
+      read_record(&sync_in);
+    }
+  }
+  return ready;
+}
+
+void bx_replay_c::key_event(Bit32u key)
+{
+  if (mode == BX_REPLAY_MODE_RECORD) {
+    write_record(BX_REPLAY_REC_KEY);
+    write_varint(key);
+  }
+}
+
+void bx_replay_c::mouse_event(int delta_x, int delta_y, int delta_z, unsigned button_state, bool absxy)
+{
+  if (mode == BX_REPLAY_MODE_RECORD) {
+    write_record(BX_REPLAY_REC_MOUSE);
+    write_svarint(delta_x);
+    write_svarint(delta_y);
+    write_svarint(delta_z);
+    write_varint(button_state);
+    write_varint(absxy);
+  }
+}
+
+int bx_replay_c::register_netdev(void *dev, bx_replay_rx_handler_t rxh)
+{
+  if (num_netdevs >= BX_REPLAY_MAX_NETDEV) {
+    BX_PANIC(("too many network devices for record/replay"));
+    return -1;
+  }
+  netdev[num_netdevs].dev = dev;
+  netdev[num_netdevs].rxh = rxh;
+  return num_netdevs++;
+}
+
+void bx_replay_c::net_rx(void *dev, const void *buf, unsigned len)
+{
+  unsigned n;
+
+  for (n = 0; n < num_netdevs; n++) {
+    if (netdev[n].dev == dev) break;
+  }
+  if (n == num_netdevs) {
+    BX_PANIC(("net_rx(): unknown network device"));
+    return;
+  }
+  if (mode == BX_REPLAY_MODE_RECORD) {
+    write_record(BX_REPLAY_REC_NET);
+    write_varint(n);
+    write_varint(len);
+    fwrite(buf, 1, len, journal);
+  } else if (mode == BX_REPLAY_MODE_REPLAY) {
+    return; // live frames are dropped, the journaled ones are injected
+  }
+  netdev[n].rxh(netdev[n].dev, buf, len);
+}
+
+// Injects the asynchronous events recorded at the current tick by the
+// current timer handler (or outside of any handler). Events from earlier
+// ticks are injected late; with 'late' set only those are handled.
+void bx_replay_c::deliver(bool late)
+{
+  Bit64u now = bx_pc_system.time_ticks();
+  unsigned timer = bx_pc_system.triggeredTimerID();
+  bx_replay_cursor_t *c = &async_in;
+
+  while (c->valid && (c->tick <= now)) {
+    if (c->tick == now) {
+      if (late || (c->timer != timer)) break;
+    } else if (c->timer != 0) {
+      // events recorded outside of a timer handler may arrive late, others
+      // should have been injected at their tick
+      diverged("input event", c->tick);
+    }
+    switch (c->type) {
+      case BX_REPLAY_REC_KEY:
+        bx_devices.send_scancode((Bit32u)c->value);
+        break;
+      case BX_REPLAY_REC_MOUSE:
+        bx_devices.send_mouse_event(c->arg[0], c->arg[1], c->arg[2], (unsigned)c->value,
+                                    c->channel != 0);
+        break;
+      case BX_REPLAY_REC_NET:
+        if (c->channel < num_netdevs) {
+          netdev[c->channel].rxh(netdev[c->channel].dev, c->data, c->len);
+        } else {
+          diverged("network frame", c->tick);
+        }
+        break;
+    }
+    if (!read_record(c)) break;
+  }
+}
@@ -0,0 +1,127 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Deterministic record / replay of the inputs coming from the host.
+//
+// With the same configuration and disk images, a simulation only differs
+// between two runs by the data the host feeds into it: keyboard and mouse
+// events from the gui, received network frames, serial port input and
+// host clock readings. In record mode these inputs are written to a
+// journal together with the emulated tick count. In replay mode the live
+// inputs are dropped and the journaled ones are injected at the same ticks.
+//
+// Inputs that arrive asynchronously (gui events, network frames) are keyed
+// by the tick count and the pc_system timer whose handler produced them.
+// During replay they are injected right after that timer handler returns,
+// or at a sync point like a network send. Values the simulation asks the
+// host for (clock, random seed, serial input) are returned from the
+// journal in the order they were recorded.
+
+#ifndef BX_REPLAY_H
+#define BX_REPLAY_H
+
+#define BX_REPLAY_MODE_NONE   0
+#define BX_REPLAY_MODE_RECORD 1
+#define BX_REPLAY_MODE_REPLAY 2
+
+// kinds of host values passed through host_value()
+#define BX_REPLAY_VAL_REALTIME 0  // elapsed host time (virtual timer)
+#define BX_REPLAY_VAL_TIME0    1  // initial CMOS clock time
+#define BX_REPLAY_VAL_SEED     2  // random generator seed
+
+#define BX_REPLAY_MAX_NETDEV   16
+
+typedef void (*bx_replay_rx_handler_t)(void *dev, const void *buf, unsigned len);
+
+typedef struct {
+  FILE *fp;
+  bool sync;          // this cursor reads host values, not async events
+  bool valid;         // the record below is valid
+  Bit64u last_tick;   // tick of the last record read by this cursor
+  Bit8u type;
+  Bit64u tick;
+  unsigned timer;
+  unsigned channel;
+  Bit64u value;
+  Bit32s arg[3];
+  unsigned len;
+  Bit8u *data;
+} bx_replay_cursor_t;
+
+class BOCHSAPI bx_replay_c : public logfunctions {
+public:
+  bx_replay_c();
+  virtual ~bx_replay_c() {}
+  void init(void);
+  void exit(void);
+
+  bool recording(void) const { return mode == BX_REPLAY_MODE_RECORD; }
+  bool replaying(void) const { return mode == BX_REPLAY_MODE_REPLAY; }
+
+  // Values read from the host at deterministic points. In record mode
+  // 'value' is journaled and returned, in replay mode the journaled value
+  // is returned instead.
+  Bit64u host_value(unsigned kind, Bit64u value);
+  bool serial_rx(unsigned port, bool ready, Bit8u *data);
+
+  // asynchronous inputs
+  void key_event(Bit32u key);
+  void mouse_event(int delta_x, int delta_y, int delta_z, unsigned button_state, bool absxy);
+  int  register_netdev(void *dev, bx_replay_rx_handler_t rxh);
+  void net_rx(void *dev, const void *buf, unsigned len);
+
+  // Called after each timer handler and from other sync points to inject
+  // the events that were recorded there.
+  BX_CPP_INLINE void sync_point(void) {
+    if (mode == BX_REPLAY_MODE_REPLAY) deliver(0);
+  }
+  // Called at each timer countdown to catch events that have no sync point.
+  BX_CPP_INLINE void countdown(void) {
+    if (mode == BX_REPLAY_MODE_REPLAY) deliver(1);
+  }
+
+private:
+  void write_record(Bit8u type);
+  void write_varint(Bit64u val);
+  void write_svarint(Bit64s val);
+  bool read_record(bx_replay_cursor_t *c);
+  bool next_value(Bit8u type, Bit64u channel);
+  void deliver(bool late);
+  void diverged(const char *what, Bit64u tick);
+  void finish(void);
+
+  unsigned mode;
+  FILE *journal;
+  Bit64u last_tick;
+  Bit64u nrecords;
+  bool divergence;
+  bx_replay_cursor_t async_in, sync_in;
+  unsigned num_netdevs;
+  struct {
+    void *dev;
+    bx_replay_rx_handler_t rxh;
+  } netdev[BX_REPLAY_MAX_NETDEV];
+};
+
+BOCHSAPI extern bx_replay_c bx_replay;
+
+#endif
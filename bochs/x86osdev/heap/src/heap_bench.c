@@ -0,0 +1,61 @@
+// heap_bench.c -- Times kmalloc and kfree as the kernel heap fills
+//                 up and gets fragmented.
+
+#include "heap_bench.h"
+#include "kheap.h"
+#include "monitor.h"
+
+#define BENCH_BLOCKS 4096
+#define BENCH_ROUNDS 8
+#define BENCH_PER_ROUND (BENCH_BLOCKS/BENCH_ROUNDS)
+
+static u32int blocks[BENCH_BLOCKS];
+static u32int seed = 1;
+
+static u32int bench_rand()
+{
+    seed = seed*1103515245 + 12345;
+    return seed >> 16;
+}
+
+static u32int rdtsc()
+{
+    u32int lo, hi;
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+void heap_benchmark()
+{
+    u32int round, i, t;
+
+    monitor_write("\nheap benchmark: cycles per call\n");
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        u32int first = round*BENCH_PER_ROUND;
+
+        // Allocate a round of blocks of random small sizes...
+        t = rdtsc();
+        for (i = first; i < first+BENCH_PER_ROUND; i++)
+            blocks[i] = kmalloc(8 + bench_rand()%512);
+        u32int alloc_cycles = rdtsc() - t;
+
+        // ...and free every other one, leaving holes behind.
+        t = rdtsc();
+        for (i = first; i < first+BENCH_PER_ROUND; i += 2)
+            kfree((void*)blocks[i]);
+        u32int free_cycles = rdtsc() - t;
+
+        monitor_write("blocks ");
+        monitor_write_dec(first + BENCH_PER_ROUND);
+        monitor_write(": kmalloc ");
+        monitor_write_dec(alloc_cycles/BENCH_PER_ROUND);
+        monitor_write(", kfree ");
+        monitor_write_dec(free_cycles/(BENCH_PER_ROUND/2));
+        monitor_write("\n");
+    }
+
+    // Give everything back.
+    for (i = 1; i < BENCH_BLOCKS; i += 2)
+        kfree((void*)blocks[i]);
+}
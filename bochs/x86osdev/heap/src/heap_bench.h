@@ -0,0 +1,15 @@
+// heap_bench.h -- Interface for the kernel heap benchmark.
+
+#ifndef HEAP_BENCH_H
+#define HEAP_BENCH_H
+
+#include "common.h"
+
+/**
+   Time kmalloc/kfree while the kernel heap fills up, and print the
+   average cost per call at each fill level. Must be called after
+   initialise_paging().
+**/
+void heap_benchmark();
+
+#endif // HEAP_BENCH_H
@@ -7,15 +7,18 @@
 #define KHEAP_H
 
 #include "common.h"
-#include "ordered_array.h"
 
 #define KHEAP_START         0xC0000000
 #define KHEAP_INITIAL_SIZE  0x100000
 
-#define HEAP_INDEX_SIZE   0x20000
 #define HEAP_MAGIC        0x123890AB
 #define HEAP_MIN_SIZE     0x70000
 
+#define HEAP_ALIGN        8     // Block sizes are rounded up to a multiple of this.
+#define HEAP_MIN_BLOCK    32    // Smallest block; must hold a hole_t and a footer_t.
+#define HEAP_NSMALL       32    // Sizes below HEAP_NSMALL*HEAP_ALIGN get a free list each,
+#define HEAP_NBINS        (HEAP_NSMALL+24) // larger ones one per power of two.
+
 /**
    Size information for a hole/block
 **/
@@ -32,9 +35,24 @@ typedef struct
     header_t *header; // Pointer to the block header.
 } footer_t;
 
+/**
+   A hole keeps the links of its free list after the header.
+**/
+typedef struct hole
+{
+    header_t header;
+    struct hole *next;  // Next hole on the same free list.
+    struct hole *prev;  // Previous hole on the same free list.
+} hole_t;
+
+/**
+   Holes are kept on segregated free lists by size, and adjacent
+   holes are coalesced using the footers as boundary tags.
+**/
 typedef struct
 {
-    ordered_array_t index;
+    hole_t *bins[HEAP_NBINS]; // Free lists, see bin_index() in kheap.c.
+    u32int binmap[2];         // Bit set for each non-empty free list.
     u32int start_address; // The start of our allocated space.
     u32int end_address;   // The end of our allocated space. May be expanded up to max_address.
     u32int max_address;   // The maximum address the heap can be expanded to.
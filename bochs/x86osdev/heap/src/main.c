@@ -5,6 +5,9 @@
 #include "descriptor_tables.h"
 #include "timer.h"
 #include "paging.h"
+#ifdef HEAP_BENCH
+#include "heap_bench.h"
+#endif
 
 int main(struct multiboot *mboot_ptr)
 {
@@ -29,5 +32,9 @@ int main(struct multiboot *mboot_ptr)
     monitor_write(", d: ");
     monitor_write_hex(d);
 
+#ifdef HEAP_BENCH
+    heap_benchmark();
+#endif
+
     return 0;
 }
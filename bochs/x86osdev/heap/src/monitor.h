@@ -15,4 +15,8 @@ void monitor_clear();
 // Output a null-terminated ASCII string to the monitor.
 void monitor_write(char *c);
 
+// Output a 32-bit number in hexadecimal or decimal.
+void monitor_write_hex(u32int n);
+void monitor_write_dec(u32int n);
+
 #endif // MONITOR_H
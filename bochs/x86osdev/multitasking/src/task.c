@@ -12,6 +12,15 @@ volatile task_t *current_task;
 // The start of the task linked list.
 volatile task_t *ready_queue;
 
+// The task whose state is loaded in the FPU, if any. The FPU state
+// is switched lazily: switch_task() sets CR0.TS when switching away
+// from this task, and the first FPU/SSE instruction of another task
+// raises #NM, upon which fpu_trap() saves and restores the state.
+volatile task_t *fpu_owner;
+
+// Does the CPU have FXSAVE/FXRSTOR?
+static int fpu_fxsr;
+
 // https://wiki.osdev.org/James_Molloy%27s_Tutorial_Known_Bugs
 extern void perform_task_switch(u32int, u32int, u32int, u32int);
 
@@ -25,6 +34,96 @@ extern u32int read_eip();
 // The next available process ID.
 u32int next_pid = 1;
 
+#define CR0_MP 0x00000002 // Monitor coprocessor
+#define CR0_EM 0x00000004 // Emulation
+#define CR0_TS 0x00000008 // Task switched
+#define CR0_NE 0x00000020 // Numeric error
+#define CR4_OSFXSR     0x00000200 // OS supports FXSAVE/FXRSTOR
+#define CR4_OSXMMEXCPT 0x00000400 // OS supports SSE exceptions
+
+static void set_ts()
+{
+    u32int cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    if (!(cr0 & CR0_TS))
+        asm volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_TS));
+}
+
+static void clear_ts()
+{
+    asm volatile("clts");
+}
+
+static void fpu_save(u8int *state)
+{
+    if (fpu_fxsr)
+        asm volatile("fxsave (%0)" : : "r"(state) : "memory");
+    else
+        asm volatile("fnsave (%0)" : : "r"(state) : "memory");
+}
+
+static void fpu_restore(u8int *state)
+{
+    if (fpu_fxsr)
+        asm volatile("fxrstor (%0)" : : "r"(state) : "memory");
+    else
+        asm volatile("frstor (%0)" : : "r"(state) : "memory");
+}
+
+// Allocate a 16-byte aligned FPU state area. Tasks never go away,
+// so neither does the area.
+static u8int *alloc_fpu_state()
+{
+    u32int addr = kmalloc(FPU_STATE_SIZE + 15);
+    return (u8int*)((addr + 15) & ~15);
+}
+
+// #NM handler: the current task used the FPU while CR0.TS was set.
+static void fpu_trap(registers_t regs)
+{
+    clear_ts();
+    if (fpu_owner == current_task)
+        return;
+
+    // Save the state of the previous user of the FPU...
+    if (fpu_owner)
+        fpu_save(fpu_owner->fpu_state);
+
+    // ...and load ours, or start with a clean one.
+    if (current_task->fpu_used)
+        fpu_restore(current_task->fpu_state);
+    else
+    {
+        asm volatile("fninit");
+        current_task->fpu_used = 1;
+    }
+    fpu_owner = current_task;
+}
+
+// Enable the FPU, and SSE if the CPU has FXSAVE, and arrange for the
+// first FPU instruction to trap.
+static void initialise_fpu()
+{
+    u32int eax, ebx, ecx, edx, cr0, cr4;
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    fpu_fxsr = (edx >> 24) & 1;
+
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 = (cr0 & ~CR0_EM) | CR0_MP | CR0_NE;
+    asm volatile("mov %0, %%cr0" : : "r"(cr0));
+
+    if (fpu_fxsr)
+    {
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+        asm volatile("mov %0, %%cr4" : : "r"(cr4));
+    }
+
+    register_interrupt_handler(7, &fpu_trap);
+    fpu_owner = 0;
+    set_ts();
+}
+
 void initialise_tasking()
 {
     // Rather important stuff happening, no interrupts please!
@@ -39,8 +138,12 @@ void initialise_tasking()
     current_task->esp = current_task->ebp = 0;
     current_task->eip = 0;
     current_task->page_directory = current_directory;
+    current_task->fpu_state = alloc_fpu_state();
+    current_task->fpu_used = 0;
     current_task->next = 0;
 
+    initialise_fpu();
+
     // Reenable interrupts.
     asm volatile("sti");
 }
@@ -137,6 +240,13 @@ void switch_task()
     esp = current_task->esp;
     ebp = current_task->ebp;
 
+    // Let the new task trap on its first FPU instruction, unless
+    // the FPU still holds its state.
+    if (current_task == fpu_owner)
+        clear_ts();
+    else
+        set_ts();
+
     // Make sure the memory manager knows we've changed page directory.
     current_directory = current_task->page_directory;
     perform_task_switch(eip, current_directory->physicalAddr, ebp, esp);
@@ -160,8 +270,25 @@ int fork()
     new_task->esp = new_task->ebp = 0;
     new_task->eip = 0;
     new_task->page_directory = directory;
+    new_task->fpu_state = alloc_fpu_state();
     new_task->next = 0;
 
+    // The child starts with a copy of our FPU state.
+    new_task->fpu_used = parent_task->fpu_used;
+    if (parent_task->fpu_used)
+    {
+        if (fpu_owner == parent_task)
+        {
+            clear_ts();
+            fpu_save(new_task->fpu_state);
+            // FNSAVE reinitialises the FPU; reload our state.
+            if (!fpu_fxsr)
+                fpu_restore(new_task->fpu_state);
+        }
+        else
+            memcpy(new_task->fpu_state, parent_task->fpu_state, FPU_STATE_SIZE);
+    }
+
     // Add it to the end of the ready queue.
     task_t *tmp_task = (task_t*)ready_queue;
     while (tmp_task->next)
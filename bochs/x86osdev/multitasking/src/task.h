@@ -16,9 +16,15 @@ typedef struct task
     u32int esp, ebp;       // Stack and base pointers.
     u32int eip;            // Instruction pointer.
     page_directory_t *page_directory; // Page directory.
+    u8int *fpu_state;      // Saved FPU/SSE state, 16-byte aligned.
+    int fpu_used;          // Has the task used the FPU yet?
     struct task *next;     // The next task in a linked list.
 } task_t;
 
+// Size of the FXSAVE area. FNSAVE, used if the CPU has no FXSAVE,
+// needs less.
+#define FPU_STATE_SIZE 512
+
 // Initialises the tasking system.
 void initialise_tasking();
 
@@ -14,6 +14,13 @@ page_directory_t *current_directory=0;
 u32int *frames;
 u32int nframes;
 
+// A bitset with one bit per word of frames, set if all frames in
+// that word are used, so a search can skip 32 full words at once.
+u32int *frames_full;
+
+// No word of frames before this one has a free frame.
+u32int frames_hint;
+
 // Defined in kheap.c
 extern u32int placement_address;
 
@@ -28,6 +35,8 @@ static void set_frame(u32int frame_addr)
     u32int idx = INDEX_FROM_BIT(frame);
     u32int off = OFFSET_FROM_BIT(frame);
     frames[idx] |= (0x1 << off);
+    if (frames[idx] == 0xFFFFFFFF)
+        frames_full[INDEX_FROM_BIT(idx)] |= (0x1 << OFFSET_FROM_BIT(idx));
 }
 
 // Static function to clear a bit in the frames bitset
@@ -37,6 +46,9 @@ static void clear_frame(u32int frame_addr)
     u32int idx = INDEX_FROM_BIT(frame);
     u32int off = OFFSET_FROM_BIT(frame);
     frames[idx] &= ~(0x1 << off);
+    frames_full[INDEX_FROM_BIT(idx)] &= ~(0x1 << OFFSET_FROM_BIT(idx));
+    if (idx < frames_hint)
+        frames_hint = idx;
 }
 
 // Static function to test if a bit is set.
@@ -48,25 +60,37 @@ static u32int test_frame(u32int frame_addr)
     return (frames[idx] & (0x1 << off));
 }
 
-// Static function to find the first free frame.
-static u32int first_frame()
+// Index of the lowest set bit of a nonzero word.
+static u32int lowest_bit(u32int w)
+{
+    u32int r;
+    asm("bsf %1, %0" : "=r"(r) : "rm"(w));
+    return r;
+}
+
+// Static function to find the first word of frames with a free
+// frame, starting at the hint. Returns (u32int)-1 if there is none.
+static u32int first_free_word()
 {
-    u32int i, j;
-    for (i = 0; i < INDEX_FROM_BIT(nframes); i++)
+    u32int i;
+    for (i = INDEX_FROM_BIT(frames_hint); i < INDEX_FROM_BIT(INDEX_FROM_BIT(nframes)); i++)
     {
-        if (frames[i] != 0xFFFFFFFF) // nothing free, exit early.
+        if (frames_full[i] != 0xFFFFFFFF) // nothing free, skip 32 words.
         {
-            // at least one bit is free here.
-            for (j = 0; j < 32; j++)
-            {
-                u32int toTest = 0x1 << j;
-                if ( !(frames[i]&toTest) )
-                {
-                    return i*4*8+j;
-                }
-            }
+            frames_hint = i*4*8 + lowest_bit(~frames_full[i]);
+            return frames_hint;
         }
     }
+    return (u32int)-1;
+}
+
+// Static function to find the first free frame.
+static u32int first_frame()
+{
+    u32int idx = first_free_word();
+    if (idx == (u32int)-1)
+        return (u32int)-1;
+    return idx*4*8 + lowest_bit(~frames[idx]);
 }
 
 // Function to allocate a frame.
@@ -81,7 +105,7 @@ void alloc_frame(page_t *page, int is_kernel, int is_writeable)
         u32int idx = first_frame();
         if (idx == (u32int)-1)
         {
-            // PANIC! no free frames!!
+            PANIC("No free frames!");
         }
         set_frame(idx*0x1000);
         page->present = 1;
@@ -101,7 +125,7 @@ void free_frame(page_t *page)
     }
     else
     {
-        clear_frame(frame);
+        clear_frame(frame*0x1000);
         page->frame = 0x0;
     }
 }
@@ -113,8 +137,11 @@ void initialise_paging()
     u32int mem_end_page = 0x1000000;
     
     nframes = mem_end_page / 0x1000;
-    frames = (u32int*)kmalloc(INDEX_FROM_BIT(nframes));
-    memset(frames, 0, INDEX_FROM_BIT(nframes));
+    frames = (u32int*)kmalloc(INDEX_FROM_BIT(nframes)*4);
+    memset(frames, 0, INDEX_FROM_BIT(nframes)*4);
+    frames_full = (u32int*)kmalloc(INDEX_FROM_BIT(INDEX_FROM_BIT(nframes))*4);
+    memset(frames_full, 0, INDEX_FROM_BIT(INDEX_FROM_BIT(nframes))*4);
+    frames_hint = 0;
     
     // Let's make a page directory.
     kernel_directory = (page_directory_t*)kmalloc_a(sizeof(page_directory_t));
@@ -73,7 +73,7 @@ static void expand(u32int new_size, heap_t *heap)
     ASSERT(new_size > heap->end_address - heap->start_address);
 
     // Get the nearest following page boundary.
-    if (new_size&0xFFFFF000 != 0)
+    if ((new_size&0xFFF) != 0)
     {
         new_size &= 0xFFFFF000;
         new_size += 0x1000;
@@ -97,13 +97,10 @@ static void expand(u32int new_size, heap_t *heap)
 
 static u32int contract(u32int new_size, heap_t *heap)
 {
-    // Sanity check.
-    ASSERT(new_size < heap->end_address-heap->start_address);
-
     // Get the nearest following page boundary.
-    if (new_size&0x1000)
+    if ((new_size&0xFFF) != 0)
     {
-        new_size &= 0x1000;
+        new_size &= 0xFFFFF000;
         new_size += 0x1000;
     }
 
@@ -112,8 +109,11 @@ static u32int contract(u32int new_size, heap_t *heap)
         new_size = HEAP_MIN_SIZE;
 
     u32int old_size = heap->end_address-heap->start_address;
+    if (new_size >= old_size)
+        return old_size;
+
     u32int i = old_size - 0x1000;
-    while (new_size < i)
+    while (new_size <= i)
     {
         free_frame(get_page(heap->start_address+i, 0, kernel_directory));
         i -= 0x1000;
@@ -123,40 +123,86 @@ static u32int contract(u32int new_size, heap_t *heap)
     return new_size;
 }
 
-static s32int find_smallest_hole(u32int size, u8int page_align, heap_t *heap)
+// Index of the most significant set bit of a nonzero value.
+static u32int msb(u32int v)
 {
-    // Find the smallest hole that will fit.
-    u32int iterator = 0;
-    while (iterator < heap->index.size)
-    {
-        header_t *header = (header_t *)lookup_ordered_array(iterator, &heap->index);
-        // If the user has requested the memory be page-aligned
-        if (page_align > 0)
-        {
-            // Page-align the starting point of this header.
-            u32int location = (u32int)header;
-            s32int offset = 0;
-            if ((location+sizeof(header_t)) & 0xFFFFF000 != 0)
-                offset = 0x1000 /* page size */  - (location+sizeof(header_t))%0x1000;
-            s32int hole_size = (s32int)header->size - offset;
-            // Can we fit now?
-            if (hole_size >= (s32int)size)
-                break;
-        }
-        else if (header->size >= size)
-            break;
-        iterator++;
-    }
-    // Why did the loop exit?
-    if (iterator == heap->index.size)
-        return -1; // We got to the end and didn't find anything.
+    u32int r;
+    asm("bsr %1, %0" : "=r"(r) : "rm"(v));
+    return r;
+}
+
+// Index of the least significant set bit of a nonzero value.
+static u32int lsb(u32int v)
+{
+    u32int r;
+    asm("bsf %1, %0" : "=r"(r) : "rm"(v));
+    return r;
+}
+
+// Free list for holes of the given size. Small sizes have a list
+// each, so any hole on their list fits; larger ones share a list
+// per power of two.
+static u32int bin_index(u32int size)
+{
+    if (size < HEAP_NSMALL*HEAP_ALIGN)
+        return size/HEAP_ALIGN;
+    u32int bin = HEAP_NSMALL + msb(size) - msb(HEAP_NSMALL*HEAP_ALIGN);
+    return (bin < HEAP_NBINS) ? bin : HEAP_NBINS-1;
+}
+
+static void insert_hole(header_t *header, heap_t *heap)
+{
+    hole_t *hole = (hole_t*)header;
+    u32int bin = bin_index(header->size);
+
+    header->magic = HEAP_MAGIC;
+    header->is_hole = 1;
+    footer_t *footer = (footer_t*) ( (u32int)header + header->size - sizeof(footer_t) );
+    footer->magic = HEAP_MAGIC;
+    footer->header = header;
+
+    hole->prev = 0;
+    hole->next = heap->bins[bin];
+    if (hole->next)
+        hole->next->prev = hole;
+    heap->bins[bin] = hole;
+    heap->binmap[bin/32] |= 1 << (bin%32);
+}
+
+static void remove_hole(header_t *header, heap_t *heap)
+{
+    hole_t *hole = (hole_t*)header;
+    u32int bin = bin_index(header->size);
+
+    if (hole->prev)
+        hole->prev->next = hole->next;
     else
-        return iterator;
+        heap->bins[bin] = hole->next;
+    if (hole->next)
+        hole->next->prev = hole->prev;
+    if (heap->bins[bin] == 0)
+        heap->binmap[bin/32] &= ~(1 << (bin%32));
 }
 
-static s8int header_t_less_than(void*a, void *b)
+static header_t *find_hole(u32int size, heap_t *heap)
 {
-    return (((header_t*)a)->size < ((header_t*)b)->size)?1:0;
+    u32int bin = bin_index(size);
+    hole_t *hole;
+
+    // The list for size may hold holes that are too small.
+    for (hole = heap->bins[bin]; hole != 0; hole = hole->next)
+        if (hole->header.size >= size)
+            return &hole->header;
+
+    // Any hole on a later list is big enough; take the first
+    // non-empty one.
+    for (bin++; bin < HEAP_NBINS; bin = (bin/32 + 1)*32)
+    {
+        u32int map = heap->binmap[bin/32] & ~((1 << (bin%32)) - 1);
+        if (map != 0)
+            return &heap->bins[(bin & ~31) + lsb(map)]->header;
+    }
+    return 0;
 }
 
 heap_t *create_heap(u32int start, u32int end_addr, u32int max, u8int supervisor, u8int readonly)
@@ -166,19 +212,13 @@ heap_t *create_heap(u32int start, u32int end_addr, u32int max, u8int supervisor,
     // All our assumptions are made on startAddress and endAddress being page-aligned.
     ASSERT(start%0x1000 == 0);
     ASSERT(end_addr%0x1000 == 0);
-    
-    // Initialise the index.
-    heap->index = place_ordered_array( (void*)start, HEAP_INDEX_SIZE, &header_t_less_than);
-    
-    // Shift the start address forward to resemble where we can start putting data.
-    start += sizeof(type_t)*HEAP_INDEX_SIZE;
-
-    // Make sure the start address is page-aligned.
-    if (start & 0xFFFFF000 != 0)
-    {
-        start &= 0xFFFFF000;
-        start += 0x1000;
-    }
+
+    // All the free lists start out empty.
+    u32int i;
+    for (i = 0; i < HEAP_NBINS; i++)
+        heap->bins[i] = 0;
+    heap->binmap[0] = heap->binmap[1] = 0;
+
     // Write the start, end and max addresses into the heap structure.
     heap->start_address = start;
     heap->end_address = end_addr;
@@ -186,137 +226,95 @@ heap_t *create_heap(u32int start, u32int end_addr, u32int max, u8int supervisor,
     heap->supervisor = supervisor;
     heap->readonly = readonly;
 
-    // We start off with one large hole in the index.
+    // We start off with one large hole.
     header_t *hole = (header_t *)start;
     hole->size = end_addr-start;
-    hole->magic = HEAP_MAGIC;
-    hole->is_hole = 1;
-    insert_ordered_array((void*)hole, &heap->index);     
+    insert_hole(hole, heap);
 
     return heap;
 }
 
-void *alloc(u32int size, u8int page_align, heap_t *heap)
+// Add room for a block of at least size bytes to the end of the
+// heap, as a hole.
+static void grow(u32int size, heap_t *heap)
 {
+    u32int old_end_address = heap->end_address;
 
+    expand(heap->end_address - heap->start_address + size, heap);
+
+    // Merge the new space with the last block if that is a hole.
+    header_t *header = (header_t *)old_end_address;
+    u32int hole_size = heap->end_address - old_end_address;
+    footer_t *footer = (footer_t *) (old_end_address - sizeof(footer_t));
+    if (old_end_address > heap->start_address && footer->header->is_hole)
+    {
+        header = footer->header;
+        remove_hole(header, heap);
+        hole_size += header->size;
+    }
+    header->size = hole_size;
+    insert_hole(header, heap);
+}
+
+void *alloc(u32int size, u8int page_align, heap_t *heap)
+{
     // Make sure we take the size of header/footer into account.
     u32int new_size = size + sizeof(header_t) + sizeof(footer_t);
-    // Find the smallest hole that will fit.
-    s32int iterator = find_smallest_hole(new_size, page_align, heap);
+    new_size = (new_size + HEAP_ALIGN-1) & ~(HEAP_ALIGN-1);
+    if (new_size < HEAP_MIN_BLOCK)
+        new_size = HEAP_MIN_BLOCK;
 
-    if (iterator == -1) // If we didn't find a suitable hole
-    {
-        // Save some previous data.
-        u32int old_length = heap->end_address - heap->start_address;
-        u32int old_end_address = heap->end_address;
+    // A page-aligned block needs room in front of it for a hole.
+    u32int hole_size = page_align ? new_size + 0x1000 + HEAP_MIN_BLOCK : new_size;
 
+    header_t *hole = find_hole(hole_size, heap);
+    if (hole == 0)
+    {
         // We need to allocate some more space.
-        expand(old_length+new_size, heap);
-        u32int new_length = heap->end_address-heap->start_address;
-
-        // Find the endmost header. (Not endmost in size, but in location).
-        iterator = 0;
-        // Vars to hold the index of, and value of, the endmost header found so far.
-        u32int idx = -1; u32int value = 0x0;
-        while (iterator < heap->index.size)
-        {
-            u32int tmp = (u32int)lookup_ordered_array(iterator, &heap->index);
-            if (tmp > value)
-            {
-                value = tmp;
-                idx = iterator;
-            }
-            iterator++;
-        }
-
-        // If we didn't find ANY headers, we need to add one.
-        if (idx == -1)
-        {
-            header_t *header = (header_t *)old_end_address;
-            header->magic = HEAP_MAGIC;
-            header->size = new_length - old_length;
-            header->is_hole = 1;
-            footer_t *footer = (footer_t *) (old_end_address + header->size - sizeof(footer_t));
-            footer->magic = HEAP_MAGIC;
-            footer->header = header;
-            insert_ordered_array((void*)header, &heap->index);
-        }
-        else
-        {
-            // The last header needs adjusting.
-            header_t *header = lookup_ordered_array(idx, &heap->index);
-            header->size += new_length - old_length;
-            // Rewrite the footer.
-            footer_t *footer = (footer_t *) ( (u32int)header + header->size - sizeof(footer_t) );
-            footer->header = header;
-            footer->magic = HEAP_MAGIC;
-        }
-        // We now have enough space. Recurse, and call the function again.
-        return alloc(size, page_align, heap);
+        grow(hole_size, heap);
+        hole = find_hole(hole_size, heap);
+        ASSERT(hole != 0);
     }
+    remove_hole(hole, heap);
+
+    u32int pos = (u32int)hole;
+    hole_size = hole->size;
 
-    header_t *orig_hole_header = (header_t *)lookup_ordered_array(iterator, &heap->index);
-    u32int orig_hole_pos = (u32int)orig_hole_header;
-    u32int orig_hole_size = orig_hole_header->size;
-    // Here we work out if we should split the hole we found into two parts.
-    // Is the original hole size - requested hole size less than the overhead for adding a new hole?
-    if (orig_hole_size-new_size < sizeof(header_t)+sizeof(footer_t))
+    // If we need to page-align the data, make a new hole in front of our block.
+    if (page_align)
     {
-        // Then just increase the requested size to the size of the hole we found.
-        size += orig_hole_size-new_size;
-        new_size = orig_hole_size;
+        u32int data = (pos + sizeof(header_t) + 0xFFF) & 0xFFFFF000;
+        u32int front = data - sizeof(header_t) - pos;
+        if (front > 0 && front < HEAP_MIN_BLOCK)
+            front += 0x1000;
+        if (front > 0)
+        {
+            hole->size = front;
+            insert_hole(hole, heap);
+            pos += front;
+            hole_size -= front;
+        }
     }
 
-    // If we need to page-align the data, do it now and make a new hole in front of our block.
-    if (page_align && orig_hole_pos&0xFFFFF000)
+    // Split off the rest of the hole if it is big enough to be one.
+    if (hole_size - new_size >= HEAP_MIN_BLOCK)
     {
-        u32int new_location   = orig_hole_pos + 0x1000 /* page size */ - (orig_hole_pos&0xFFF) - sizeof(header_t);
-        header_t *hole_header = (header_t *)orig_hole_pos;
-        hole_header->size     = 0x1000 /* page size */ - (orig_hole_pos&0xFFF) - sizeof(header_t);
-        hole_header->magic    = HEAP_MAGIC;
-        hole_header->is_hole  = 1;
-        footer_t *hole_footer = (footer_t *) ( (u32int)new_location - sizeof(footer_t) );
-        hole_footer->magic    = HEAP_MAGIC;
-        hole_footer->header   = hole_header;
-        orig_hole_pos         = new_location;
-        orig_hole_size        = orig_hole_size - hole_header->size;
+        header_t *rest = (header_t *) (pos + new_size);
+        rest->size = hole_size - new_size;
+        insert_hole(rest, heap);
     }
     else
-    {
-        // Else we don't need this hole any more, delete it from the index.
-        remove_ordered_array(iterator, &heap->index);
-    }
+        new_size = hole_size;
 
-    // Overwrite the original header...
-    header_t *block_header  = (header_t *)orig_hole_pos;
+    header_t *block_header  = (header_t *)pos;
     block_header->magic     = HEAP_MAGIC;
     block_header->is_hole   = 0;
     block_header->size      = new_size;
-    // ...And the footer
-    footer_t *block_footer  = (footer_t *) (orig_hole_pos + sizeof(header_t) + size);
+    footer_t *block_footer  = (footer_t *) (pos + new_size - sizeof(footer_t));
     block_footer->magic     = HEAP_MAGIC;
     block_footer->header    = block_header;
 
-    // We may need to write a new hole after the allocated block.
-    // We do this only if the new hole would have positive size...
-    if (orig_hole_size - new_size > 0)
-    {
-        header_t *hole_header = (header_t *) (orig_hole_pos + sizeof(header_t) + size + sizeof(footer_t));
-        hole_header->magic    = HEAP_MAGIC;
-        hole_header->is_hole  = 1;
-        hole_header->size     = orig_hole_size - new_size;
-        footer_t *hole_footer = (footer_t *) ( (u32int)hole_header + orig_hole_size - new_size - sizeof(footer_t) );
-        if ((u32int)hole_footer < heap->end_address)
-        {
-            hole_footer->magic = HEAP_MAGIC;
-            hole_footer->header = hole_header;
-        }
-        // Put the new hole in the index;
-        insert_ordered_array((void*)hole_header, &heap->index);
-    }
-    
-    // ...And we're done!
-    return (void *) ( (u32int)block_header+sizeof(header_t) );
+    return (void *) (pos + sizeof(header_t));
 }
 
 void free(void *p, heap_t *heap)
@@ -332,77 +330,43 @@ void free(void *p, heap_t *heap)
     // Sanity checks.
     ASSERT(header->magic == HEAP_MAGIC);
     ASSERT(footer->magic == HEAP_MAGIC);
-
-    // Make us a hole.
-    header->is_hole = 1;
-
-    // Do we want to add this header into the 'free holes' index?
-    char do_add = 1;
+    ASSERT(header->is_hole == 0);
 
     // Unify left
-    // If the thing immediately to the left of us is a footer...
+    // If the block immediately to the left of us is a hole...
     footer_t *test_footer = (footer_t*) ( (u32int)header - sizeof(footer_t) );
-    if (test_footer->magic == HEAP_MAGIC &&
+    if ((u32int)header > heap->start_address &&
+        test_footer->magic == HEAP_MAGIC &&
         test_footer->header->is_hole == 1)
     {
-        u32int cache_size = header->size; // Cache our current size.
-        header = test_footer->header;     // Rewrite our header with the new one.
-        footer->header = header;          // Rewrite our footer to point to the new header.
-        header->size += cache_size;       // Change the size.
-        do_add = 0;                       // Since this header is already in the index, we don't want to add it again.
+        remove_hole(test_footer->header, heap);
+        test_footer->header->size += header->size;
+        header = test_footer->header;
     }
 
     // Unify right
-    // If the thing immediately to the right of us is a header...
-    header_t *test_header = (header_t*) ( (u32int)footer + sizeof(footer_t) );
-    if (test_header->magic == HEAP_MAGIC &&
+    // If the block immediately to the right of us is a hole...
+    header_t *test_header = (header_t*) ( (u32int)header + header->size );
+    if ((u32int)test_header < heap->end_address &&
+        test_header->magic == HEAP_MAGIC &&
         test_header->is_hole)
     {
-        header->size += test_header->size; // Increase our size.
-        test_footer = (footer_t*) ( (u32int)test_header + // Rewrite it's footer to point to our header.
-                                    test_header->size - sizeof(footer_t) );
-        footer = test_footer;
-        // Find and remove this header from the index.
-        u32int iterator = 0;
-        while ( (iterator < heap->index.size) &&
-                (lookup_ordered_array(iterator, &heap->index) != (void*)test_header) )
-            iterator++;
-
-        // Make sure we actually found the item.
-        ASSERT(iterator < heap->index.size);
-        // Remove it.
-        remove_ordered_array(iterator, &heap->index);
+        remove_hole(test_header, heap);
+        header->size += test_header->size;
     }
 
-    // If the footer location is the end address, we can contract.
-    if ( (u32int)footer+sizeof(footer_t) == heap->end_address)
+    // If we reach the end address, we can contract.
+    if ( (u32int)header + header->size == heap->end_address)
     {
+        u32int offset = (u32int)header - heap->start_address;
         u32int old_length = heap->end_address-heap->start_address;
-        u32int new_length = contract( (u32int)header - heap->start_address, heap);
-        // Check how big we will be after resizing.
-        if (header->size - (old_length-new_length) > 0)
-        {
-            // We will still exist, so resize us.
-            header->size -= old_length-new_length;
-            footer = (footer_t*) ( (u32int)header + header->size - sizeof(footer_t) );
-            footer->magic = HEAP_MAGIC;
-            footer->header = header;
-        }
-        else
-        {
-            // We will no longer exist :(. Remove us from the index.
-            u32int iterator = 0;
-            while ( (iterator < heap->index.size) &&
-                    (lookup_ordered_array(iterator, &heap->index) != (void*)test_header) )
-                iterator++;
-            // If we didn't find ourselves, we have nothing to remove.
-            if (iterator < heap->index.size)
-                remove_ordered_array(iterator, &heap->index);
-        }
+        // Leave a hole of at least the minimum size, or none.
+        u32int new_length = contract( (offset&0xFFF) ? offset + HEAP_MIN_BLOCK : offset, heap);
+        header->size -= old_length-new_length;
+        // We will no longer exist :(.
+        if (header->size == 0)
+            return;
     }
 
-    // If required, add us to the index.
-    if (do_add == 1)
-        insert_ordered_array((void*)header, &heap->index);
-
+    insert_hole(header, heap);
 }
@@ -14,6 +14,13 @@ page_directory_t *current_directory=0;
 u32int *frames;
 u32int nframes;
 
+// A bitset with one bit per word of frames, set if all frames in
+// that word are used, so a search can skip 32 full words at once.
+u32int *frames_full;
+
+// No word of frames before this one has a free frame.
+u32int frames_hint;
+
 // Defined in kheap.c
 extern u32int placement_address;
 extern heap_t *kheap;
@@ -29,6 +36,8 @@ static void set_frame(u32int frame_addr)
     u32int idx = INDEX_FROM_BIT(frame);
     u32int off = OFFSET_FROM_BIT(frame);
     frames[idx] |= (0x1 << off);
+    if (frames[idx] == 0xFFFFFFFF)
+        frames_full[INDEX_FROM_BIT(idx)] |= (0x1 << OFFSET_FROM_BIT(idx));
 }
 
 // Static function to clear a bit in the frames bitset
@@ -38,6 +47,9 @@ static void clear_frame(u32int frame_addr)
     u32int idx = INDEX_FROM_BIT(frame);
     u32int off = OFFSET_FROM_BIT(frame);
     frames[idx] &= ~(0x1 << off);
+    frames_full[INDEX_FROM_BIT(idx)] &= ~(0x1 << OFFSET_FROM_BIT(idx));
+    if (idx < frames_hint)
+        frames_hint = idx;
 }
 
 // Static function to test if a bit is set.
@@ -49,25 +61,37 @@ static u32int test_frame(u32int frame_addr)
     return (frames[idx] & (0x1 << off));
 }
 
-// Static function to find the first free frame.
-static u32int first_frame()
+// Index of the lowest set bit of a nonzero word.
+static u32int lowest_bit(u32int w)
+{
+    u32int r;
+    asm("bsf %1, %0" : "=r"(r) : "rm"(w));
+    return r;
+}
+
+// Static function to find the first word of frames with a free
+// frame, starting at the hint. Returns (u32int)-1 if there is none.
+static u32int first_free_word()
 {
-    u32int i, j;
-    for (i = 0; i < INDEX_FROM_BIT(nframes); i++)
+    u32int i;
+    for (i = INDEX_FROM_BIT(frames_hint); i < INDEX_FROM_BIT(INDEX_FROM_BIT(nframes)); i++)
     {
-        if (frames[i] != 0xFFFFFFFF) // nothing free, exit early.
+        if (frames_full[i] != 0xFFFFFFFF) // nothing free, skip 32 words.
         {
-            // at least one bit is free here.
-            for (j = 0; j < 32; j++)
-            {
-                u32int toTest = 0x1 << j;
-                if ( !(frames[i]&toTest) )
-                {
-                    return i*4*8+j;
-                }
-            }
+            frames_hint = i*4*8 + lowest_bit(~frames_full[i]);
+            return frames_hint;
         }
     }
+    return (u32int)-1;
+}
+
+// Static function to find the first free frame.
+static u32int first_frame()
+{
+    u32int idx = first_free_word();
+    if (idx == (u32int)-1)
+        return (u32int)-1;
+    return idx*4*8 + lowest_bit(~frames[idx]);
 }
 
 // Function to allocate a frame.
@@ -82,7 +106,7 @@ void alloc_frame(page_t *page, int is_kernel, int is_writeable)
         u32int idx = first_frame();
         if (idx == (u32int)-1)
         {
-            // PANIC! no free frames!!
+            PANIC("No free frames!");
         }
         set_frame(idx*0x1000);
         page->present = 1;
@@ -102,11 +126,109 @@ void free_frame(page_t *page)
     }
     else
     {
-        clear_frame(frame);
+        clear_frame(frame*0x1000);
         page->frame = 0x0;
     }
 }
 
+// Static function to find a run of want free frames, skipping 32
+// full words at a time with frames_full. Returns the first frame of
+// the first such run, or of the longest run there is if none is that
+// long, and sets *len to the length taken. Returns (u32int)-1 if no
+// frame is free.
+static u32int find_run(u32int want, u32int *len)
+{
+    u32int start = 0, run = 0, best = (u32int)-1, best_len = 0;
+    u32int idx, j;
+
+    idx = first_free_word();
+    if (idx == (u32int)-1)
+        return (u32int)-1;
+    for (; idx < INDEX_FROM_BIT(nframes); idx++)
+    {
+        if (frames[idx] == 0xFFFFFFFF)
+        {
+            // The run ends here.
+            if (run > best_len)
+            {
+                best = start;
+                best_len = run;
+            }
+            run = 0;
+            if (frames_full[INDEX_FROM_BIT(idx)] == 0xFFFFFFFF)
+                idx |= 31; // skip the rest of these 32 full words.
+        }
+        else if (frames[idx] == 0)
+        {
+            if (run == 0)
+                start = idx*4*8;
+            run += 32;
+        }
+        else
+        {
+            for (j = 0; j < 32 && run < want; j++)
+            {
+                if (frames[idx] & (0x1 << j))
+                {
+                    if (run > best_len)
+                    {
+                        best = start;
+                        best_len = run;
+                    }
+                    run = 0;
+                }
+                else if (run++ == 0)
+                {
+                    start = idx*4*8 + j;
+                }
+            }
+        }
+        if (run >= want)
+        {
+            *len = want;
+            return start;
+        }
+    }
+    if (run > best_len)
+    {
+        best = start;
+        best_len = run;
+    }
+    *len = best_len;
+    return best;
+}
+
+// Function to allocate frames for all pages in pages[0..n-1] that
+// are marked present but have no frame yet. Each stretch of such
+// pages gets a run of contiguous frames if there is one.
+void alloc_frames(page_t *pages, u32int n, int is_kernel, int is_writeable)
+{
+    u32int i = 0, k, frame, len;
+    while (1)
+    {
+        // Find the next stretch of pages that need frames.
+        while (i < n && (!pages[i].present || pages[i].frame))
+            i++;
+        if (i == n)
+            return;
+        for (k = i; k < n && pages[k].present && !pages[k].frame; k++)
+            ;
+
+        frame = find_run(k - i, &len);
+        if (frame == (u32int)-1)
+        {
+            PANIC("No free frames!");
+        }
+        for (; len > 0; len--, frame++, i++)
+        {
+            set_frame(frame*0x1000);
+            pages[i].rw = (is_writeable==1)?1:0;
+            pages[i].user = (is_kernel==1)?0:1;
+            pages[i].frame = frame;
+        }
+    }
+}
+
 void initialise_paging()
 {
     // The size of physical memory. For the moment we 
@@ -114,8 +236,11 @@ void initialise_paging()
     u32int mem_end_page = 0x1000000;
     
     nframes = mem_end_page / 0x1000;
-    frames = (u32int*)kmalloc(INDEX_FROM_BIT(nframes));
-    memset(frames, 0, INDEX_FROM_BIT(nframes));
+    frames = (u32int*)kmalloc(INDEX_FROM_BIT(nframes)*4);
+    memset(frames, 0, INDEX_FROM_BIT(nframes)*4);
+    frames_full = (u32int*)kmalloc(INDEX_FROM_BIT(INDEX_FROM_BIT(nframes))*4);
+    memset(frames_full, 0, INDEX_FROM_BIT(INDEX_FROM_BIT(nframes))*4);
+    frames_hint = 0;
     
     // Let's make a page directory.
     u32int phys;
@@ -235,17 +360,21 @@ static page_table_t *clone_table(page_table_t *src, u32int *physAddr)
     // Make a new page table, which is page aligned.
     page_table_t *table = (page_table_t*)kmalloc_ap(sizeof(page_table_t), physAddr);
     // Ensure that the new table is blank.
-    memset(table, 0, sizeof(page_directory_t));
+    memset(table, 0, sizeof(page_table_t));
 
-    // For every entry in the table...
+    // Mark every entry whose source entry has a frame associated with it...
     int i;
+    for (i = 0; i < 1024; i++)
+        if (src->pages[i].frame)
+            table->pages[i].present = 1;
+
+    // ...and get new frames for all of them at once.
+    alloc_frames(table->pages, 1024, 0, 0);
+
     for (i = 0; i < 1024; i++)
     {
-        // If the source entry has a frame associated with it...
         if (!src->pages[i].frame)
             continue;
-        // Get a new frame.
-        alloc_frame(&table->pages[i], 0, 0);
         // Clone the flags from source to destination.
         if (src->pages[i].present) table->pages[i].present = 1;
         if (src->pages[i].rw)      table->pages[i].rw = 1;
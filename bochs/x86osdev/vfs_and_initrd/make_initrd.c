@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 struct initrd_header
 {
@@ -8,16 +10,42 @@ struct initrd_header
 	unsigned int length;
 };
 
-int main(char argc, char **argv)
+/* Must match initrd.h */
+#define INITRD_MIN_HEADERS 64
+#define INITRD_INDEX_MAGIC 0x58444E49
+
+/* FNV-1a, as initrd_hash() in initrd.c */
+unsigned int initrd_hash(const char *name)
+{
+	unsigned int h = 2166136261u;
+	while(*name)
+	{
+		h ^= (unsigned char)*name++;
+		h *= 16777619;
+	}
+	return h;
+}
+
+int main(int argc, char **argv)
 {
 	
-	int nheaders = (argc-1)/2;
-	struct initrd_header headers[64];
+	int nfiles = (argc-1)/2;
+	int nheaders = nfiles < INITRD_MIN_HEADERS ? INITRD_MIN_HEADERS : nfiles;
+	struct initrd_header *headers = calloc(nheaders, sizeof(struct initrd_header));
 	printf("size of header: %d\n", sizeof(struct initrd_header));
-	unsigned int off = sizeof(struct initrd_header) * 64 + sizeof(int);
+
+	/* Hash index of the names: chain heads, then a link per file */
+	unsigned int index[2] = { INITRD_INDEX_MAGIC, 1 };
+	while(index[1] < nfiles)
+		index[1] <<= 1;
+	unsigned int *buckets = calloc(index[1], sizeof(unsigned int));
+	unsigned int *chain = calloc(nfiles + 1, sizeof(unsigned int));
+
+	unsigned int off = sizeof(int) + sizeof(struct initrd_header) * nheaders +
+		sizeof(index) + sizeof(unsigned int) * (index[1] + nfiles);
 
 	int i;
-	for(i = 0; i < nheaders; i++)
+	for(i = 0; i < nfiles; i++)
 	{
 		printf("writing file %s->%s at 0x%x\n", argv[i*2+1], argv[i*2+2], off);
 		strcpy(headers[i].name, argv[i*2+2]);
@@ -34,13 +62,23 @@ int main(char argc, char **argv)
 		fclose(stream);
 		headers[i].magic = 0xBF;
 	}
+
+	for(i = nfiles - 1; i >= 0; i--)
+	{
+		unsigned int bucket = initrd_hash(headers[i].name) & (index[1] - 1);
+		chain[i] = buckets[bucket];
+		buckets[bucket] = i + 1;
+	}
 	
 	FILE *wstream = fopen("./initrd.img", "w");
 	unsigned char *data = (unsigned char *)malloc(off);
-	fwrite(&nheaders, sizeof(int), 1, wstream);
-	fwrite(headers, sizeof(struct initrd_header), 64, wstream);
+	fwrite(&nfiles, sizeof(int), 1, wstream);
+	fwrite(headers, sizeof(struct initrd_header), nheaders, wstream);
+	fwrite(index, sizeof(index), 1, wstream);
+	fwrite(buckets, sizeof(unsigned int), index[1], wstream);
+	fwrite(chain, sizeof(unsigned int), nfiles, wstream);
 	
-	for(i = 0; i < nheaders; i++)
+	for(i = 0; i < nfiles; i++)
 	{
 		FILE *stream = fopen(argv[i*2+1], "r");
 		unsigned char *buf = (unsigned char *)malloc(headers[i].length);
@@ -52,6 +90,9 @@ int main(char argc, char **argv)
 	
 	fclose(wstream);
 	free(data);
+	free(headers);
+	free(buckets);
+	free(chain);
 
 	return 0;	
 }
@@ -5,6 +5,27 @@
 
 fs_node_t *fs_root = 0; // The root of the filesystem.
 
+// A direct-mapped cache of recent finddir_fs() results, keyed by
+// the directory node and the name looked up in it.
+#define DCACHE_SIZE 64
+
+typedef struct
+{
+    fs_node_t *dir;  // Directory the name was looked up in, 0 if unused.
+    fs_node_t *node; // The node found.
+    char name[128];
+} dcache_entry_t;
+
+static dcache_entry_t dcache[DCACHE_SIZE];
+
+static u32int dcache_slot(fs_node_t *dir, char *name)
+{
+    u32int h = (u32int)dir;
+    while (*name)
+        h = h*31 + (u8int)*name++;
+    return h % DCACHE_SIZE;
+}
+
 u32int read_fs(fs_node_t *node, u32int offset, u32int size, u8int *buffer)
 {
     // Has the node got a read callback?
@@ -52,7 +73,28 @@ fs_node_t *finddir_fs(fs_node_t *node, char *name)
     // Is the node a directory, and does it have a callback?
     if ( (node->flags&0x7) == FS_DIRECTORY &&
          node->finddir != 0 )
-        return node->finddir(node, name);
+    {
+        // Have we looked this name up recently?
+        dcache_entry_t *entry = &dcache[dcache_slot(node, name)];
+        if (entry->dir == node && !strcmp(entry->name, name))
+            return entry->node;
+
+        fs_node_t *found = node->finddir(node, name);
+        if (found != 0 && strlen(name) < sizeof(entry->name))
+        {
+            entry->dir = node;
+            entry->node = found;
+            strcpy(entry->name, name);
+        }
+        return found;
+    }
     else
         return 0;
 }
+
+void invalidate_dcache()
+{
+    u32int i;
+    for (i = 0; i < DCACHE_SIZE; i++)
+        dcache[i].dir = 0;
+}
@@ -62,4 +62,9 @@ void close_fs(fs_node_t *node);
 struct dirent *readdir_fs(fs_node_t *node, u32int index);
 fs_node_t *finddir_fs(fs_node_t *node, char *name);
 
+// Forget all cached finddir_fs() results. Must be called when a
+// directory's entries change, e.g. when a ramdisk is (re)loaded or
+// something is mounted on one of them.
+void invalidate_dcache();
+
 #endif
@@ -9,6 +9,9 @@ fs_node_t *initrd_root;             // Our root directory node.
 fs_node_t *initrd_dev;              // We also add a directory node for /dev, so we can mount devfs later on.
 fs_node_t *root_nodes;              // List of file nodes.
 int nroot_nodes;                    // Number of file nodes.
+u32int *index_buckets;              // Hash chain heads of the file names.
+u32int *index_chain;                // Next link of each file's chain.
+u32int index_nbuckets;              // Number of hash chains, a power of two.
 
 struct dirent dirent;
 
@@ -41,19 +44,67 @@ static struct dirent *initrd_readdir(fs_node_t *node, u32int index)
     return &dirent;
 }
 
+// FNV-1a; make_initrd uses the same function to build the index.
+u32int initrd_hash(const char *name)
+{
+    u32int h = 2166136261u;
+    while (*name)
+    {
+        h ^= (u8int)*name++;
+        h *= 16777619;
+    }
+    return h;
+}
+
 static fs_node_t *initrd_finddir(fs_node_t *node, char *name)
 {
     if (node == initrd_root &&
         !strcmp(name, "dev") )
         return initrd_dev;
 
-    int i;
-    for (i = 0; i < nroot_nodes; i++)
-        if (!strcmp(name, root_nodes[i].name))
-            return &root_nodes[i];
+    // Only walk the chain of files whose names hash like this one.
+    u32int link = index_buckets[initrd_hash(name) & (index_nbuckets-1)];
+    while (link != 0)
+    {
+        if (!strcmp(name, root_nodes[link-1].name))
+            return &root_nodes[link-1];
+        link = index_chain[link-1];
+    }
     return 0;
 }
 
+// Find the name index of the ramdisk, or build one if the ramdisk
+// was made without it.
+static void initialise_index(u32int location)
+{
+    u32int nheaders = initrd_header->nfiles;
+    if (nheaders < INITRD_MIN_HEADERS)
+        nheaders = INITRD_MIN_HEADERS;
+    initrd_index_t *index = (initrd_index_t *) (location + sizeof(initrd_header_t) +
+                                               nheaders*sizeof(initrd_file_header_t));
+    if (index->magic == INITRD_INDEX_MAGIC)
+    {
+        index_nbuckets = index->nbuckets;
+        index_buckets = (u32int *) (index+1);
+        index_chain = index_buckets + index_nbuckets;
+        return;
+    }
+
+    index_nbuckets = 1;
+    while (index_nbuckets < nroot_nodes)
+        index_nbuckets <<= 1;
+    index_buckets = (u32int*)kmalloc(sizeof(u32int) * index_nbuckets);
+    index_chain = (u32int*)kmalloc(sizeof(u32int) * (nroot_nodes+1));
+    memset((u8int*)index_buckets, 0, sizeof(u32int) * index_nbuckets);
+    int i;
+    for (i = nroot_nodes-1; i >= 0; i--)
+    {
+        u32int bucket = initrd_hash(root_nodes[i].name) & (index_nbuckets-1);
+        index_chain[i] = index_buckets[bucket];
+        index_buckets[bucket] = i+1;
+    }
+}
+
 fs_node_t *initialise_initrd(u32int location)
 {
     // Initialise the main and file header pointers and populate the root directory.
@@ -113,5 +164,10 @@ fs_node_t *initialise_initrd(u32int location)
         root_nodes[i].close = 0;
         root_nodes[i].impl = 0;
     }
+
+    initialise_index(location);
+
+    // Lookups cached for a previously loaded ramdisk point at stale nodes.
+    invalidate_dcache();
     return initrd_root;
 }
@@ -20,6 +20,24 @@ typedef struct
     u32int length;   // Length of the file.
 } initrd_file_header_t;
 
+// At least this many file headers follow the ramdisk header; unused
+// ones are zeroed.
+#define INITRD_MIN_HEADERS 64
+
+#define INITRD_INDEX_MAGIC 0x58444E49 // "INDX"
+
+// make_initrd puts a hash index of the file names after the file
+// headers: nbuckets chain heads, then one chain link per file. Links
+// hold a file number plus one, or 0 at the end of a chain.
+typedef struct
+{
+    u32int magic;    // INITRD_INDEX_MAGIC.
+    u32int nbuckets; // Number of hash chains, a power of two.
+} initrd_index_t;
+
+// Hash of a file name, used to pick its chain in the index.
+u32int initrd_hash(const char *name);
+
 // Initialises the initial ramdisk. It gets passed the address of the multiboot module,
 // and returns a completed filesystem node.
 fs_node_t *initialise_initrd(u32int location);
@@ -1,13 +1,16 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
+// * To also read ahead blocks that will be needed soon, call breada.
+// * To get a buffer whose data will be overwritten, call bnew.
 // * After changing buffer data, call bwrite to write it to disk.
+//   bwritev writes several buffers in one disk request.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
@@ -17,6 +20,11 @@
 // * B_VALID: the buffer data has been read from the disk.
 // * B_DIRTY: the buffer data has been modified
 //     and needs to be written to disk.
+//
+// Buffers are hashed by (dev, blockno) into NBUCKET buckets, each
+// with its own lock, so lookups of different blocks don't contend.
+// Recycling a buffer moves it between buckets; bcache.lock
+// serializes that.
 
 #include "types.h"
 #include "defs.h"
@@ -26,70 +34,149 @@
 #include "fs.h"
 #include "buf.h"
 
-struct {
+#define BHASH(dev, blockno) (((dev) * 31 + (blockno)) % NBUCKET)
+
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;  // chain through buf.next
+};
 
-  // Linked list of all buffers, through prev/next.
-  // head.next is most recently used.
-  struct buf head;
+struct {
+  struct spinlock lock;  // held while recycling a buffer
+  struct buf buf[NBUF];
+  struct bucket bucket[NBUCKET];
 } bcache;
 
 void
 binit(void)
 {
   struct buf *b;
+  int i;
 
   initlock(&bcache.lock, "bcache");
+  for(i = 0; i < NBUCKET; i++)
+    initlock(&bcache.bucket[i].lock, "bcache.bucket");
 
 //PAGEBREAK!
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
+  // Put all buffers in bucket 0. Device -1 matches no block.
   for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+    b->dev = -1;
+    b->next = bcache.bucket[0].head;
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    bcache.bucket[0].head = b;
   }
 }
 
+// Look for block on device dev in bucket bk.
+// Caller must hold bk->lock.
+static struct buf*
+blookup(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->head; b; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      return b;
+  return 0;
+}
+
+// Find the least recently used buffer that is not in use and
+// move it to bucket bk for block on device dev.
+// Caller must hold bcache.lock. Returns 0 if all buffers are in use.
+static struct buf*
+brecycle(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b, *victim, **pp;
+  struct bucket *vbk;
+  int i;
+
+  for(;;){
+    victim = 0;
+    vbk = 0;
+    for(i = 0; i < NBUCKET; i++){
+      acquire(&bcache.bucket[i].lock);
+      // Even if refcnt==0, B_DIRTY indicates a buffer is in use
+      // because log.c has modified it but not yet committed it.
+      for(b = bcache.bucket[i].head; b; b = b->next){
+        if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0 &&
+           (victim == 0 || b->lastuse < victim->lastuse)){
+          victim = b;
+          vbk = &bcache.bucket[i];
+        }
+      }
+      release(&bcache.bucket[i].lock);
+    }
+    if(victim == 0)
+      return 0;
+
+    // The victim may have been picked up again since its bucket
+    // was scanned.
+    acquire(&vbk->lock);
+    if(victim->refcnt == 0 && (victim->flags & B_DIRTY) == 0)
+      break;
+    release(&vbk->lock);
+  }
+
+  for(pp = &vbk->head; *pp != victim; pp = &(*pp)->next)
+    ;
+  *pp = victim->next;
+  victim->dev = dev;
+  victim->blockno = blockno;
+  victim->flags = 0;
+  victim->refcnt = 1;
+  release(&vbk->lock);
+
+  acquire(&bk->lock);
+  victim->next = bk->head;
+  bk->head = victim;
+  release(&bk->lock);
+  return victim;
+}
+
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
-// In either case, return locked buffer.
+// If ra is set, only a newly allocated buffer is returned, and 0 if
+// the block is cached or no buffer is free.
+// Otherwise return locked buf.
 static struct buf*
-bget(uint dev, uint blockno)
+bget(uint dev, uint blockno, int ra)
 {
+  struct bucket *bk;
   struct buf *b;
 
-  acquire(&bcache.lock);
+  bk = &bcache.bucket[BHASH(dev, blockno)];
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  acquire(&bk->lock);
+  b = blookup(bk, dev, blockno);
+  if(b && !ra)
+    b->refcnt++;
+  release(&bk->lock);
+  if(b){
+    if(ra)
+      return 0;
+    acquiresleep(&b->lock);
+    return b;
   }
 
-  // Not cached; recycle an unused buffer.
-  // Even if refcnt==0, B_DIRTY indicates a buffer is in use
-  // because log.c has modified it but not yet committed it.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->flags = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
-  }
-  panic("bget: no buffers");
+  // Not cached; recycle an unused buffer. Check the bucket again,
+  // another CPU may have recycled a buffer for the block meanwhile.
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  b = blookup(bk, dev, blockno);
+  if(b && !ra)
+    b->refcnt++;
+  release(&bk->lock);
+  if(b == 0){
+    b = brecycle(bk, dev, blockno);
+    if(b == 0 && !ra)
+      panic("bget: no buffers");
+  } else if(ra)
+    b = 0;
+  release(&bcache.lock);
+  if(b)
+    acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -98,13 +185,49 @@ bread(uint dev, uint blockno)
 {
   struct buf *b;
 
-  b = bget(dev, blockno);
+  b = bget(dev, blockno, 0);
   if((b->flags & B_VALID) == 0) {
     iderw(b);
   }
   return b;
 }
 
+// Like bread, but also read the blocks in ra[] that are not cached.
+// They are read in the same disk request as the indicated block, so
+// adjacent blocks are transferred together.
+struct buf*
+breada(uint dev, uint blockno, uint *ra, int nra)
+{
+  struct buf *b, *bs[1+NREADAHEAD];
+  int i, n;
+
+  if(nra > NREADAHEAD)
+    nra = NREADAHEAD;
+  b = bget(dev, blockno, 0);
+  n = 0;
+  if((b->flags & B_VALID) == 0)
+    bs[n++] = b;
+  for(i = 0; i < nra; i++){
+    if((bs[n] = bget(dev, ra[i], 1)) != 0)
+      n++;
+  }
+  if(n > 0)
+    iderwv(bs, n);
+  for(i = 0; i < n; i++){
+    if(bs[i] != b)
+      brelse(bs[i]);
+  }
+  return b;
+}
+
+// Return a locked buf for the indicated block without reading
+// it, for a caller that is going to overwrite all of its data.
+struct buf*
+bnew(uint dev, uint blockno)
+{
+  return bget(dev, blockno, 0);
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -115,29 +238,43 @@ bwrite(struct buf *b)
   iderw(b);
 }
 
+// Write the contents of n locked bufs to disk in one request.
+void
+bwritev(struct buf **bufs, int n)
+{
+  int i;
+
+  if(n == 0)
+    return;
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bufs[i]->lock))
+      panic("bwritev");
+    bufs[i]->flags |= B_DIRTY;
+  }
+  iderwv(bufs, n);
+}
+
 // Release a locked buffer.
-// Move to the head of the MRU list.
+// Remember when it was last used for recycling.
 void
 brelse(struct buf *b)
 {
+  struct bucket *bk;
+
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+  acquire(&bk->lock);
   b->refcnt--;
   if (b->refcnt == 0) {
     // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->lastuse = ticks;
   }
-  
-  release(&bcache.lock);
+
+  release(&bk->lock);
 }
 //PAGEBREAK!
 // Blank page.
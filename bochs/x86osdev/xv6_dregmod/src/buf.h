@@ -4,8 +4,8 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
+  uint lastuse; // ticks when last released, for recycling
+  struct buf *next; // hash bucket chain
   struct buf *qnext; // disk queue
   uchar data[BSIZE];
 };
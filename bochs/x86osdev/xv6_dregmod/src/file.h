@@ -23,6 +23,9 @@ struct inode {
   short nlink;
   uint size;
   uint addrs[NDIRECT+1];
+
+  uint nextbn;        // next block of a sequential read
+  uint raend;         // end of the blocks read ahead
 };
 
 // table mapping major device number to
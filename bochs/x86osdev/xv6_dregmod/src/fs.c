@@ -305,6 +305,8 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    ip->nextbn = 0;
+    ip->raend = 0;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -452,7 +454,8 @@ stati(struct inode *ip, struct stat *st)
 int
 readi(struct inode *ip, char *dst, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, bn, ra[NREADAHEAD];
+  int nra;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -467,7 +470,19 @@ readi(struct inode *ip, char *dst, uint off, uint n)
     n = ip->size - off;
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    bn = off/BSIZE;
+    nra = 0;
+    if(bn != ip->nextbn && bn+1 != ip->nextbn){
+      // not sequential, forget the blocks read ahead
+      ip->raend = 0;
+    } else if(bn == ip->nextbn && bn+1 >= ip->raend){
+      // Sequential read past the blocks read ahead; read ahead
+      // the next blocks of the file.
+      for(ip->raend = bn+1; nra < NREADAHEAD && ip->raend*BSIZE < ip->size; ip->raend++)
+        ra[nra++] = bmap(ip, ip->raend);
+    }
+    bp = breada(ip->dev, bmap(ip, bn), ra, nra);
+    ip->nextbn = bn + 1;
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(dst, bp->data + off%BSIZE, m);
     brelse(bp);
@@ -1,4 +1,5 @@
-// Simple PIO-based (non-DMA) IDE driver code.
+// IDE driver code. Uses bus-master DMA through the PCI IDE
+// controller if there is one, and falls back to PIO otherwise.
 
 #include "types.h"
 #include "defs.h"
@@ -23,16 +24,50 @@
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_RDDMA 0xc8
+#define IDE_CMD_WRDMA 0xca
 
-// idequeue points to the buf now being read/written to the disk.
-// idequeue->qnext points to the next buf to be processed.
-// You must hold idelock while manipulating queue.
+// Bus master registers of the primary channel, relative to BAR4
+// of the PCI IDE controller.
+#define BM_CMD        0
+#define BM_STATUS     2
+#define BM_PRDT       4
+#define BM_CMD_START  0x01
+#define BM_CMD_READ   0x08  // device to memory
+#define BM_STATUS_ERR 0x02
+#define BM_STATUS_INT 0x04
+
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+// Largest number of adjacent blocks merged into one DMA transfer.
+// One ATA command transfers at most 256 sectors.
+#define IDE_MAXMERGE  16
+
+// Physical region descriptor. A region must not cross a 64K
+// boundary, so each block needs at most two of them.
+struct prd {
+  uint addr;
+  uint size;  // byte count in the low 16 bits, 0 means 64K
+};
+#define PRD_EOT 0x80000000
+
+// Requests that are not started yet sit in idequeue, ordered for a
+// one-way elevator sweep starting at idepos. Adjacent blocks end up
+// next to each other and are started as one transfer. ideactive
+// holds the bufs of the transfer in progress, linked through qnext.
+// You must hold idelock while manipulating the queues.
 
 static struct spinlock idelock;
 static struct buf *idequeue;
+static struct buf *ideactive;
+static uint idepos;
 
 static int havedisk1;
-static void idestart(struct buf*);
+static ushort idebm;  // bus master base port, 0 if DMA is not available
+static struct prd prdt[2*IDE_MAXMERGE] __attribute__((aligned(256)));
+
+static void idestart(void);
 
 // Wait for IDE disk to become ready.
 static int
@@ -47,6 +82,46 @@ idewait(int checkerr)
   return 0;
 }
 
+static uint
+pciread(int dev, int func, int reg)
+{
+  outl(PCI_CONFIG_ADDR, 0x80000000 | (dev<<11) | (func<<8) | reg);
+  return inl(PCI_CONFIG_DATA);
+}
+
+static void
+pciwrite(int dev, int func, int reg, uint v)
+{
+  outl(PCI_CONFIG_ADDR, 0x80000000 | (dev<<11) | (func<<8) | reg);
+  outl(PCI_CONFIG_DATA, v);
+}
+
+// Find a bus-master capable IDE controller on PCI bus 0 and
+// enable bus mastering. Returns its bus master base port.
+static ushort
+idefindbm(void)
+{
+  int dev, func;
+  uint class, bar;
+
+  for(dev = 0; dev < 32; dev++){
+    for(func = 0; func < 8; func++){
+      if((pciread(dev, func, 0x00) & 0xffff) == 0xffff)
+        continue;
+      class = pciread(dev, func, 0x08);
+      // mass storage, IDE, bus master capable
+      if((class >> 16) != 0x0101 || !(class & 0x8000))
+        continue;
+      bar = pciread(dev, func, 0x20);
+      if(!(bar & 1) || (bar & 0xfffc) == 0)
+        continue;
+      pciwrite(dev, func, 0x04, (pciread(dev, func, 0x04) & 0xffff) | 0x05);
+      return bar & 0xfffc;
+    }
+  }
+  return 0;
+}
+
 void
 ideinit(void)
 {
@@ -67,31 +142,100 @@ ideinit(void)
 
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
+
+  idebm = idefindbm();
+  if(idebm)
+    cprintf("ide: bus master dma at 0x%x\n", idebm);
 }
 
-// Start the request for b.  Caller must hold idelock.
+// Elevator position of a request.
+static uint
+idekey(struct buf *b)
+{
+  return b->dev * FSSIZE + b->blockno;
+}
+
+// Add the memory of b to the PRD table, starting at entry n.
+// Returns the new number of entries.
+static int
+ideprd(struct buf *b, int n)
+{
+  uint pa, len, chunk;
+
+  pa = V2P(b->data);
+  for(len = BSIZE; len > 0; len -= chunk, pa += chunk){
+    chunk = 0x10000 - (pa & 0xffff);
+    if(chunk > len)
+      chunk = len;
+    // extend the previous region if this one follows it
+    if(n > 0 && prdt[n-1].addr + prdt[n-1].size == pa && (pa & 0xffff) != 0){
+      prdt[n-1].size += chunk;
+      continue;
+    }
+    prdt[n].addr = pa;
+    prdt[n].size = chunk;
+    n++;
+  }
+  return n;
+}
+
+// Start the transfer for the bufs at the head of idequeue.
+// Caller must hold idelock.
 static void
-idestart(struct buf *b)
+idestart(void)
 {
+  struct buf *b, *last;
+  int n, nprd, write, sector, nsect;
+
+  b = idequeue;
   if(b == 0)
     panic("idestart");
   if(b->blockno >= FSSIZE)
     panic("incorrect blockno");
   int sector_per_block =  BSIZE/SECTOR_SIZE;
-  int sector = b->blockno * sector_per_block;
   int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
   int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
   if (sector_per_block > 7) panic("idestart");
 
+  // Take the run of requests for adjacent blocks in the same
+  // direction. PIO transfers one block at a time.
+  write = (b->flags & B_DIRTY) != 0;
+  last = b;
+  n = 1;
+  while(idebm && n < IDE_MAXMERGE && last->qnext &&
+        last->qnext->dev == b->dev &&
+        last->qnext->blockno == last->blockno + 1 &&
+        ((last->qnext->flags & B_DIRTY) != 0) == write){
+    last = last->qnext;
+    n++;
+  }
+  idequeue = last->qnext;
+  last->qnext = 0;
+  ideactive = b;
+  idepos = idekey(last) + 1;
+
+  sector = b->blockno * sector_per_block;
+  nsect = n * sector_per_block;
+
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
+  outb(0x1f2, nsect);  // number of sectors
   outb(0x1f3, sector & 0xff);
   outb(0x1f4, (sector >> 8) & 0xff);
   outb(0x1f5, (sector >> 16) & 0xff);
   outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
-  if(b->flags & B_DIRTY){
+  if(idebm){
+    nprd = 0;
+    for(; b; b = b->qnext)
+      nprd = ideprd(b, nprd);
+    prdt[nprd-1].size |= PRD_EOT;
+    outl(idebm+BM_PRDT, V2P(prdt));
+    outb(idebm+BM_STATUS, BM_STATUS_ERR|BM_STATUS_INT);
+    outb(idebm+BM_CMD, write ? 0 : BM_CMD_READ);
+    outb(0x1f7, write ? IDE_CMD_WRDMA : IDE_CMD_RDDMA);
+    outb(idebm+BM_CMD, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+  } else if(write){
     outb(0x1f7, write_cmd);
     outsl(0x1f0, b->data, BSIZE/4);
   } else {
@@ -103,66 +247,103 @@ idestart(struct buf *b)
 void
 ideintr(void)
 {
-  struct buf *b;
+  struct buf *b, *next;
+  uchar st;
 
-  // First queued buffer is the active request.
+  // ideactive holds the bufs of the finished transfer.
   acquire(&idelock);
 
-  if((b = idequeue) == 0){
+  if((b = ideactive) == 0){
     release(&idelock);
     return;
   }
-  idequeue = b->qnext;
 
-  // Read data if needed.
-  if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
+  if(idebm){
+    st = inb(idebm+BM_STATUS);
+    if(!(st & BM_STATUS_INT)){
+      // not from our transfer
+      release(&idelock);
+      return;
+    }
+    outb(idebm+BM_CMD, 0);
+    outb(idebm+BM_STATUS, BM_STATUS_ERR|BM_STATUS_INT);
+    if(idewait(1) < 0 || (st & BM_STATUS_ERR))
+      panic("ide dma");
+  } else if(!(b->flags & B_DIRTY) && idewait(1) >= 0){
+    // Read data if needed.
     insl(0x1f0, b->data, BSIZE/4);
+  }
+  ideactive = 0;
 
-  // Wake process waiting for this buf.
-  b->flags |= B_VALID;
-  b->flags &= ~B_DIRTY;
-  wakeup(b);
+  // Wake processes waiting for these bufs.
+  for(; b; b = next){
+    next = b->qnext;
+    b->flags |= B_VALID;
+    b->flags &= ~B_DIRTY;
+    wakeup(b);
+  }
 
-  // Start disk on next buf in queue.
+  // Start disk on next bufs in queue.
   if(idequeue != 0)
-    idestart(idequeue);
+    idestart();
 
   release(&idelock);
 }
 
 //PAGEBREAK!
-// Sync buf with disk.
+// Sync bufs with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// The bufs are queued together, so requests for adjacent blocks
+// are merged into one transfer.
 void
-iderw(struct buf *b)
+iderwv(struct buf **bufs, int n)
 {
-  struct buf **pp;
+  struct buf *b, **pp;
+  uint key;
+  int i;
 
-  if(!holdingsleep(&b->lock))
-    panic("iderw: buf not locked");
-  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("iderw: nothing to do");
-  if(b->dev != 0 && !havedisk1)
-    panic("iderw: ide disk 1 not present");
+  for(i = 0; i < n; i++){
+    b = bufs[i];
+    if(!holdingsleep(&b->lock))
+      panic("iderw: buf not locked");
+    if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
+      panic("iderw: nothing to do");
+    if(b->dev != 0 && !havedisk1)
+      panic("iderw: ide disk 1 not present");
+  }
 
   acquire(&idelock);  //DOC:acquire-lock
 
-  // Append b to idequeue.
-  b->qnext = 0;
-  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)  //DOC:insert-queue
-    ;
-  *pp = b;
+  // Insert the bufs into idequeue in elevator order: ascending
+  // from idepos, then wrapping around to the lowest block.
+  for(i = 0; i < n; i++){
+    b = bufs[i];
+    key = idekey(b) - idepos;
+    for(pp=&idequeue; *pp && idekey(*pp) - idepos <= key; pp=&(*pp)->qnext)  //DOC:insert-queue
+      ;
+    b->qnext = *pp;
+    *pp = b;
+  }
 
   // Start disk if necessary.
-  if(idequeue == b)
-    idestart(b);
+  if(ideactive == 0)
+    idestart();
 
-  // Wait for request to finish.
-  while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
-    sleep(b, &idelock);
+  // Wait for requests to finish.
+  for(i = 0; i < n; i++){
+    b = bufs[i];
+    while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
+      sleep(b, &idelock);
+    }
   }
 
-
   release(&idelock);
 }
+
+// Sync buf with disk.
+void
+iderw(struct buf *b)
+{
+  iderwv(&b, 1);
+}
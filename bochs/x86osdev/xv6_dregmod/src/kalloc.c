@@ -7,6 +7,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "proc.h"
 #include "spinlock.h"
 
 void freerange(void *vstart, void *vend);
@@ -17,10 +18,34 @@ struct run {
   struct run *next;
 };
 
+// Freed pages go to a per-CPU free list first, which is used
+// without taking kmem.lock. Pages are moved between the per-CPU
+// lists and the global list in batches of KBATCH. When both its
+// own list and the global list are empty, a CPU steals a batch
+// from another CPU's list before kalloc() gives up.
+// Each per-CPU list has its own lock, which is only contended
+// by stealing. Never hold two of these locks, or one of them
+// and kmem.lock, at the same time.
+#define KBATCH   32  // pages moved to or from the global list at once
+#define KCACHE   64  // max pages on a per-CPU list
+
+// Fill freed pages with junk to catch dangling refs. Pages are
+// not zeroed here; the callers that need zeroed pages clear them
+// after kalloc(). So this is only useful for debugging.
+#define KJUNK    0
+
 struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  struct {
+    struct spinlock lock;
+    struct run *freelist;
+    int nfree;
+  } cpu[NCPU];
+  // Number of references to each physical page. Pages are shared
+  // between page tables by copy-on-write fork.
+  ushort ref[PHYSTOP/PGSIZE];
 } kmem;
 
 // Initialization happens in two phases.
@@ -31,7 +56,11 @@ struct {
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kmem.cpu[i].lock, "kmem cpu");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -52,28 +81,115 @@ freerange(void *vstart, void *vend)
     kfree(p);
 }
 //PAGEBREAK: 21
-// Free the page of physical memory pointed at by v,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
+// Drop a reference to the page of physical memory pointed at by v,
+// and free it if that was the last one. The page normally should
+// have been returned by a call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
 void
 kfree(char *v)
 {
-  struct run *r;
+  struct run *r, *last;
+  int id, n;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
-  // Fill with junk to catch dangling refs.
-  memset(v, 1, PGSIZE);
+  if(kmem.use_lock){
+    n = __sync_sub_and_fetch(&kmem.ref[V2P(v)/PGSIZE], 1);
+    if(n == 0xffff)
+      panic("kfree: ref");
+    if(n > 0)
+      return;
+  }
+
+  if(KJUNK)
+    memset(v, 1, PGSIZE);
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
+  if(!kmem.use_lock){
+    // still initializing on one CPU
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    return;
+  }
+
+  pushcli();
+  id = cpuid();
+  acquire(&kmem.cpu[id].lock);
+  r->next = kmem.cpu[id].freelist;
+  kmem.cpu[id].freelist = r;
+  last = 0;
+  if(++kmem.cpu[id].nfree > KCACHE){
+    // Give a batch back to the global list.
+    last = r;
+    for(n = 1; n < KBATCH; n++)
+      last = last->next;
+    kmem.cpu[id].freelist = last->next;
+    kmem.cpu[id].nfree -= KBATCH;
+  }
+  release(&kmem.cpu[id].lock);
+  if(last){
+    acquire(&kmem.lock);
+    last->next = kmem.freelist;
+    kmem.freelist = r;
     release(&kmem.lock);
+  }
+  popcli();
+}
+
+// Take up to max pages off the list of CPU id.
+// Returns the pages as a 0-terminated list and their number in *np.
+static struct run*
+ktake(int id, int max, int *np)
+{
+  struct run *r, *last;
+  int n;
+
+  acquire(&kmem.cpu[id].lock);
+  r = kmem.cpu[id].freelist;
+  n = 0;
+  if(r){
+    last = r;
+    for(n = 1; n < max && last->next; n++)
+      last = last->next;
+    kmem.cpu[id].freelist = last->next;
+    kmem.cpu[id].nfree -= n;
+    last->next = 0;
+  }
+  release(&kmem.cpu[id].lock);
+  *np = n;
+  return r;
+}
+
+// Get a batch of free pages for CPU id, whose own list is empty:
+// from the global list, or else half of another CPU's list.
+static struct run*
+krefill(int id, int *np)
+{
+  struct run *r, *last;
+  int i, n, victim;
+
+  acquire(&kmem.lock);
+  r = kmem.freelist;
+  n = 0;
+  if(r){
+    last = r;
+    for(n = 1; n < KBATCH && last->next; n++)
+      last = last->next;
+    kmem.freelist = last->next;
+    last->next = 0;
+  }
+  release(&kmem.lock);
+
+  for(i = 1; r == 0 && i < ncpu; i++){
+    victim = (id + i) % ncpu;
+    // racy peek, ktake() checks again under the lock
+    n = kmem.cpu[victim].nfree;
+    if(n > 0)
+      r = ktake(victim, (n + 1) / 2, &n);
+  }
+  *np = n;
+  return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -82,15 +198,51 @@ kfree(char *v)
 char*
 kalloc(void)
 {
-  struct run *r;
+  struct run *r, *last;
+  int id, n;
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = kmem.freelist;
+  if(!kmem.use_lock){
+    r = kmem.freelist;
+    if(r){
+      kmem.freelist = r->next;
+      kmem.ref[V2P(r)/PGSIZE] = 1;
+    }
+    return (char*)r;
+  }
+
+  pushcli();
+  id = cpuid();
+  r = ktake(id, 1, &n);
+  if(r == 0 && (r = krefill(id, &n)) != 0 && n > 1){
+    // Keep the rest of the batch on this CPU's list.
+    last = r->next;
+    while(last->next)
+      last = last->next;
+    acquire(&kmem.cpu[id].lock);
+    last->next = kmem.cpu[id].freelist;
+    kmem.cpu[id].freelist = r->next;
+    kmem.cpu[id].nfree += n - 1;
+    release(&kmem.cpu[id].lock);
+  }
+  popcli();
   if(r)
-    kmem.freelist = r->next;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+    kmem.ref[V2P(r)/PGSIZE] = 1;
   return (char*)r;
 }
 
+// Add a reference to an allocated page.
+void
+kref(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kref");
+  __sync_fetch_and_add(&kmem.ref[V2P(v)/PGSIZE], 1);
+}
+
+// Number of references to an allocated page.
+int
+krefcnt(char *v)
+{
+  return kmem.ref[V2P(v)/PGSIZE];
+}
+
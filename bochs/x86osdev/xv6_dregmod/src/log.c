@@ -18,7 +18,15 @@
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
 // But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// sleeps until the transaction of the last outstanding
+// end_op() is committed.
+//
+// The commit itself is done by the log daemon, a kernel
+// process that the last end_op() of a transaction wakes up,
+// so that system call returns without waiting for the disk.
+// A transaction is thus durable only some time after its
+// system calls return; it is still atomic. Meanwhile new
+// system calls wait in begin_op().
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
@@ -27,7 +35,15 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// A commit appends the blocks of the transaction to the log in
+// one disk request and then writes the header. Committed blocks
+// stay pinned in the buffer cache and are only installed to
+// their home locations once the log holds more than LOGINSTALL
+// blocks, so several transactions share one install. The log has
+// room for LOGINSTALL blocks besides the space reserved by
+// begin_op(), so deferring the install does not hold back system
+// calls. A block may appear more than once in the log; later
+// copies supersede earlier ones.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -41,7 +57,8 @@ struct log {
   int start;
   int size;
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int committing;  // commit requested or in progress, please wait.
+  int committed;   // lh.block[0..committed-1] are committed.
   int dev;
   struct logheader lh;
 };
@@ -49,6 +66,7 @@ struct log log;
 
 static void recover_from_log(void);
 static void commit();
+static void logd(void);
 
 void
 initlog(int dev)
@@ -62,23 +80,43 @@ initlog(int dev)
   log.start = sb.logstart;
   log.size = sb.nlog;
   log.dev = dev;
+  if (log.size < LOGSIZE)
+    panic("initlog: log too small, rebuild fs.img");
   recover_from_log();
+  kproc("logd", logd);
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log to their home location.
+// When recovering, the blocks are read from the log on disk.
+// Otherwise the cached home blocks hold the committed contents,
+// since they are pinned until installed, and are written directly.
+// The writes go to the disk as one request.
 static void
-install_trans(void)
+install_trans(int recovering)
 {
-  int tail;
+  struct buf *bufs[LOGSIZE];
+  int tail, i, n;
 
+  n = 0;
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    brelse(lbuf);
-    brelse(dbuf);
+    for (i = tail+1; i < log.lh.n; i++)
+      if (log.lh.block[i] == log.lh.block[tail])
+        break;
+    if (i < log.lh.n)
+      continue;  // superseded by a later copy
+    if (recovering) {
+      struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
+      bufs[n] = bnew(log.dev, log.lh.block[tail]); // dst
+      memmove(bufs[n]->data, lbuf->data, BSIZE);  // copy block to dst
+      brelse(lbuf);
+    } else {
+      bufs[n] = bread(log.dev, log.lh.block[tail]); // cached dst
+    }
+    n++;
   }
+  bwritev(bufs, n);  // write dsts to disk
+  for (i = 0; i < n; i++)
+    brelse(bufs[i]);
 }
 
 // Read the log header from disk into the in-memory log header
@@ -101,9 +139,10 @@ read_head(void)
 static void
 write_head(void)
 {
-  struct buf *buf = bread(log.dev, log.start);
+  struct buf *buf = bnew(log.dev, log.start);
   struct logheader *hb = (struct logheader *) (buf->data);
   int i;
+  memset(buf->data, 0, BSIZE);
   hb->n = log.lh.n;
   for (i = 0; i < log.lh.n; i++) {
     hb->block[i] = log.lh.block[i];
@@ -116,8 +155,9 @@ static void
 recover_from_log(void)
 {
   read_head();
-  install_trans(); // if committed, copy from log to disk
+  install_trans(1); // if committed, copy from log to disk
   log.lh.n = 0;
+  log.committed = 0;
   write_head(); // clear the log
 }
 
@@ -141,19 +181,18 @@ begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// has the log daemon commit if this was the last
+// outstanding operation.
 void
 end_op(void)
 {
-  int do_commit = 0;
-
   acquire(&log.lock);
   log.outstanding -= 1;
   if(log.committing)
     panic("log.committing");
   if(log.outstanding == 0){
-    do_commit = 1;
     log.committing = 1;
+    wakeup(&log.committing);
   } else {
     // begin_op() may be waiting for log space,
     // and decrementing log.outstanding has decreased
@@ -161,43 +200,62 @@ end_op(void)
     wakeup(&log);
   }
   release(&log.lock);
+}
 
-  if(do_commit){
+// The log daemon. Commits each transaction once its last
+// system call has called end_op(), then lets begin_op()
+// admit new system calls.
+static void
+logd(void)
+{
+  acquire(&log.lock);
+  for(;;){
+    while(!log.committing)
+      sleep(&log.committing, &log.lock);
     // call commit w/o holding locks, since not allowed
     // to sleep with locks.
+    release(&log.lock);
     commit();
     acquire(&log.lock);
     log.committing = 0;
     wakeup(&log);
-    release(&log.lock);
   }
 }
 
-// Copy modified blocks from cache to log.
+// Copy the blocks of the current transaction from cache to the
+// log, in one disk request.
 static void
 write_log(void)
 {
-  int tail;
+  struct buf *bufs[LOGSIZE];
+  int tail, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
+  n = 0;
+  for (tail = log.committed; tail < log.lh.n; tail++) {
+    struct buf *to = bnew(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
     memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
     brelse(from);
-    brelse(to);
+    bufs[n++] = to;
   }
+  bwritev(bufs, n);  // write the log
+  for (tail = 0; tail < n; tail++)
+    brelse(bufs[tail]);
 }
 
 static void
 commit()
 {
-  if (log.lh.n > 0) {
+  if (log.lh.n > log.committed) {
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
+    log.committed = log.lh.n;
+  }
+  if (log.lh.n > LOGINSTALL) {
+    install_trans(0); // Now install writes to home locations
     log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    log.committed = 0;
+    write_head();    // Erase the transactions from the log
   }
 }
 
@@ -221,7 +279,9 @@ log_write(struct buf *b)
     panic("log_write outside of trans");
 
   acquire(&log.lock);
-  for (i = 0; i < log.lh.n; i++) {
+  // Absorb writes within the current transaction; committed
+  // log blocks must not be overwritten.
+  for (i = log.committed; i < log.lh.n; i++) {
     if (log.lh.block[i] == b->blockno)   // log absorbtion
       break;
   }
@@ -58,3 +58,13 @@ iderw(struct buf *b)
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
 }
+
+// Sync a number of bufs with disk.
+void
+iderwv(struct buf **bufs, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    iderw(bufs[i]);
+}
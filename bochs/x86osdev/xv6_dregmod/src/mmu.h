@@ -95,6 +95,10 @@ struct segdesc {
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
 #define PTE_PS          0x080   // Page Size
+#define PTE_COW         0x200   // Copy-on-write (available to software)
+
+// Page fault error code bits
+#define FEC_WR          0x002   // Fault was caused by a write
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
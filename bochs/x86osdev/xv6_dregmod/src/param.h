@@ -8,7 +8,10 @@
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define LOGINSTALL   (MAXOPBLOCKS*3)  // committed blocks kept in the log before install
+#define LOGSIZE      (MAXOPBLOCKS*3+LOGINSTALL)  // max data blocks in on-disk log
+#define NBUF         256  // size of disk block cache
+#define NBUCKET      31  // hash buckets in the disk block cache
+#define NREADAHEAD   4  // max # of blocks read ahead for sequential reads
 #define FSSIZE       1000  // size of file system in blocks
 
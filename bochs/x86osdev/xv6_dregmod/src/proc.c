@@ -7,9 +7,32 @@
 #include "proc.h"
 #include "spinlock.h"
 
+// Sleeping processes are hashed by channel, so wakeup only
+// looks at processes that may be sleeping on its channel.
+#define NSLEEPQ 61
+#define SLEEPQ(chan) (((uint)(chan) >> 2) % NSLEEPQ)
+
+// Each CPU has a FIFO queue of RUNNABLE processes. A process is
+// queued on the CPU it last ran on; a CPU with an empty queue
+// steals from the others.
+//
+// Process states are protected by ptable.lock. Each run queue
+// has its own lock for its list, so that an idle CPU can look
+// for work without taking ptable.lock. Adding or removing a
+// process also changes its state, so it needs both locks.
+// Lock order: ptable.lock before any runq lock; never hold
+// two runq locks at once.
+struct runq {
+  struct spinlock lock;
+  struct proc *head;
+  struct proc *tail;
+};
+
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
+  struct runq runq[NCPU];
+  struct proc *sleepq[NSLEEPQ];
 } ptable;
 
 static struct proc *initproc;
@@ -19,11 +42,16 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void runqadd(struct proc *p);
 
 void
 pinit(void)
 {
+  int i;
+
   initlock(&ptable.lock, "ptable");
+  for(i = 0; i < NCPU; i++)
+    initlock(&ptable.runq[i].lock, "runq");
 }
 
 // Must be called with interrupts disabled
@@ -148,7 +176,31 @@ userinit(void)
   // because the assignment might not be atomic.
   acquire(&ptable.lock);
 
-  p->state = RUNNABLE;
+  p->cpu = cpuid();
+  runqadd(p);
+
+  release(&ptable.lock);
+}
+
+// Start a kernel process that runs fn, which must never return.
+// It starts out in forkret like any other process, and then
+// "returns" to fn instead of trapret.
+void
+kproc(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    panic("kproc");
+  if((p->pgdir = setupkvm()) == 0)
+    panic("kproc: out of memory?");
+  *(uint*)(p->context + 1) = (uint)fn;
+  safestrcpy(p->name, name, sizeof(p->name));
+
+  acquire(&ptable.lock);
+
+  p->cpu = cpuid();
+  runqadd(p);
 
   release(&ptable.lock);
 }
@@ -214,7 +266,8 @@ fork(void)
 
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
+  np->cpu = cpuid();
+  runqadd(np);
 
   release(&ptable.lock);
 
@@ -312,6 +365,70 @@ wait(void)
 }
 
 //PAGEBREAK: 42
+// Make p RUNNABLE and append it to the run queue of p->cpu.
+// The ptable lock must be held.
+static void
+runqadd(struct proc *p)
+{
+  struct runq *q = &ptable.runq[p->cpu];
+
+  p->state = RUNNABLE;
+  p->qnext = 0;
+  acquire(&q->lock);
+  if(q->tail)
+    q->tail->qnext = p;
+  else
+    q->head = p;
+  q->tail = p;
+  release(&q->lock);
+}
+
+// Take the next process to run on CPU id off its run queue,
+// or off another CPU's queue if that one is empty.
+// The ptable lock must be held.
+static struct proc*
+runqget(int id)
+{
+  struct runq *q;
+  struct proc *p;
+  int i;
+
+  for(i = 0; i < ncpu; i++){
+    q = &ptable.runq[(id + i) % ncpu];
+    acquire(&q->lock);
+    if((p = q->head) != 0){
+      q->head = p->qnext;
+      if(q->head == 0)
+        q->tail = 0;
+      p->qnext = 0;
+      p->cpu = id;
+      release(&q->lock);
+      return p;
+    }
+    release(&q->lock);
+  }
+  return 0;
+}
+
+// Is there no RUNNABLE process on any run queue?
+// Only takes the run queue locks, not ptable.lock.
+static int
+runqempty(void)
+{
+  struct runq *q;
+  int i, empty;
+
+  for(i = 0; i < ncpu; i++){
+    q = &ptable.runq[i];
+    acquire(&q->lock);
+    empty = (q->head == 0);
+    release(&q->lock);
+    if(!empty)
+      return 0;
+  }
+  return 1;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -324,18 +441,23 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
   c->proc = 0;
   
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
+    // Nothing to run; wait for an interrupt rather than
+    // spinning on ptable.lock.
+    if(runqempty()){
+      stihlt();
+      continue;
+    }
 
+    // Take the next process to run off the run queues.
+    acquire(&ptable.lock);
+    while((p = runqget(id)) != 0){
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
@@ -351,7 +473,6 @@ scheduler(void)
       c->proc = 0;
     }
     release(&ptable.lock);
-
   }
 }
 
@@ -386,7 +507,7 @@ void
 yield(void)
 {
   acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  runqadd(myproc());
   sched();
   release(&ptable.lock);
 }
@@ -438,6 +559,8 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->qnext = ptable.sleepq[SLEEPQ(chan)];
+  ptable.sleepq[SLEEPQ(chan)] = p;
 
   sched();
 
@@ -457,11 +580,29 @@ sleep(void *chan, struct spinlock *lk)
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
+  struct proc *p, **pp;
+
+  pp = &ptable.sleepq[SLEEPQ(chan)];
+  while((p = *pp) != 0){
+    if(p->chan == chan){
+      *pp = p->qnext;
+      runqadd(p);
+    } else
+      pp = &p->qnext;
+  }
+}
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
+// Wake up process p, sleeping on p->chan.
+// The ptable lock must be held.
+static void
+wakeproc(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &ptable.sleepq[SLEEPQ(p->chan)]; *pp != p; pp = &(*pp)->qnext)
+    ;
+  *pp = p->qnext;
+  runqadd(p);
 }
 
 // Wake up all processes sleeping on chan.
@@ -487,7 +628,7 @@ kill(int pid)
       p->killed = 1;
       // Wake process from sleep if necessary.
       if(p->state == SLEEPING)
-        p->state = RUNNABLE;
+        wakeproc(p);
       release(&ptable.lock);
       return 0;
     }
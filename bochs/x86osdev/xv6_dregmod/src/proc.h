@@ -49,6 +49,8 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  int cpu;                     // CPU whose run queue it goes on
+  struct proc *qnext;          // Next on run queue or sleep queue
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -77,6 +77,13 @@ trap(struct trapframe *tf)
             cpuid(), tf->cs, tf->eip);
     lapiceoi();
     break;
+  case T_PGFLT:
+    // A write to a page shared copy-on-write by fork, from user
+    // space or from the kernel writing to user memory.
+    if(myproc() && (tf->err & FEC_WR) &&
+       cowpage(myproc()->pgdir, rcr2()) == 0)
+      break;
+    // fall through
 
   //PAGEBREAK: 13
   default:
@@ -311,7 +311,10 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child. Writable user pages are not copied but
+// shared copy-on-write: both page tables map them read-only
+// with PTE_COW, and cowpage() copies a page on the first write.
+// pgdir must be the current page table.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
@@ -329,21 +332,67 @@ copyuvm(pde_t *pgdir, uint sz)
       panic("copyuvm: page not present");
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
-      goto bad;
+    if(!(flags & PTE_U)){
+      // The stack guard page; copy it.
+      if((mem = kalloc()) == 0)
+        goto bad;
+      memmove(mem, (char*)P2V(pa), PGSIZE);
+      if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
+        kfree(mem);
+        goto bad;
+      }
+      continue;
+    }
+    if(flags & (PTE_W|PTE_COW)){
+      flags = (flags & ~PTE_W) | PTE_COW;
+      *pte = pa | flags;
     }
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+      goto bad;
+    kref(P2V(pa));
   }
+  // Flush the parent's now read-only mappings.
+  lcr3(V2P(pgdir));
   return d;
 
 bad:
+  lcr3(V2P(pgdir));
   freevm(d);
   return 0;
 }
 
+// Handle a write to the copy-on-write page at user address va.
+// Give the page table its own writable copy of the page, or make
+// the page writable if no other page table shares it any more.
+// Returns -1 if va is not a copy-on-write page or memory is
+// exhausted.
+int
+cowpage(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  if(va >= KERNBASE || (pte = walkpgdir(pgdir, (char*)va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_P|PTE_U|PTE_COW)) != (PTE_P|PTE_U|PTE_COW))
+    return -1;
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+  if(krefcnt(P2V(pa)) == 1){
+    // Only this page table maps it.
+    *pte = pa | flags;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)P2V(pa), PGSIZE);
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+  }
+  invlpg((char*)PGROUNDDOWN(va));
+  return 0;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -367,10 +416,16 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
   char *buf, *pa0;
   uint n, va0;
+  pte_t *pte;
 
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
+    // The write goes through the kernel mapping, so break
+    // copy-on-write sharing here rather than in the fault handler.
+    if((pte = walkpgdir(pgdir, (char*)va0, 0)) != 0 && (*pte & PTE_COW) &&
+       cowpage(pgdir, va0) < 0)
+      return -1;
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;